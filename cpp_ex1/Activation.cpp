@@ -1,7 +1,6 @@
-#include <math.h>
-#include <iostream>
 #include "Activation.h"
 #include "Matrix.h"
+#include "SimdKernels.h"
 
 /**
  * the constructor of the Activation class.
@@ -15,7 +14,7 @@ Activation :: Activation(ActivationType actType) : activationType(actType)
  * a getter method for the Actiovation's activation type.
  * @return the activation type.
  */
-ActivationType Activation ::  getActivationType()
+ActivationType Activation ::  getActivationType() const
 {
     return activationType;
 }
@@ -27,39 +26,122 @@ ActivationType Activation ::  getActivationType()
  */
 Matrix Activation :: operator()(Matrix input)
 {
+    if (activationType == Relu && input.isPacked())
+    {
+        activate(input.data(), input.getRows() * input.getCols());
+    }
+    else
+    {
+        activateColumns(input.data(), input.getRows(), input.getCols(), input.getLd());
+    }
+    return input;
+}
+
+/**
+ * activates the activation's type in place on a buffer of n floats.
+ * @param values the buffer to activate
+ * @param n the number of floats in the buffer
+ */
+void Activation :: activate(float *values, int n) const
+{
+    activate(values, nullptr, n);
+}
+
+/**
+ * activates the activation's type in place on values + bias, the bias is added in the first pass of
+ * the softmaxes, so the output of a layer is read once.
+ * @param values the buffer to activate
+ * @param bias the bias to add to the buffer, n floats
+ * @param n the number of floats in the buffer
+ */
+void Activation :: activate(float *values, const float *bias, int n) const
+{
+    const SimdKernels &kernels = simdKernels();
+    if (activationType == Relu)
+    {
+        if (bias != nullptr)
+        {
+            kernels.add(values, values, bias, n);
+        }
+        kernels.relu(values, values, n);
+    }
+    else if (activationType == Softmax || activationType == LogSoftmax)
+    {
+        kernels.softmax(values, values, bias, n, activationType == LogSoftmax);
+    }
+    else
+    {
+        throw MatrixSizeError(BAD_ACTIVATION_ERROR);
+    }
+}
+
+/**
+ * activates the activation's type in place on every column of a row-major rows x cols buffer,
+ * each column is a separate vector (a batch of vectors side by side).
+ * @param values the buffer to activate
+ * @param rows the number of rows in the buffer
+ * @param cols the number of cols in the buffer
+ */
+void Activation :: activateColumns(float *values, int rows, int cols) const
+{
+    activateColumns(values, rows, cols, cols);
+}
+
+/**
+ * activates the activation's type in place on every column of a rows x cols block of a row-major buffer,
+ * like a tile of the columns of a batch.
+ * @param values the first float of the block
+ * @param rows the number of rows in the block
+ * @param cols the number of cols in the block
+ * @param ld the distance (in floats) between two rows of the buffer
+ */
+void Activation :: activateColumns(float *values, int rows, int cols, int ld) const
+{
+    activateColumns(values, nullptr, rows, cols, ld);
+}
+
+/**
+ * activates the activation's type in place on every column of a rows x cols block of a row-major buffer
+ * plus the bias of its rows, bias[i] is added to row i in the first pass of the activation, so the output
+ * of a batched layer is read once.
+ * @param values the first float of the block
+ * @param bias the bias of the rows, rows floats, or nullptr for none
+ * @param rows the number of rows in the block
+ * @param cols the number of cols in the block
+ * @param ld the distance (in floats) between two rows of the buffer
+ */
+void Activation :: activateColumns(float *values, const float *bias, int rows, int cols, int ld) const
+{
+    if (ld == cols && cols == 1)
+    {
+        activate(values, bias, rows);
+        return;
+    }
+    const SimdKernels &kernels = simdKernels();
     if (activationType == Relu)
     {
-        Matrix Mat = Matrix(input.getRows(), input.getCols());
-        for (int i = 0; i < input.getRows()*input.getCols(); ++i)
+        if (bias == nullptr && ld == cols)
+        {
+            kernels.relu(values, values, rows * cols);
+            return;
+        }
+        for (int i = 0; i < rows; ++i)
         {
-            if (input[i] > 0)
+            float *row = values + (size_t) i * ld;
+            if (bias == nullptr)
             {
-                Mat[i] = input[i];
+                kernels.relu(row, row, cols);
             }
             else
             {
-                Mat[i] = 0;
+                kernels.biasRelu(row, row, bias[i], cols);
             }
         }
-        return Mat;
+        return;
     }
-    else if (activationType == Softmax)
+    if (activationType != Softmax && activationType != LogSoftmax)
     {
-        float sum = 0;
-        float exp = 0;
-        for (int i = 0; i< input.getRows(); ++i)
-        {
-            exp = std :: exp(input[i]);
-            input[i] = exp;
-            sum += exp;
-        }
-        float c = 1 / sum;
-        return c*input;
-    }
-    else
-    {
-        std::cerr << "Error: bad activation type" << std::endl;
-        exit(EXIT_FAILURE);
+        throw MatrixSizeError(BAD_ACTIVATION_ERROR);
     }
+    kernels.softmaxColumns(values, bias, rows, cols, ld, activationType == LogSoftmax);
 }
-
@@ -4,6 +4,8 @@
 
 #include "Matrix.h"
 
+#define BAD_ACTIVATION_ERROR "Error: bad activation type"
+
 /**
  * @enum ActivationType
  * @brief Indicator of activation function.
@@ -11,11 +13,12 @@
 enum ActivationType
 {
     Relu,
-    Softmax
+    Softmax,
+    LogSoftmax
 };
 
 /**
- * a class representing an activation in the dense.
+ * a class representing an activation in the dense, activating a type out of the enum throws MatrixSizeError.
  */
 class Activation
 {
@@ -33,7 +36,7 @@ public:
      * a getter method for the Actiovation's activation type.
      * @return the activation type.
      */
-    ActivationType getActivationType();
+    ActivationType getActivationType() const;
 
     /**
      * override method for the () operator, activating the activation's activation type on the given matrix
@@ -41,6 +44,53 @@ public:
      * @return the matrix after the operation.
      */
     Matrix operator()(Matrix input);
+
+    /**
+     * activates the activation's type in place on a buffer of n floats.
+     * @param values the buffer to activate
+     * @param n the number of floats in the buffer
+     */
+    void activate(float *values, int n) const;
+
+    /**
+     * activates the activation's type in place on values + bias, the bias is added in the first pass of
+     * the softmaxes, so the output of a layer is read once.
+     * @param values the buffer to activate
+     * @param bias the bias to add to the buffer, n floats
+     * @param n the number of floats in the buffer
+     */
+    void activate(float *values, const float *bias, int n) const;
+
+    /**
+     * activates the activation's type in place on every column of a row-major rows x cols buffer,
+     * each column is a separate vector (a batch of vectors side by side).
+     * @param values the buffer to activate
+     * @param rows the number of rows in the buffer
+     * @param cols the number of cols in the buffer
+     */
+    void activateColumns(float *values, int rows, int cols) const;
+
+    /**
+     * activates the activation's type in place on every column of a rows x cols block of a row-major buffer,
+     * like a tile of the columns of a batch.
+     * @param values the first float of the block
+     * @param rows the number of rows in the block
+     * @param cols the number of cols in the block
+     * @param ld the distance (in floats) between two rows of the buffer
+     */
+    void activateColumns(float *values, int rows, int cols, int ld) const;
+
+    /**
+     * activates the activation's type in place on every column of a rows x cols block of a row-major buffer
+     * plus the bias of its rows, bias[i] is added to row i in the first pass of the activation, so the output
+     * of a batched layer is read once.
+     * @param values the first float of the block
+     * @param bias the bias of the rows, rows floats, or nullptr for none
+     * @param rows the number of rows in the block
+     * @param cols the number of cols in the block
+     * @param ld the distance (in floats) between two rows of the buffer
+     */
+    void activateColumns(float *values, const float *bias, int rows, int cols, int ld) const;
 };
 
 #endif //ACTIVATION_H
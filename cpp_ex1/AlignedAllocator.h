@@ -0,0 +1,94 @@
+// AlignedAllocator.h
+
+#ifndef ALIGNEDALLOCATOR_H
+#define ALIGNEDALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include "Profile.h"
+
+/**
+ * a standard allocator of memory aligned to a power of 2 (a cache line for the packed weights), so a
+ * std::vector can hold buffers the aligned vector loads read.
+ * @tparam T the type of the elements.
+ * @tparam Alignment the alignment of every allocation, in bytes.
+ */
+template<class T, size_t Alignment>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+
+    /**
+     * the same allocator for another type of elements.
+     * @tparam U the type of the elements.
+     */
+    template<class U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    /**
+     * a stateless allocator.
+     */
+    AlignedAllocator() = default;
+
+    /**
+     * a converting constructor, the allocators hold no state.
+     */
+    template<class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+    {
+    }
+
+    /**
+     * allocates aligned memory for n elements, throws std::bad_alloc if there is none.
+     * @param n the number of elements.
+     * @return the first element.
+     */
+    T *allocate(size_t n)
+    {
+        // aligned_alloc wants a whole number of alignments.
+        const size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        void *block = std::aligned_alloc(Alignment, bytes);
+        if (block == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        PROFILE_ALLOCATION(bytes);
+        return (T *) block;
+    }
+
+    /**
+     * frees memory of allocate.
+     * @param block the first element.
+     */
+    void deallocate(T *block, size_t)
+    {
+        std::free(block);
+    }
+};
+
+/**
+ * stateless allocators free each others memory.
+ * @return true.
+ */
+template<class T, class U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &)
+{
+    return true;
+}
+
+/**
+ * stateless allocators free each others memory.
+ * @return false.
+ */
+template<class T, class U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment> &, const AlignedAllocator<U, Alignment> &)
+{
+    return false;
+}
+
+#endif //ALIGNEDALLOCATOR_H
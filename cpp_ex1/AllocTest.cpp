@@ -0,0 +1,83 @@
+// AllocTest.cpp
+// checks that the single image inference paths do not allocate once they are warm: make alloctest builds it
+// with the profile (which counts every operator new) and runs it, it exits with 1 if a path allocated.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "MlpNetwork.h"
+#include "Profile.h"
+#include "QuantizedMlpNetwork.h"
+#include "TestData.h"
+
+#ifndef MLP_PROFILE
+#error "AllocTest counts the allocations of the profile, build it with make alloctest"
+#endif
+
+#define ALLOC_FAILED_ERROR "Error: an inference path allocated after its warm up: "
+
+// the images of the warm up, and the images whose allocations are counted.
+#define ALLOC_WARMUP 8
+#define ALLOC_IMAGES 200
+
+/**
+ * runs a network on the images after a warm up, and exits with 1 if the counted images allocated.
+ * @param name the name of the path.
+ * @param network the network, anything with a Digit operator()(const Matrix &).
+ * @param images the images, ALLOC_WARMUP for the warm up and ALLOC_IMAGES counted.
+ */
+template<class Network>
+static void _expectNoAllocations(const char *name, const Network &network, const std::vector<Matrix> &images)
+{
+    float checksum = 0;
+    for (int i = 0; i < ALLOC_WARMUP; ++i)
+    {
+        checksum += network(images[i]).probability;
+    }
+    const uint64_t before = profileThreadAllocations();
+    for (int i = ALLOC_WARMUP; i < ALLOC_WARMUP + ALLOC_IMAGES; ++i)
+    {
+        checksum += network(images[i]).probability;
+    }
+    const uint64_t allocations = profileThreadAllocations() - before;
+    if (allocations != 0)
+    {
+        std::fprintf(stderr, "%s%s (%llu allocations in %d images)\n", ALLOC_FAILED_ERROR, name,
+                     (unsigned long long) allocations, ALLOC_IMAGES);
+        std::exit(EXIT_FAILURE);
+    }
+    std::printf("ok  %-24s 0 allocations in %d images (checksum %.3f)\n", name, ALLOC_IMAGES, checksum);
+}
+
+/**
+ * the allocation checks of the single image paths, on random weights and images.
+ * @return 0, or 1 (by exit) on the first path that allocated.
+ */
+int main()
+{
+    std::mt19937 gen(11);
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+        biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+        fillNormal(weights[i], gen, 0.05f);
+        fillNormal(biases[i], gen, 0.05f);
+    }
+    std::vector<Matrix> images(ALLOC_WARMUP + ALLOC_IMAGES, Matrix(weightsDims[0].cols, 1));
+    for (Matrix &image : images)
+    {
+        fillImages(image, gen);
+    }
+
+    const MlpNetwork network(weights, biases);
+    _expectNoAllocations("float32", network, images);
+    const MlpNetwork halfNetwork(weights, biases, Float16);
+    _expectNoAllocations("float16", halfNetwork, images);
+    const MlpNetwork bfloatNetwork(weights, biases, BFloat16);
+    _expectNoAllocations("bfloat16", bfloatNetwork, images);
+    const QuantizedMlpNetwork quantized(network);
+    _expectNoAllocations("int8", quantized, images);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "Bench.h"
+#include "SimdKernels.h"
+
+/**
+ * the value of a percentile of sorted samples, the nearest rank.
+ * @param sorted the samples, sorted up.
+ * @param percent the percentile, in (0, 100].
+ * @return the smallest sample that percent of the samples are at most.
+ */
+static double _percentile(const std::vector<double> &sorted, double percent)
+{
+    const size_t rank = (size_t) std::ceil(percent / 100 * (double) sorted.size());
+    return sorted[std::max(rank, (size_t) 1) - 1];
+}
+
+/**
+ * writes a string as a JSON string, the names of the cases are plain text.
+ * @param os the stream to write to.
+ * @param text the string.
+ */
+static void _writeJsonString(std::ostream &os, const std::string &text)
+{
+    os << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+
+/**
+ * a constructor of an empty suite.
+ * @param samples the number of samples of every case.
+ */
+BenchSuite :: BenchSuite(int samples) : _samples(std::max(samples, 1))
+{
+}
+
+/**
+ * sorts the times of the samples of a case into its result.
+ * @param name the name of the case.
+ * @param times the time of a call in every sample, in microseconds.
+ * @param iterations the number of calls of a sample.
+ * @param flops the floating point operations of a call.
+ * @param items the items of a call.
+ * @return the result of the case.
+ */
+const BenchResult &BenchSuite :: _record(const std::string &name, std::vector<double> &times, int iterations,
+                                         double flops, double items)
+{
+    std::sort(times.begin(), times.end());
+    BenchResult result;
+    result.name = name;
+    result.samples = (int) times.size();
+    result.iterations = iterations;
+    result.p50 = _percentile(times, 50);
+    result.p99 = _percentile(times, 99);
+    result.max = times.back();
+    result.flops = flops;
+    result.items = items;
+    _results.push_back(result);
+    return _results.back();
+}
+
+/**
+ * a getter for the results of the cases run so far.
+ * @return the results, in the order of the runs.
+ */
+const std::vector<BenchResult> &BenchSuite :: results() const
+{
+    return _results;
+}
+
+/**
+ * prints the results as a table.
+ * @param os the stream to print to.
+ */
+void BenchSuite :: printTable(std::ostream &os) const
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-34s %10s %10s %10s %9s %12s\n", "case", "p50 us", "p99 us", "max us",
+                  "GFLOP/s", "items/s");
+    os << line;
+    for (const BenchResult &r : _results)
+    {
+        char gflops[16] = "-", rate[16] = "-";
+        if (r.flops > 0)
+        {
+            std::snprintf(gflops, sizeof(gflops), "%.2f", r.flops / r.p50 / 1e3);
+        }
+        if (r.items > 0)
+        {
+            std::snprintf(rate, sizeof(rate), "%.0f", r.items / r.p50 * 1e6);
+        }
+        std::snprintf(line, sizeof(line), "%-34s %10.3f %10.3f %10.3f %9s %12s\n", r.name.c_str(), r.p50, r.p99,
+                      r.max, gflops, rate);
+        os << line;
+    }
+}
+
+/**
+ * writes the results as a JSON object, one entry per case, with the instruction set of the kernels.
+ * @param os the stream to write to.
+ */
+void BenchSuite :: writeJson(std::ostream &os) const
+{
+    os << "{\n  \"isa\": ";
+    _writeJsonString(os, simdKernels().isa);
+    os << ",\n  \"results\": [";
+    for (size_t i = 0; i < _results.size(); ++i)
+    {
+        const BenchResult &r = _results[i];
+        os << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        _writeJsonString(os, r.name);
+        os << ", \"samples\": " << r.samples << ", \"iterations\": " << r.iterations
+           << ", \"p50_us\": " << r.p50 << ", \"p99_us\": " << r.p99 << ", \"max_us\": " << r.max
+           << ", \"gflops\": " << (r.flops > 0 ? r.flops / r.p50 / 1e3 : 0)
+           << ", \"items_per_s\": " << (r.items > 0 ? r.items / r.p50 * 1e6 : 0) << "}";
+    }
+    os << "\n  ]\n}\n";
+}
@@ -0,0 +1,129 @@
+// Bench.h
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// the time the code of a case runs before it is measured, in microseconds.
+#define BENCH_WARMUP_US 20000
+// the shortest sample, a faster case is repeated within every sample until it takes that long.
+#define BENCH_SAMPLE_US 20
+// the default number of samples of a case.
+#define BENCH_SAMPLES 200
+
+/**
+ * @struct BenchResult
+ * @brief the statistics of the samples of a benchmark case, the times are per call in microseconds.
+ */
+typedef struct BenchResult
+{
+    std::string name;
+    // the number of samples, and the number of calls timed together in every sample.
+    int samples, iterations;
+    double p50, p99, max;
+    // the floating point operations and the items (images, vectors) of one call, 0 when they do not apply.
+    double flops, items;
+} BenchResult;
+
+/**
+ * a harness of micro benchmarks: every case is warmed up, then timed in samples of one or more calls, and
+ * its percentiles are kept for a table and a JSON report that versions of the code can be compared by.
+ */
+class BenchSuite
+{
+private:
+    int _samples;
+    std::vector<BenchResult> _results;
+
+    /**
+     * sorts the times of the samples of a case into its result.
+     * @param name the name of the case.
+     * @param times the time of a call in every sample, in microseconds.
+     * @param iterations the number of calls of a sample.
+     * @param flops the floating point operations of a call.
+     * @param items the items of a call.
+     * @return the result of the case.
+     */
+    const BenchResult &_record(const std::string &name, std::vector<double> &times, int iterations, double flops,
+                               double items);
+
+public:
+
+    /**
+     * a constructor of an empty suite.
+     * @param samples the number of samples of every case.
+     */
+    explicit BenchSuite(int samples = BENCH_SAMPLES);
+
+    /**
+     * warms up and times a case. the calls of a sample are timed together, so a case far faster than the
+     * clock still gets a fair time, and the percentiles are those of the samples.
+     * @tparam F a callable with no arguments.
+     * @param name the name of the case, in the table and the report.
+     * @param flops the floating point operations of a call, 0 for none.
+     * @param items the items a call processes, 0 for none.
+     * @param call the code to time.
+     * @return the result of the case.
+     */
+    template<class F>
+    const BenchResult &run(const std::string &name, double flops, double items, F call)
+    {
+        typedef std::chrono::steady_clock Clock;
+        typedef std::chrono::duration<double, std::micro> Micros;
+        // the warm up also counts the calls that fill a sample.
+        int calls = 0;
+        const Clock::time_point start = Clock::now();
+        do
+        {
+            call();
+            ++calls;
+        }
+        while (Micros(Clock::now() - start).count() < BENCH_WARMUP_US);
+        const double callTime = Micros(Clock::now() - start).count() / calls;
+        const int iterations = (callTime >= BENCH_SAMPLE_US) ? 1 : (int) (BENCH_SAMPLE_US / callTime) + 1;
+        std::vector<double> times(_samples);
+        for (double &time : times)
+        {
+            const Clock::time_point sampleStart = Clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                call();
+            }
+            time = Micros(Clock::now() - sampleStart).count() / iterations;
+        }
+        return _record(name, times, iterations, flops, items);
+    }
+
+    /**
+     * a getter for the results of the cases run so far.
+     * @return the results, in the order of the runs.
+     */
+    const std::vector<BenchResult> &results() const;
+
+    /**
+     * prints the results as a table.
+     * @param os the stream to print to.
+     */
+    void printTable(std::ostream &os) const;
+
+    /**
+     * writes the results as a JSON object, one entry per case, with the instruction set of the kernels.
+     * @param os the stream to write to.
+     */
+    void writeJson(std::ostream &os) const;
+};
+
+/**
+ * keeps the compiler from dropping a computation whose result is unused.
+ * @param p a pointer to the result.
+ */
+inline void benchKeep(const void *p)
+{
+    asm volatile("" : : "r"(p) : "memory");
+}
+
+#endif //BENCH_H
@@ -1,14 +1,219 @@
+#include <algorithm>
+#include <utility>
 #include "Dense.h"
 #include "Activation.h"
 #include "Matrix.h"
+#include "MatrixOps.h"
+#include "SimdKernels.h"
+#include "Gemm.h"
+#include "HalfKernels.h"
+#include "MemoryPlan.h"
+
+/**
+ * a matrix borrowing the floats of a read only view, or a copy of a view with padded rows (a borrowed matrix
+ * is row-major). a dense only reads its weights, the const is dropped to hold them in a Matrix.
+ * @param view the view.
+ * @return the borrowing matrix, or the copy.
+ */
+static Matrix _borrowReadOnly(ConstMatrixView view)
+{
+    if (view.getLd() != view.getCols())
+    {
+        return Matrix(view);
+    }
+    return Matrix(view.getRows(), view.getCols(), const_cast<float *>(view.data()));
+}
+
+/**
+ * the dot product of one row of the 16 bit weights with a vector, in the format they are stored in.
+ * @param row the index of the row.
+ * @param x a vector of cols floats.
+ * @return the dot product.
+ */
+float Dense :: _dotRow(int row, const float *x) const
+{
+    if (precision == Float16)
+    {
+        return halfKernels().dotF16(halfW.data() + (size_t) row * cols, x, cols);
+    }
+    return halfKernels().dotBf16(halfW.data() + (size_t) row * cols, x, cols);
+}
+
+/**
+ * widens consecutive rows of 16 bit weights to float.
+ * @param firstRow the index of the first row.
+ * @param numRows the number of rows.
+ * @param out a buffer of numRows * cols floats.
+ */
+void Dense :: _widenRows(int firstRow, int numRows, float *out) const
+{
+    const uint16_t *src = halfW.data() + (size_t) firstRow * cols;
+    if (precision == Float16)
+    {
+        halfKernels().widenF16(out, src, numRows * cols);
+    }
+    else
+    {
+        halfKernels().widenBf16(out, src, numRows * cols);
+    }
+}
+
+/**
+ * packs row-major weights into panels: a panel holds SIMD_PANEL_ROWS rows (the last one padded with zero
+ * rows) column after column, so every column of a panel is one aligned cache line. Dense and StaticDense
+ * pack their weights with it.
+ * @param w the first float of the rows x cols weights.
+ * @param rows the number of rows.
+ * @param cols the number of cols.
+ * @param ld the distance (in floats) between two rows of w.
+ * @param panels a 64 byte aligned buffer of ceil(rows / SIMD_PANEL_ROWS) * SIMD_PANEL_ROWS * cols floats.
+ */
+void packPanels(const float *w, int rows, int cols, int ld, float *panels)
+{
+    const int paddedRows = (rows + SIMD_PANEL_ROWS - 1) / SIMD_PANEL_ROWS * SIMD_PANEL_ROWS;
+    std::fill(panels, panels + (size_t) paddedRows * cols, 0.f);
+    for (int i = 0; i < rows; ++i)
+    {
+        float *panel = panels + (size_t) (i / SIMD_PANEL_ROWS) * SIMD_PANEL_ROWS * cols;
+        for (int k = 0; k < cols; ++k)
+        {
+            panel[(size_t) k * SIMD_PANEL_ROWS + i % SIMD_PANEL_ROWS] = w[(size_t) i * ld + k];
+        }
+    }
+}
+
+/**
+ * the forward kernel of packed panels, writes act(W*x + b) into output in one streaming read of the panels.
+ * a mostly zero input (the background of an image, the dead units of a relu layer) is compacted once, and
+ * only the columns of its nonzeros are read. Dense and StaticDense run their panels with it.
+ * @param panels the weights packed by packPanels.
+ * @param rows the number of rows of W.
+ * @param cols the number of cols of W.
+ * @param act the activation.
+ * @param bias the bias, rows floats.
+ * @param input the input vector, cols floats.
+ * @param output the output vector, rows floats, may not overlap the input.
+ * @param index a buffer of cols + SIMD_PANEL_ROWS ints for the positions of the nonzero inputs.
+ * @param values a buffer of cols + SIMD_PANEL_ROWS floats for the nonzero inputs.
+ */
+void panelForward(const float *panels, int rows, int cols, ActivationType act, const float *bias,
+                  const float *input, float *output, int *index, float *values)
+{
+    // the panels are read from the first byte to the last, one cache line per column.
+    const SimdKernels &kernels = simdKernels();
+    const int nonzeros = kernels.compactNonzeros(index, values, input, cols);
+    const bool sparse = nonzeros <= DENSE_SPARSE_INPUT * cols;
+    const int fullRows = rows / SIMD_PANEL_ROWS * SIMD_PANEL_ROWS;
+    for (int i = 0; i < rows; i += SIMD_PANEL_ROWS)
+    {
+        alignas(GEMM_ALIGNMENT) float last[SIMD_PANEL_ROWS];
+        float *y = (i < fullRows) ? output + i : last;
+        const float *panel = panels + (size_t) i * cols;
+        if (sparse)
+        {
+            kernels.panelDotColumns(y, panel, index, values, nonzeros);
+        }
+        else
+        {
+            kernels.panelDot(y, panel, input, cols);
+        }
+        if (y == last)
+        {
+            std::copy(last, last + rows - fullRows, output + fullRows);
+        }
+    }
+    Activation(act).activate(output, bias, rows);
+}
+
+/**
+ * copies the weights of packPanels back to row-major weights.
+ * @param panels the panels.
+ * @param rows the number of rows.
+ * @param cols the number of cols.
+ * @param w the first float of the rows x cols weights.
+ * @param ld the distance (in floats) between two rows of w.
+ */
+static void _unpackPanels(const float *panels, int rows, int cols, float *w, int ld)
+{
+    for (int i = 0; i < rows; ++i)
+    {
+        const float *panel = panels + (size_t) (i / SIMD_PANEL_ROWS) * SIMD_PANEL_ROWS * cols;
+        for (int k = 0; k < cols; ++k)
+        {
+            w[(size_t) i * ld + k] = panel[(size_t) k * SIMD_PANEL_ROWS + i % SIMD_PANEL_ROWS];
+        }
+    }
+}
+
+/**
+ * packs float weights for the kernels, in the panels of packPanels and the blocks of sgemmPackA.
+ * @param w the weights, not kept.
+ */
+void Dense :: _packWeights(const Matrix &w)
+{
+    panelW.resize((size_t) (rows + SIMD_PANEL_ROWS - 1) / SIMD_PANEL_ROWS * SIMD_PANEL_ROWS * cols);
+    packPanels(w.data(), rows, cols, w.getLd(), panelW.data());
+    gemmW.resize(sgemmPackedSize(rows, cols));
+    sgemmPackA(rows, cols, w.data(), w.getLd(), gemmW.data());
+}
 
 /**
  * the constructor of the dense class.
  * @param w a weight matrix
  * @param bias a bias matrix
  * @param actType an enum of activation type.
+ * @param weightPrecision the format to store the weights in, the 16 bit formats round w once here.
+ */
+Dense :: Dense(const Matrix& w, const Matrix& bias, ActivationType actType, WeightPrecision weightPrecision)
+        : activationType(actType), precision(weightPrecision), rows(w.getRows()), cols(w.getCols()),
+          biasMat(bias)
+{
+    if (precision == Float32)
+    {
+        _packWeights(w);
+        return;
+    }
+    halfW.resize((size_t) rows * cols);
+    for (int i = 0; i < rows; ++i)
+    {
+        const float *values = w.data() + (size_t) i * w.getLd();
+        uint16_t *half = halfW.data() + (size_t) i * cols;
+        for (int j = 0; j < cols; ++j)
+        {
+            half[j] = (precision == Float16) ? floatToHalf(values[j]) : floatToBf16(values[j]);
+        }
+    }
+}
+
+/**
+ * a constructor taking over the weight and bias matrices (float weights). owned weights are packed and
+ * freed, matrices borrowing a mapped model file stay borrowed, and are not packed.
+ * @param w a weight matrix
+ * @param bias a bias matrix
+ * @param actType an enum of activation type.
+ */
+Dense :: Dense(Matrix&& w, Matrix&& bias, ActivationType actType)
+        : activationType(actType), precision(Float32), rows(w.getRows()), cols(w.getCols()),
+          biasMat(std::move(bias))
+{
+    // packing a mapped file would copy it, its layers keep reading the row-major pages in place.
+    if (w.ownsData())
+    {
+        _packWeights(w);
+        return;
+    }
+    wMat = std::move(w);
+}
+
+/**
+ * a constructor reading read only float weights in place (like the pages of a mapped model file), they
+ * are not copied and not packed. weights with padded rows are copied (and packed) instead.
+ * @param w a view of a weight matrix, it has to outlive the dense.
+ * @param bias a view of a bias matrix, it has to outlive the dense.
+ * @param actType an enum of activation type.
  */
-Dense :: Dense(const Matrix& w, const Matrix& bias, ActivationType actType) : activationType(actType), wMat(w), biasMat(bias)
+Dense :: Dense(ConstMatrixView w, ConstMatrixView bias, ActivationType actType)
+        : Dense(_borrowReadOnly(w), _borrowReadOnly(bias), actType)
 {
 }
 
@@ -24,20 +229,79 @@ Activation Dense ::  getActivation() const
 
 /**
  * a const getter, returning the bias matrix
- * @return the bias matrix
+ * @return a reference to the bias matrix
  */
-Matrix Dense ::  getBias() const
+const Matrix &Dense ::  getBias() const
 {
     return biasMat;
 }
 
 /**
- * a const getter, returning the weight matrix
- * @return the weight matrix
+ * a const getter, returning the weight matrix (unpacked from the panels, or widened to float when stored
+ * in 16 bits)
+ * @return a copy of the weight matrix
  */
 Matrix Dense ::  getWeights() const
 {
-    return wMat;
+    if (precision == Float32 && panelW.empty())
+    {
+        return Matrix(wMat, packedLayout);
+    }
+    if (precision == Float32)
+    {
+        Matrix weights(rows, cols);
+        _unpackPanels(panelW.data(), rows, cols, weights.data(), weights.getLd());
+        return weights;
+    }
+    Matrix weights(rows, cols);
+    _widenRows(0, rows, weights.data());
+    return weights;
+}
+
+/**
+ * a const getter, returning the number of outputs of the dense.
+ * @return the number of rows of the weight matrix.
+ */
+int Dense :: getRows() const
+{
+    return rows;
+}
+
+/**
+ * a const getter, returning the number of inputs of the dense.
+ * @return the number of cols of the weight matrix.
+ */
+int Dense :: getCols() const
+{
+    return cols;
+}
+
+/**
+ * a const getter, returning the format the weights are stored in.
+ * @return the precision of the weights.
+ */
+WeightPrecision Dense :: getPrecision() const
+{
+    return precision;
+}
+
+/**
+ * a const getter, returning the memory the weights take.
+ * @return the number of bytes of the weights.
+ */
+size_t Dense :: weightBytes() const
+{
+    return (precision == Float32) ? (size_t) rows * cols * sizeof(float) : halfW.size() * sizeof(uint16_t);
+}
+
+/**
+ * a const getter, returning the work of the forward kernels.
+ * @param batch the number of inputs.
+ * @return the floating point operations of a product with batch inputs.
+ */
+double Dense :: flops(int batch) const
+{
+    return 2.0 * rows * cols * batch;
 }
 
 /**
@@ -45,11 +309,110 @@ Matrix Dense ::  getWeights() const
  * @param matrix a const matrix to operate on.
  * @return the matrix after the operation.
  */
-Matrix Dense::operator()(const Matrix& matrix)
+Matrix Dense::operator()(const Matrix& matrix) const
+{
+    Matrix result(rows, matrix.getCols());
+    forwardBatch(matrix.view(), result.view());
+    return result;
+}
+
+/**
+ * the fused forward kernel, writes act(W*x + b) into output in one streaming read of the weights,
+ * without allocating and without copying the weights. a mostly zero input (the background of an image,
+ * the dead units of a relu layer) is compacted once, and only the columns of its nonzeros are read.
+ * @param input the input vector, getCols() floats.
+ * @param output the output vector, getRows() floats, may not overlap the input.
+ */
+void Dense :: forward(const float *input, float *output) const
 {
-    Matrix newMat = wMat * matrix;
-    newMat += getBias();
-    Activation act = ActivationType (activationType);
-    newMat = act(newMat);
-    return newMat;
-}
\ No newline at end of file
+    const float *b = biasMat.data();
+    if (panelW.empty())
+    {
+        if (precision == Float32)
+        {
+            gemv(MatrixView(output, rows, 1, 1), wMat, ConstMatrixView(input, cols, 1, 1));
+        }
+        else
+        {
+            for (int i = 0; i < rows; ++i)
+            {
+                output[i] = _dotRow(i, input);
+            }
+        }
+        Activation(activationType).activate(output, b, rows);
+        return;
+    }
+    ArenaFrame frame(2 * ((size_t) cols + SIMD_PANEL_ROWS));
+    panelForward(panelW.data(), rows, cols, activationType, b, input, output, reinterpret_cast<int *>(frame.data()),
+                 frame.data() + cols + SIMD_PANEL_ROWS);
+}
+
+/**
+ * the batched forward kernel, writes act(W*X + b) into output, where every column of X is one input
+ * vector. the product is a single matrix-matrix multiplication, so the weights are read once per batch.
+ * the input and the output may be views (like a tile of the columns of a larger batch), read and written
+ * in place with their strides.
+ * @param input a getCols() x N matrix, one input per column.
+ * @param output a getRows() x N matrix for the results, one result per column, may not overlap the input.
+ */
+void Dense :: forwardBatch(ConstMatrixView input, MatrixView output) const
+{
+    const int batch = input.getCols();
+    if (input.getRows() != cols || output.getRows() != rows || output.getCols() != batch)
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    const float *in = input.data();
+    const int ldi = input.getLd(), ldo = output.getLd();
+    float *out = output.data();
+    if (!gemmW.empty() && batch == 1)
+    {
+        // a single column runs the panels of forward, contiguous.
+        ArenaFrame frame((size_t) cols + rows);
+        float *x = frame.data(), *y = frame.data() + cols;
+        for (int k = 0; k < cols; ++k)
+        {
+            x[k] = in[(size_t) k * ldi];
+        }
+        forward(x, y);
+        for (int i = 0; i < rows; ++i)
+        {
+            out[(size_t) i * ldo] = y[i];
+        }
+        return;
+    }
+    if (!gemmW.empty())
+    {
+        // only the packed weights are kept, small products take the blocked path too.
+        sgemmPacked(rows, batch, cols, 1, nullptr, 0, gemmW.data(), in, ldi, 0, out, ldo);
+    }
+    else if (precision == Float32)
+    {
+        gemm(output, wMat, input);
+    }
+    else
+    {
+        // 16 bit weights are widened one GEMM_MC block of rows at a time, a block stays in L2 for its product.
+        static thread_local std::vector<float> block;
+        block.resize((size_t) GEMM_MC * cols);
+        for (int r = 0; r < rows; r += GEMM_MC)
+        {
+            const int blockRows = std::min(GEMM_MC, rows - r);
+            _widenRows(r, blockRows, block.data());
+            sgemm(blockRows, batch, cols, 1, block.data(), cols, in, ldi, 0, out + (size_t) r * ldo, ldo);
+        }
+    }
+    // the bias is broadcast into every column by the first pass of the activation.
+    Activation(activationType).activateColumns(out, biasMat.data(), rows, batch, ldo);
+}
+
+/**
+ * the batched forward kernel on raw row-major buffers, writes act(W*X + b) into output.
+ * @param input getCols() x batch floats, one input per column.
+ * @param batch the number of inputs.
+ * @param output getRows() x batch floats for the results, may not overlap the input.
+ */
+void Dense :: forwardBatch(const float *input, int batch, float *output) const
+{
+    forwardBatch(ConstMatrixView(input, cols, batch, batch), MatrixView(output, rows, batch, batch));
+}
@@ -1,8 +1,61 @@
+#include <cstdint>
+#include <vector>
 #include "Activation.h"
+#include "AlignedAllocator.h"
+#include "Gemm.h"
 
 #ifndef CPP1_DENSE_H
 #define CPP1_DENSE_H
 
+/**
+ * the format the weights of a layer are stored in. the 16 bit formats halve the memory and the bandwidth of
+ * the weights, they are widened to float in registers and the arithmetic stays float.
+ */
+enum WeightPrecision
+{
+    Float32,
+    Float16,
+    BFloat16
+};
+
+/*
+ * the largest share of nonzero inputs forward multiplies by only their columns of the panels. past it the
+ * indices cost more than the skipped columns save, and the panels are read whole.
+ */
+#define DENSE_SPARSE_INPUT 0.6
+
+// a buffer of packed weights, aligned for the vector loads of the kernels.
+typedef std::vector<float, AlignedAllocator<float, GEMM_ALIGNMENT>> PackedWeights;
+
+/**
+ * packs row-major weights into panels: a panel holds SIMD_PANEL_ROWS rows (the last one padded with zero
+ * rows) column after column, so every column of a panel is one aligned cache line. Dense and StaticDense
+ * pack their weights with it.
+ * @param w the first float of the rows x cols weights.
+ * @param rows the number of rows.
+ * @param cols the number of cols.
+ * @param ld the distance (in floats) between two rows of w.
+ * @param panels a 64 byte aligned buffer of ceil(rows / SIMD_PANEL_ROWS) * SIMD_PANEL_ROWS * cols floats.
+ */
+void packPanels(const float *w, int rows, int cols, int ld, float *panels);
+
+/**
+ * the forward kernel of packed panels, writes act(W*x + b) into output in one streaming read of the panels.
+ * a mostly zero input (the background of an image, the dead units of a relu layer) is compacted once, and
+ * only the columns of its nonzeros are read. Dense and StaticDense run their panels with it.
+ * @param panels the weights packed by packPanels.
+ * @param rows the number of rows of W.
+ * @param cols the number of cols of W.
+ * @param act the activation.
+ * @param bias the bias, rows floats.
+ * @param input the input vector, cols floats.
+ * @param output the output vector, rows floats, may not overlap the input.
+ * @param index a buffer of cols + SIMD_PANEL_ROWS ints for the positions of the nonzero inputs.
+ * @param values a buffer of cols + SIMD_PANEL_ROWS floats for the nonzero inputs.
+ */
+void panelForward(const float *panels, int rows, int cols, ActivationType act, const float *bias,
+                  const float *input, float *output, int *index, float *values);
+
 /**
  * a class representing a dense in the mlpnetwork operation.
  */
@@ -10,7 +63,37 @@ class Dense
 {
 private:
     ActivationType activationType;
+    WeightPrecision precision;
+    int rows, cols;
+    // float weights borrowed from a mapped model file, read in place. empty for the other layers, which
+    // keep their weights packed (or in 16 bits) only.
     Matrix wMat, biasMat;
+    std::vector<uint16_t> halfW;
+    // the float weights packed once at construction: panels of SIMD_PANEL_ROWS rows for forward, and the
+    // blocks of sgemmPackA for forwardBatch. empty for 16 bit weights and for borrowed (mapped) weights.
+    PackedWeights panelW, gemmW;
+
+    /**
+     * packs float weights for the kernels, in the panels of packPanels and the blocks of sgemmPackA.
+     * @param w the weights, not kept.
+     */
+    void _packWeights(const Matrix &w);
+
+    /**
+     * the dot product of one row of the 16 bit weights with a vector, in the format they are stored in.
+     * @param row the index of the row.
+     * @param x a vector of cols floats.
+     * @return the dot product.
+     */
+    float _dotRow(int row, const float *x) const;
+
+    /**
+     * widens consecutive rows of 16 bit weights to float.
+     * @param firstRow the index of the first row.
+     * @param numRows the number of rows.
+     * @param out a buffer of numRows * cols floats.
+     */
+    void _widenRows(int firstRow, int numRows, float *out) const;
 public:
 
     /**
@@ -18,8 +101,27 @@ public:
      * @param w a weight matrix
      * @param bias a bias matrix
      * @param actType an enum of activation type.
+     * @param weightPrecision the format to store the weights in, the 16 bit formats round w once here.
+     */
+    Dense(const Matrix& w, const Matrix& bias, ActivationType actType, WeightPrecision weightPrecision = Float32);
+
+    /**
+     * a constructor taking over the weight and bias matrices (float weights), without copying them.
+     * matrices borrowing a mapped model file stay borrowed, and are not packed.
+     * @param w a weight matrix
+     * @param bias a bias matrix
+     * @param actType an enum of activation type.
      */
-    Dense(const Matrix& w, const Matrix& bias, ActivationType actType);
+    Dense(Matrix&& w, Matrix&& bias, ActivationType actType);
+
+    /**
+     * a constructor reading read only float weights in place (like the pages of a mapped model file), they
+     * are not copied and not packed. weights with padded rows are copied (and packed) instead.
+     * @param w a view of a weight matrix, it has to outlive the dense.
+     * @param bias a view of a bias matrix, it has to outlive the dense.
+     * @param actType an enum of activation type.
+     */
+    Dense(ConstMatrixView w, ConstMatrixView bias, ActivationType actType);
 
     /**
      * a const getter, returning an activation according to the activation type.
@@ -29,22 +131,80 @@ public:
 
     /**
      * a const getter, returning the bias matrix
-     * @return the bias matrix
+     * @return a reference to the bias matrix
      */
-    Matrix getBias() const;
+    const Matrix &getBias() const;
 
     /**
-     * a const getter, returning the weight matrix
-     * @return the weight matrix
+     * a const getter, returning the weight matrix (unpacked from the panels, or widened to float when stored
+     * in 16 bits)
+     * @return a packed copy of the weight matrix
      */
     Matrix getWeights() const;
 
+    /**
+     * a const getter, returning the number of outputs of the dense.
+     * @return the number of rows of the weight matrix.
+     */
+    int getRows() const;
+
+    /**
+     * a const getter, returning the number of inputs of the dense.
+     * @return the number of cols of the weight matrix.
+     */
+    int getCols() const;
+
+    /**
+     * a const getter, returning the format the weights are stored in.
+     * @return the precision of the weights.
+     */
+    WeightPrecision getPrecision() const;
+
+    /**
+     * a const getter, returning the memory the weights take.
+     * @return the number of bytes of the weights.
+     */
+    size_t weightBytes() const;
+
+    /**
+     * a const getter, returning the work of the forward kernels.
+     * @param batch the number of inputs.
+     * @return the floating point operations of a product with batch inputs.
+     */
+    double flops(int batch) const;
+
     /**
      * an override method overriding the () operator, operating the dense on the give matrix
      * @param matrix a const matrix to operate on.
      * @return the matrix after the operation.
      */
-    Matrix operator()(const Matrix& matrix);
+    Matrix operator()(const Matrix& matrix) const;
+
+    /**
+     * the fused forward kernel, writes act(W*x + b) into output in one streaming read of the weights,
+     * without allocating and without copying the weights.
+     * @param input the input vector, getCols() floats.
+     * @param output the output vector, getRows() floats, may not overlap the input.
+     */
+    void forward(const float *input, float *output) const;
+
+    /**
+     * the batched forward kernel, writes act(W*X + b) into output, where every column of X is one input
+     * vector. the product is a single matrix-matrix multiplication, so the weights are read once per batch.
+     * the input and the output may be views (like a tile of the columns of a larger batch), read and written
+     * in place with their strides.
+     * @param input a getCols() x N matrix, one input per column.
+     * @param output a getRows() x N matrix for the results, one result per column, may not overlap the input.
+     */
+    void forwardBatch(ConstMatrixView input, MatrixView output) const;
+
+    /**
+     * the batched forward kernel on raw row-major buffers, writes act(W*X + b) into output.
+     * @param input getCols() x batch floats, one input per column.
+     * @param batch the number of inputs.
+     * @param output getRows() x batch floats for the results, may not overlap the input.
+     */
+    void forwardBatch(const float *input, int batch, float *output) const;
 };
 
 #endif //CPP1_DENSE_H
@@ -0,0 +1,831 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+#include "Gemm.h"
+#include "Profile.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_X86
+#endif
+
+// the pool of the opted in parallel products and their minimal size.
+static std::atomic<ThreadPool *> gParallelPool(nullptr);
+static std::atomic<long> gParallelWork(GEMM_PARALLEL_WORK);
+// the smallest dimension of the products sgemm computes with Strassen-Winograd, 0 for never.
+static std::atomic<int> gStrassenSize(GEMM_STRASSEN_SIZE);
+
+/**
+ * a micro-kernel type, computing a GEMM_MR x GEMM_NR tile of C = alpha * A * B + beta * C
+ * out of a packed sliver of A and a packed sliver of B.
+ */
+typedef void (*MicroKernel)(int kc, const float *a, const float *b, float *c, int ldc, float alpha, float beta);
+
+/**
+ * an aligned scratch buffer for the packed panels, one per thread, allocated once.
+ */
+struct PackBuffer
+{
+    float *data;
+
+    /**
+     * allocates an aligned buffer for the given number of floats.
+     * @param size the number of floats, a multiple of GEMM_ALIGNMENT / sizeof(float).
+     */
+    explicit PackBuffer(size_t size) : data((float *) std::aligned_alloc(GEMM_ALIGNMENT, size * sizeof(float)))
+    {
+        PROFILE_ALLOCATION(size * sizeof(float));
+    }
+
+    /**
+     * frees the buffer.
+     */
+    ~PackBuffer()
+    {
+        std::free(data);
+    }
+
+    PackBuffer(const PackBuffer &) = delete;
+    PackBuffer &operator=(const PackBuffer &) = delete;
+};
+
+/**
+ * a whole A packed by sgemmPackA, and the row of A the product (or the panel of a parallel product) starts at.
+ */
+struct PackedA
+{
+    const float *data;
+    int paddedRows;
+    int firstRow;
+};
+
+/**
+ * stores an accumulated tile into C, C = alpha * acc + beta * C, C is not read when beta is 0.
+ * @param acc the accumulated tile, GEMM_NR floats per row.
+ * @param rows the number of rows to store
+ * @param cols the number of cols to store
+ * @param c the first float of the tile in C
+ * @param ldc the distance between two rows of C
+ * @param alpha a scalar for acc
+ * @param beta a scalar for C
+ */
+static void _storeTile(const float *acc, int rows, int cols, float *c, int ldc, float alpha, float beta)
+{
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            float val = alpha * acc[i * GEMM_NR + j];
+            c[i * ldc + j] = (beta == 0) ? val : val + beta * c[i * ldc + j];
+        }
+    }
+}
+
+/**
+ * the portable micro-kernel, used when the cpu has no AVX2/FMA.
+ * @param kc the depth of the packed slivers
+ * @param a a packed sliver of A, GEMM_MR floats per k
+ * @param b a packed sliver of B, GEMM_NR floats per k
+ * @param c the first float of the tile in C
+ * @param ldc the distance between two rows of C
+ * @param alpha a scalar for A * B
+ * @param beta a scalar for C
+ */
+static void _kernelGeneric(int kc, const float *a, const float *b, float *c, int ldc, float alpha, float beta)
+{
+    float acc[GEMM_MR * GEMM_NR] = {};
+    for (int p = 0; p < kc; ++p)
+    {
+        for (int i = 0; i < GEMM_MR; ++i)
+        {
+            float ai = a[i];
+            for (int j = 0; j < GEMM_NR; ++j)
+            {
+                acc[i * GEMM_NR + j] += ai * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    _storeTile(acc, GEMM_MR, GEMM_NR, c, ldc, alpha, beta);
+}
+
+#ifdef GEMM_X86
+/**
+ * the AVX2/FMA micro-kernel, keeps the whole 6 x 16 tile in 12 ymm registers.
+ * @param kc the depth of the packed slivers
+ * @param a a packed sliver of A, GEMM_MR floats per k
+ * @param b a packed sliver of B, GEMM_NR floats per k (aligned)
+ * @param c the first float of the tile in C
+ * @param ldc the distance between two rows of C
+ * @param alpha a scalar for A * B
+ * @param beta a scalar for C
+ */
+__attribute__((target("avx2,fma")))
+static void _kernelAvx2(int kc, const float *a, const float *b, float *c, int ldc, float alpha, float beta)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (int p = 0; p < kc; ++p)
+    {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 ai = _mm256_broadcast_ss(a);
+        c00 = _mm256_fmadd_ps(ai, b0, c00);
+        c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(ai, b0, c10);
+        c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(ai, b0, c20);
+        c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(ai, b0, c30);
+        c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(ai, b0, c40);
+        c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(ai, b0, c50);
+        c51 = _mm256_fmadd_ps(ai, b1, c51);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    __m256 acc[GEMM_MR * 2] = {c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51};
+    __m256 va = _mm256_set1_ps(alpha);
+    __m256 vb = _mm256_set1_ps(beta);
+    for (int i = 0; i < GEMM_MR; ++i)
+    {
+        for (int h = 0; h < 2; ++h)
+        {
+            float *dst = c + i * ldc + h * 8;
+            __m256 val = _mm256_mul_ps(va, acc[i * 2 + h]);
+            if (beta != 0)
+            {
+                val = _mm256_fmadd_ps(vb, _mm256_loadu_ps(dst), val);
+            }
+            _mm256_storeu_ps(dst, val);
+        }
+    }
+}
+#endif
+
+/**
+ * picks the best micro-kernel for the running cpu.
+ * @return the micro-kernel.
+ */
+static MicroKernel _selectKernel()
+{
+#ifdef GEMM_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return _kernelAvx2;
+    }
+#endif
+    return _kernelGeneric;
+}
+
+/**
+ * packs an mc x kc block of A into slivers of GEMM_MR rows, k-major inside a sliver,
+ * missing rows of the last sliver are padded with zeros.
+ * @param mc the number of rows of the block
+ * @param kc the number of cols of the block
+ * @param a the first float of the block
+ * @param lda the distance between two rows of A
+ * @param dst the packed buffer
+ */
+static void _packA(int mc, int kc, const float *a, int lda, float *dst)
+{
+    for (int i0 = 0; i0 < mc; i0 += GEMM_MR)
+    {
+        int rows = (mc - i0 < GEMM_MR) ? mc - i0 : GEMM_MR;
+        for (int p = 0; p < kc; ++p)
+        {
+            int i = 0;
+            for (; i < rows; ++i)
+            {
+                dst[i] = a[(i0 + i) * lda + p];
+            }
+            for (; i < GEMM_MR; ++i)
+            {
+                dst[i] = 0;
+            }
+            dst += GEMM_MR;
+        }
+    }
+}
+
+/**
+ * packs a kc x nc block of B into slivers of GEMM_NR cols, k-major inside a sliver,
+ * missing cols of the last sliver are padded with zeros.
+ * @param kc the number of rows of the block
+ * @param nc the number of cols of the block
+ * @param b the first float of the block
+ * @param ldb the distance between two rows of B
+ * @param dst the packed buffer
+ */
+static void _packB(int kc, int nc, const float *b, int ldb, float *dst)
+{
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR)
+    {
+        int cols = (nc - j0 < GEMM_NR) ? nc - j0 : GEMM_NR;
+        for (int p = 0; p < kc; ++p)
+        {
+            const float *src = b + p * ldb + j0;
+            int j = 0;
+            for (; j < cols; ++j)
+            {
+                dst[j] = src[j];
+            }
+            for (; j < GEMM_NR; ++j)
+            {
+                dst[j] = 0;
+            }
+            dst += GEMM_NR;
+        }
+    }
+}
+
+/**
+ * multiplies a packed mc x kc block of A by a packed kc x nc panel of B into C, tile by tile.
+ * edge tiles are computed into a local tile and only their valid part is stored.
+ * @param kernel the micro-kernel to use
+ * @param mc the number of rows of the block
+ * @param nc the number of cols of the panel
+ * @param kc the depth of the block
+ * @param packA the packed block of A
+ * @param packB the packed panel of B
+ * @param c the first float of the C block
+ * @param ldc the distance between two rows of C
+ * @param alpha a scalar for A * B
+ * @param beta a scalar for C
+ */
+static void _macroKernel(MicroKernel kernel, int mc, int nc, int kc, const float *packA, const float *packB,
+                         float *c, int ldc, float alpha, float beta)
+{
+    alignas(GEMM_ALIGNMENT) float edge[GEMM_MR * GEMM_NR];
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR)
+    {
+        int cols = (nc - j0 < GEMM_NR) ? nc - j0 : GEMM_NR;
+        const float *b = packB + j0 * kc;
+        for (int i0 = 0; i0 < mc; i0 += GEMM_MR)
+        {
+            int rows = (mc - i0 < GEMM_MR) ? mc - i0 : GEMM_MR;
+            const float *a = packA + i0 * kc;
+            float *dst = c + i0 * ldc + j0;
+            if (rows == GEMM_MR && cols == GEMM_NR)
+            {
+                kernel(kc, a, b, dst, ldc, alpha, beta);
+            }
+            else
+            {
+                kernel(kc, a, b, edge, GEMM_NR, 1, 0);
+                _storeTile(edge, rows, cols, dst, ldc, alpha, beta);
+            }
+        }
+    }
+}
+
+/**
+ * the unpacked path for products too small to amortize the packing, and for matrix-vector products.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param alpha a scalar for A * B
+ * @param a the first float of A
+ * @param lda the distance between two rows of A
+ * @param b the first float of B
+ * @param ldb the distance between two rows of B
+ * @param beta a scalar for C
+ * @param c the first float of C
+ * @param ldc the distance between two rows of C
+ */
+static void _smallGemm(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+                       float beta, float *c, int ldc)
+{
+    if (n == 1)
+    {
+        // a matrix-vector product is a dot product per row of A. a col of B that is not contiguous is gathered
+        // once into a buffer of the thread, so the dot products stay vectorized.
+        const SimdKernels &kernels = simdKernels();
+        const float *x = b;
+        if (ldb != 1 && k > 1)
+        {
+            static thread_local std::vector<float> column;
+            column.resize(std::max(column.size(), (size_t) k));
+            for (int p = 0; p < k; ++p)
+            {
+                column[p] = b[(size_t) p * ldb];
+            }
+            x = column.data();
+        }
+        for (int i = 0; i < m; ++i)
+        {
+            const float sum = kernels.dot(a + (size_t) i * lda, x, k);
+            c[(size_t) i * ldc] = (beta == 0) ? alpha * sum : alpha * sum + beta * c[(size_t) i * ldc];
+        }
+        return;
+    }
+    for (int i = 0; i < m; ++i)
+    {
+        float *row = c + i * ldc;
+        for (int j = 0; j < n; ++j)
+        {
+            row[j] = (beta == 0) ? 0 : beta * row[j];
+        }
+        for (int p = 0; p < k; ++p)
+        {
+            float aip = alpha * a[i * lda + p];
+            const float *bRow = b + p * ldb;
+            for (int j = 0; j < n; ++j)
+            {
+                row[j] += aip * bRow[j];
+            }
+        }
+    }
+}
+
+/**
+ * the cache blocked product of sgemm, on packed panels with the micro-kernel.
+ * @param packed A packed ahead by sgemmPackA, or nullptr to pack the blocks of a here.
+ * the other parameters are the same as sgemm's.
+ */
+static void _blockedGemm(int m, int n, int k, float alpha, const float *a, int lda, const PackedA *packed,
+                         const float *b, int ldb, float beta, float *c, int ldc)
+{
+    static const MicroKernel kernel = _selectKernel();
+    static thread_local PackBuffer packA(GEMM_MC * GEMM_KC);
+    static thread_local PackBuffer packB(GEMM_KC * GEMM_NC);
+    for (int jc = 0; jc < n; jc += GEMM_NC)
+    {
+        int nc = (n - jc < GEMM_NC) ? n - jc : GEMM_NC;
+        for (int pc = 0; pc < k; pc += GEMM_KC)
+        {
+            int kc = (k - pc < GEMM_KC) ? k - pc : GEMM_KC;
+            // only the first k block applies beta, the later ones accumulate.
+            float betaBlock = (pc == 0) ? beta : 1;
+            _packB(kc, nc, b + pc * ldb + jc, ldb, packB.data);
+            for (int ic = 0; ic < m; ic += GEMM_MC)
+            {
+                int mc = (m - ic < GEMM_MC) ? m - ic : GEMM_MC;
+                const float *blockA = packA.data;
+                if (packed != nullptr)
+                {
+                    blockA = packed->data + (size_t) pc * packed->paddedRows + (size_t) (packed->firstRow + ic) * kc;
+                }
+                else
+                {
+                    _packA(mc, kc, a + ic * lda + pc, lda, packA.data);
+                }
+                _macroKernel(kernel, mc, nc, kc, blockA, packB.data, c + ic * ldc + jc, ldc, alpha, betaBlock);
+            }
+        }
+    }
+}
+
+/**
+ * splits C into GEMM_MC x GEMM_PARALLEL_NC panels and runs _blockedGemm on every panel as a task of the pool.
+ * the panels start on multiples of the micro-kernel tile, so every tile is computed exactly as in the
+ * serial product.
+ * the other parameters are the same as sgemm's.
+ */
+static void _parallelGemm(ThreadPool &pool, int m, int n, int k, float alpha, const float *a, int lda,
+                          const PackedA *packed, const float *b, int ldb, float beta, float *c, int ldc)
+{
+    const int rowPanels = (m + GEMM_MC - 1) / GEMM_MC;
+    const int colPanels = (n + GEMM_PARALLEL_NC - 1) / GEMM_PARALLEL_NC;
+    pool.parallelFor(0, rowPanels * colPanels, 1, [&](int first, int last)
+    {
+        for (int panel = first; panel < last; ++panel)
+        {
+            int i0 = (panel / colPanels) * GEMM_MC;
+            int j0 = (panel % colPanels) * GEMM_PARALLEL_NC;
+            int rows = (m - i0 < GEMM_MC) ? m - i0 : GEMM_MC;
+            int cols = (n - j0 < GEMM_PARALLEL_NC) ? n - j0 : GEMM_PARALLEL_NC;
+            if (packed != nullptr)
+            {
+                const PackedA panelA = {packed->data, packed->paddedRows, packed->firstRow + i0};
+                _blockedGemm(rows, cols, k, alpha, a + i0 * lda, lda, &panelA, b + j0, ldb, beta,
+                             c + i0 * ldc + j0, ldc);
+                continue;
+            }
+            _blockedGemm(rows, cols, k, alpha, a + i0 * lda, lda, nullptr, b + j0, ldb, beta, c + i0 * ldc + j0, ldc);
+        }
+    });
+}
+
+/**
+ * checks whether a product is too small (or too narrow) for the packed path.
+ * @param m the number of rows of C
+ * @param n the number of cols of C
+ * @param k the depth of the product
+ * @return true if the product should use the unpacked path.
+ */
+static bool _isSmall(int m, int n, int k)
+{
+    return n == 1 || (long) m * n * k < GEMM_SMALL_WORK;
+}
+
+/**
+ * the classic O(m * n * k) product of sgemm: unpacked when small, else blocked, in parallel when opted in.
+ * the parameters are the same as sgemm's.
+ */
+static void _classicGemm(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+                         float beta, float *c, int ldc)
+{
+    if (_isSmall(m, n, k))
+    {
+        _smallGemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+    ThreadPool *pool = gParallelPool.load(std::memory_order_acquire);
+    if (pool != nullptr && (long) m * n * k >= gParallelWork.load(std::memory_order_relaxed))
+    {
+        _parallelGemm(*pool, m, n, k, alpha, a, lda, nullptr, b, ldb, beta, c, ldc);
+        return;
+    }
+    _blockedGemm(m, n, k, alpha, a, lda, nullptr, b, ldb, beta, c, ldc);
+}
+
+/**
+ * z = x + y on blocks of rows, z may be x or y.
+ * @param rows the number of rows of the blocks
+ * @param cols the number of cols of the blocks
+ * @param x the first float of x
+ * @param ldx the distance between two rows of x
+ * @param y the first float of y
+ * @param ldy the distance between two rows of y
+ * @param z the first float of z
+ * @param ldz the distance between two rows of z
+ */
+static void _addBlocks(int rows, int cols, const float *x, int ldx, const float *y, int ldy, float *z, int ldz)
+{
+    const SimdKernels &kernels = simdKernels();
+    for (int i = 0; i < rows; ++i)
+    {
+        kernels.add(z + (size_t) i * ldz, x + (size_t) i * ldx, y + (size_t) i * ldy, cols);
+    }
+}
+
+/**
+ * z = x - y on blocks of rows, z may be x or y.
+ * the parameters are the same as _addBlocks'.
+ */
+static void _subtractBlocks(int rows, int cols, const float *x, int ldx, const float *y, int ldy, float *z,
+                            int ldz)
+{
+    const SimdKernels &kernels = simdKernels();
+    for (int i = 0; i < rows; ++i)
+    {
+        float *zRow = z + (size_t) i * ldz;
+        const float *xRow = x + (size_t) i * ldx, *yRow = y + (size_t) i * ldy;
+        if (zRow == xRow)
+        {
+            kernels.axpy(zRow, -1, yRow, cols);
+        }
+        else
+        {
+            // -y is written first, which is fine when z is y.
+            kernels.scale(zRow, yRow, -1, cols);
+            kernels.add(zRow, zRow, xRow, cols);
+        }
+    }
+}
+
+/**
+ * the floats of the temporaries of one level of _winograd, on the halves of an even m x n x k product.
+ * @param m2 half the rows of A and C
+ * @param n2 half the cols of B and C
+ * @param k2 half the cols of A and rows of B
+ * @return the size of X (a sum of A blocks, then a product) and Y (a sum of B blocks).
+ */
+static size_t _winogradLevelSize(size_t m2, size_t n2, size_t k2)
+{
+    return m2 * std::max(k2, n2) + k2 * n2;
+}
+
+/**
+ * the floats of the workspace of _winograd, summed over the levels of the recursion.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param cutoff the recursion stops at products with a dimension of at most cutoff.
+ * @return the size of the workspace.
+ */
+static size_t _winogradSize(int m, int n, int k, int cutoff)
+{
+    size_t size = 0;
+    while (std::min(m, std::min(n, k)) > cutoff)
+    {
+        m /= 2;
+        n /= 2;
+        k /= 2;
+        size += _winogradLevelSize(m, n, k);
+    }
+    return size;
+}
+
+/**
+ * C = A * B with Strassen's algorithm in Winograd's form: 7 half size products and 15 block additions per
+ * level, recursing down to the classic product at the cutoff. a level works on the even part of the product,
+ * an odd last row, col or depth is peeled off and computed by the classic product. the temporaries come from
+ * the workspace (X and Y of this level, then those of the deeper levels), and C is used for the others, in the
+ * schedule of Douglas et al. (1994).
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param a the first float of A
+ * @param lda the distance between two rows of A
+ * @param b the first float of B
+ * @param ldb the distance between two rows of B
+ * @param c the first float of C, not read
+ * @param ldc the distance between two rows of C
+ * @param workspace _winogradSize(m, n, k, cutoff) floats
+ * @param cutoff the largest dimension of a product the classic product computes.
+ */
+static void _winograd(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc,
+                      float *workspace, int cutoff)
+{
+    if (std::min(m, std::min(n, k)) <= cutoff)
+    {
+        _classicGemm(m, n, k, 1, a, lda, b, ldb, 0, c, ldc);
+        return;
+    }
+    const int m2 = m / 2, n2 = n / 2, k2 = k / 2;
+    const float *a11 = a, *a12 = a + k2, *a21 = a + (size_t) m2 * lda, *a22 = a21 + k2;
+    const float *b11 = b, *b12 = b + n2, *b21 = b + (size_t) k2 * ldb, *b22 = b21 + n2;
+    float *c11 = c, *c12 = c + n2, *c21 = c + (size_t) m2 * ldc, *c22 = c21 + n2;
+    float *x = workspace, *y = workspace + (size_t) m2 * std::max(k2, n2);
+    float *deeper = workspace + _winogradLevelSize(m2, n2, k2);
+
+    _subtractBlocks(m2, k2, a11, lda, a21, lda, x, k2);                    // S3 = A11 - A21
+    _subtractBlocks(k2, n2, b22, ldb, b12, ldb, y, n2);                    // T3 = B22 - B12
+    _winograd(m2, n2, k2, x, k2, y, n2, c21, ldc, deeper, cutoff);         // P7 = S3 T3
+    _addBlocks(m2, k2, a21, lda, a22, lda, x, k2);                         // S1 = A21 + A22
+    _subtractBlocks(k2, n2, b12, ldb, b11, ldb, y, n2);                    // T1 = B12 - B11
+    _winograd(m2, n2, k2, x, k2, y, n2, c22, ldc, deeper, cutoff);         // P5 = S1 T1
+    _subtractBlocks(m2, k2, x, k2, a11, lda, x, k2);                       // S2 = S1 - A11
+    _subtractBlocks(k2, n2, b22, ldb, y, n2, y, n2);                       // T2 = B22 - T1
+    _winograd(m2, n2, k2, x, k2, y, n2, c12, ldc, deeper, cutoff);         // P6 = S2 T2
+    _subtractBlocks(m2, k2, a12, lda, x, k2, x, k2);                       // S4 = A12 - S2
+    _winograd(m2, n2, k2, x, k2, b22, ldb, c11, ldc, deeper, cutoff);      // P3 = S4 B22
+    _winograd(m2, n2, k2, a11, lda, b11, ldb, x, n2, deeper, cutoff);      // P1 = A11 B11
+    _addBlocks(m2, n2, x, n2, c12, ldc, c12, ldc);                         // U2 = P1 + P6
+    _addBlocks(m2, n2, c12, ldc, c21, ldc, c21, ldc);                      // U3 = U2 + P7
+    _addBlocks(m2, n2, c12, ldc, c22, ldc, c12, ldc);                      // U4 = U2 + P5
+    _addBlocks(m2, n2, c21, ldc, c22, ldc, c22, ldc);                      // C22 = U3 + P5
+    _addBlocks(m2, n2, c12, ldc, c11, ldc, c12, ldc);                      // C12 = U4 + P3
+    _subtractBlocks(k2, n2, y, n2, b21, ldb, y, n2);                       // T4 = T2 - B21
+    _winograd(m2, n2, k2, a22, lda, y, n2, c11, ldc, deeper, cutoff);      // P4 = A22 T4
+    _subtractBlocks(m2, n2, c21, ldc, c11, ldc, c21, ldc);                 // C21 = U3 - P4
+    _winograd(m2, n2, k2, a12, lda, b21, ldb, c11, ldc, deeper, cutoff);   // P2 = A12 B21
+    _addBlocks(m2, n2, x, n2, c11, ldc, c11, ldc);                         // C11 = P1 + P2
+
+    // the peeled depth, row and col.
+    const int evenM = 2 * m2, evenN = 2 * n2, evenK = 2 * k2;
+    if (evenK < k)
+    {
+        _classicGemm(evenM, evenN, 1, 1, a + evenK, lda, b + (size_t) evenK * ldb, ldb, 1, c, ldc);
+    }
+    if (evenN < n)
+    {
+        _classicGemm(evenM, 1, k, 1, a, lda, b + evenN, ldb, 0, c + evenN, ldc);
+    }
+    if (evenM < m)
+    {
+        _classicGemm(1, n, k, 1, a + (size_t) evenM * lda, lda, b, ldb, 0, c + (size_t) evenM * ldc, ldc);
+    }
+}
+
+/**
+ * the floats of the workspace of sgemmStrassen.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param alpha the scalar of A * B
+ * @param beta the scalar of C
+ * @param cutoff the recursion stops at products with a dimension of at most cutoff.
+ * @return the size of the workspace, 0 for a product the classic way.
+ */
+size_t sgemmStrassenWorkspace(int m, int n, int k, float alpha, float beta, int cutoff)
+{
+    if (m <= 0 || n <= 0 || k <= 0 || std::min(m, std::min(n, k)) <= std::max(cutoff, 1))
+    {
+        return 0;
+    }
+    // a product that is scaled, or added to C, is computed aside first.
+    const size_t aside = (alpha == 1 && beta == 0) ? 0 : (size_t) m * n;
+    return aside + _winogradSize(m, n, k, std::max(cutoff, 1));
+}
+
+/**
+ * sgemm with Strassen's algorithm in Winograd's form, O(n^2.81) instead of O(n^3) multiply-adds. it recurses
+ * on the halves of the product down to products with a dimension of at most cutoff, which the classic sgemm
+ * computes, and it allocates nothing: the temporaries of every level are in the workspace.
+ * the result is not bitwise that of sgemm, its error grows by a constant factor per level (Higham, Accuracy
+ * and Stability of Numerical Algorithms, 23.2.2).
+ * @param workspace a buffer of sgemmStrassenWorkspace(m, n, k, alpha, beta, cutoff) floats
+ * @param cutoff the recursion stops at products with a dimension of at most cutoff.
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmStrassen(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+                   float beta, float *c, int ldc, float *workspace, int cutoff)
+{
+    if (m <= 0 || n <= 0 || k <= 0)
+    {
+        return;
+    }
+    cutoff = std::max(cutoff, 1);
+    if (std::min(m, std::min(n, k)) <= cutoff)
+    {
+        _classicGemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+    if (alpha == 1 && beta == 0)
+    {
+        _winograd(m, n, k, a, lda, b, ldb, c, ldc, workspace, cutoff);
+        return;
+    }
+    float *product = workspace;
+    _winograd(m, n, k, a, lda, b, ldb, product, n, workspace + (size_t) m * n, cutoff);
+    const SimdKernels &kernels = simdKernels();
+    for (int i = 0; i < m; ++i)
+    {
+        float *row = c + (size_t) i * ldc;
+        if (beta == 0)
+        {
+            kernels.scale(row, product + (size_t) i * n, alpha, n);
+        }
+        else
+        {
+            kernels.scale(row, row, beta, n);
+            kernels.axpy(row, alpha, product + (size_t) i * n, n);
+        }
+    }
+}
+
+/**
+ * a general single precision matrix multiplication on row-major buffers:
+ * C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n.
+ * large products are computed with cache blocking, packed panels and a register tiled micro-kernel,
+ * and products with every dimension of at least the Strassen size (setGemmStrassenSize) with sgemmStrassen.
+ * when beta is 0, C is never read.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param alpha a scalar for A * B
+ * @param a a pointer to the first float of A
+ * @param lda the distance (in floats) between two rows of A
+ * @param b a pointer to the first float of B
+ * @param ldb the distance (in floats) between two rows of B
+ * @param beta a scalar for the previous values of C
+ * @param c a pointer to the first float of C
+ * @param ldc the distance (in floats) between two rows of C
+ */
+void sgemm(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+           float beta, float *c, int ldc)
+{
+    if (m <= 0 || n <= 0 || k <= 0)
+    {
+        return;
+    }
+    const int strassenSize = gStrassenSize.load(std::memory_order_relaxed);
+    if (strassenSize > 0 && std::min(m, std::min(n, k)) >= strassenSize)
+    {
+        // one workspace per thread, grown to the largest product so far.
+        static thread_local std::vector<float> workspace;
+        const size_t size = sgemmStrassenWorkspace(m, n, k, alpha, beta, GEMM_STRASSEN_CUTOFF);
+        if (workspace.size() < size)
+        {
+            workspace.resize(size);
+        }
+        sgemmStrassen(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, workspace.data(), GEMM_STRASSEN_CUTOFF);
+        return;
+    }
+    _classicGemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+/**
+ * sgemm with the panels of C computed in parallel on the workers of a pool. every element of C is
+ * computed by one task with the same blocking and summation order as sgemm, so the result is bitwise
+ * identical to the serial one, whatever the number of threads.
+ * @param pool the pool to run the panels on
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmParallel(ThreadPool &pool, int m, int n, int k, float alpha, const float *a, int lda,
+                   const float *b, int ldb, float beta, float *c, int ldc)
+{
+    if (m <= 0 || n <= 0 || k <= 0)
+    {
+        return;
+    }
+    if (_isSmall(m, n, k))
+    {
+        _smallGemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+    _parallelGemm(pool, m, n, k, alpha, a, lda, nullptr, b, ldb, beta, c, ldc);
+}
+
+/**
+ * rounds a number of rows up to whole GEMM_MR slivers.
+ * @param m a number of rows.
+ * @return the number of rows of the slivers.
+ */
+static int _paddedRows(int m)
+{
+    return (m + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+}
+
+/**
+ * the number of floats of A packed by sgemmPackA.
+ * @param m the number of rows of A
+ * @param k the number of cols of A
+ * @return the size of the packed A.
+ */
+size_t sgemmPackedSize(int m, int k)
+{
+    return (m <= 0 || k <= 0) ? 0 : (size_t) _paddedRows(m) * k;
+}
+
+/**
+ * packs the whole of A once in the layout the blocked product reads its blocks in (GEMM_MR row slivers of
+ * every GEMM_KC deep block), so a constant A (the weights of a layer) is not packed again by every product.
+ * @param m the number of rows of A
+ * @param k the number of cols of A
+ * @param a a pointer to the first float of A
+ * @param lda the distance (in floats) between two rows of A
+ * @param dst a buffer of sgemmPackedSize(m, k) floats
+ */
+void sgemmPackA(int m, int k, const float *a, int lda, float *dst)
+{
+    // the block of rows ic of the k block pc is where _blockedGemm looks for it.
+    const size_t paddedRows = (size_t) _paddedRows(m);
+    for (int pc = 0; pc < k; pc += GEMM_KC)
+    {
+        int kc = (k - pc < GEMM_KC) ? k - pc : GEMM_KC;
+        for (int ic = 0; ic < m; ic += GEMM_MC)
+        {
+            int mc = (m - ic < GEMM_MC) ? m - ic : GEMM_MC;
+            _packA(mc, kc, a + ic * lda + pc, lda, dst + pc * paddedRows + (size_t) ic * kc);
+        }
+    }
+}
+
+/**
+ * sgemm with A packed by sgemmPackA. the product is the same as sgemm's, bit for bit, and it is computed in
+ * parallel under the same conditions. products too small for the blocked path read the unpacked A, or take
+ * the blocked path anyway (not bit for bit sgemm's then) when a is nullptr, for an A only kept packed.
+ * @param a a pointer to the first float of A, or nullptr
+ * @param packedA the packed A, from sgemmPackA(m, k, a, lda, packedA)
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmPacked(int m, int n, int k, float alpha, const float *a, int lda, const float *packedA,
+                 const float *b, int ldb, float beta, float *c, int ldc)
+{
+    if (m <= 0 || n <= 0 || k <= 0)
+    {
+        return;
+    }
+    if (a != nullptr && _isSmall(m, n, k))
+    {
+        _smallGemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+    const PackedA packed = {packedA, _paddedRows(m), 0};
+    ThreadPool *pool = gParallelPool.load(std::memory_order_acquire);
+    if (pool != nullptr && (long) m * n * k >= gParallelWork.load(std::memory_order_relaxed))
+    {
+        _parallelGemm(*pool, m, n, k, alpha, a, lda, &packed, b, ldb, beta, c, ldc);
+        return;
+    }
+    _blockedGemm(m, n, k, alpha, a, lda, &packed, b, ldb, beta, c, ldc);
+}
+
+/**
+ * opts every later sgemm (and so every Matrix product) into sgemmParallel for products of at least
+ * threshold multiply-adds. products below it stay serial.
+ * @param pool the pool to use, nullptr to go back to serial products.
+ * @param threshold the minimal number of multiply-adds (m * n * k) of a parallel product.
+ */
+void setGemmThreadPool(ThreadPool *pool, long threshold)
+{
+    gParallelWork.store(threshold, std::memory_order_relaxed);
+    gParallelPool.store(pool, std::memory_order_release);
+}
+
+/**
+ * sets the smallest dimension of the products every later sgemm computes with sgemmStrassen.
+ * @param size the smallest of m, n and k of a Strassen product, 0 to compute every product the classic way.
+ */
+void setGemmStrassenSize(int size)
+{
+    gStrassenSize.store(std::max(size, 0), std::memory_order_relaxed);
+}
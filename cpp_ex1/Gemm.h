@@ -0,0 +1,135 @@
+// Gemm.h
+
+#ifndef GEMM_H
+#define GEMM_H
+
+// register tile of the micro-kernel: GEMM_MR rows of A times GEMM_NR cols of B.
+#define GEMM_MR 6
+#define GEMM_NR 16
+
+// cache blocking: an MC x KC block of A lives in L2, a KC x NR sliver of B in L1,
+// and a KC x NC panel of B in L3.
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+// below this many multiply-adds the packing overhead is not worth it.
+#define GEMM_SMALL_WORK (32 * 32 * 32)
+
+#define GEMM_ALIGNMENT 64
+
+// a parallel product is split into GEMM_MC x GEMM_PARALLEL_NC panels of C (aligned to the micro-kernel tiles),
+// and only products of at least GEMM_PARALLEL_WORK multiply-adds are split by default.
+#define GEMM_PARALLEL_NC 512
+#define GEMM_PARALLEL_WORK (128L * 128 * 128)
+
+// Strassen-Winograd recurses down to products with a dimension of at most GEMM_STRASSEN_CUTOFF, and sgemm only
+// uses it for products with every dimension of at least GEMM_STRASSEN_SIZE, where it wins on measure (MlpBench).
+#define GEMM_STRASSEN_CUTOFF 384
+#define GEMM_STRASSEN_SIZE 1280
+
+#include <cstddef>
+
+class ThreadPool;
+
+/**
+ * a general single precision matrix multiplication on row-major buffers:
+ * C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n.
+ * large products are computed with cache blocking, packed panels and a register tiled micro-kernel,
+ * and products with every dimension of at least the Strassen size (setGemmStrassenSize) with sgemmStrassen.
+ * when beta is 0, C is never read.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param alpha a scalar for A * B
+ * @param a a pointer to the first float of A
+ * @param lda the distance (in floats) between two rows of A
+ * @param b a pointer to the first float of B
+ * @param ldb the distance (in floats) between two rows of B
+ * @param beta a scalar for the previous values of C
+ * @param c a pointer to the first float of C
+ * @param ldc the distance (in floats) between two rows of C
+ */
+void sgemm(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+           float beta, float *c, int ldc);
+
+/**
+ * sgemm with the panels of C computed in parallel on the workers of a pool. every element of C is
+ * computed by one task with the same blocking and summation order as sgemm, so the result is bitwise
+ * identical to the serial one (below the Strassen size), whatever the number of threads.
+ * @param pool the pool to run the panels on
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmParallel(ThreadPool &pool, int m, int n, int k, float alpha, const float *a, int lda,
+                   const float *b, int ldb, float beta, float *c, int ldc);
+
+/**
+ * the number of floats of A packed by sgemmPackA.
+ * @param m the number of rows of A
+ * @param k the number of cols of A
+ * @return the size of the packed A.
+ */
+size_t sgemmPackedSize(int m, int k);
+
+/**
+ * packs the whole of A once in the layout the blocked product reads its blocks in (GEMM_MR row slivers of
+ * every GEMM_KC deep block), so a constant A (the weights of a layer) is not packed again by every product.
+ * @param m the number of rows of A
+ * @param k the number of cols of A
+ * @param a a pointer to the first float of A
+ * @param lda the distance (in floats) between two rows of A
+ * @param dst a buffer of sgemmPackedSize(m, k) floats
+ */
+void sgemmPackA(int m, int k, const float *a, int lda, float *dst);
+
+/**
+ * sgemm with A packed by sgemmPackA. the product is the same as sgemm's, bit for bit, and it is computed in
+ * parallel under the same conditions. products too small for the blocked path read the unpacked A, or take
+ * the blocked path anyway (not bit for bit sgemm's then) when a is nullptr, for an A only kept packed.
+ * @param a a pointer to the first float of A, or nullptr
+ * @param packedA the packed A, from sgemmPackA(m, k, a, lda, packedA)
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmPacked(int m, int n, int k, float alpha, const float *a, int lda, const float *packedA,
+                 const float *b, int ldb, float beta, float *c, int ldc);
+
+/**
+ * opts every later sgemm (and so every Matrix product) into sgemmParallel for products of at least
+ * threshold multiply-adds. products below it stay serial.
+ * @param pool the pool to use, nullptr to go back to serial products.
+ * @param threshold the minimal number of multiply-adds (m * n * k) of a parallel product.
+ */
+void setGemmThreadPool(ThreadPool *pool, long threshold = GEMM_PARALLEL_WORK);
+
+/**
+ * the floats of the workspace of sgemmStrassen.
+ * @param m the number of rows of A and C
+ * @param n the number of cols of B and C
+ * @param k the number of cols of A and rows of B
+ * @param alpha the scalar of A * B
+ * @param beta the scalar of C
+ * @param cutoff the recursion stops at products with a dimension of at most cutoff.
+ * @return the size of the workspace, 0 for a product the classic way.
+ */
+size_t sgemmStrassenWorkspace(int m, int n, int k, float alpha, float beta, int cutoff = GEMM_STRASSEN_CUTOFF);
+
+/**
+ * sgemm with Strassen's algorithm in Winograd's form, O(n^2.81) instead of O(n^3) multiply-adds. it recurses
+ * on the halves of the product down to products with a dimension of at most cutoff, which the classic sgemm
+ * computes, and it allocates nothing: the temporaries of every level are in the workspace.
+ * the result is not bitwise that of sgemm, its error grows by a constant factor per level (Higham, Accuracy
+ * and Stability of Numerical Algorithms, 23.2.2).
+ * @param workspace a buffer of sgemmStrassenWorkspace(m, n, k, alpha, beta, cutoff) floats
+ * @param cutoff the recursion stops at products with a dimension of at most cutoff.
+ * the other parameters are the same as sgemm's.
+ */
+void sgemmStrassen(int m, int n, int k, float alpha, const float *a, int lda, const float *b, int ldb,
+                   float beta, float *c, int ldc, float *workspace, int cutoff = GEMM_STRASSEN_CUTOFF);
+
+/**
+ * sets the smallest dimension of the products every later sgemm computes with sgemmStrassen.
+ * @param size the smallest of m, n and k of a Strassen product, 0 to compute every product the classic way.
+ */
+void setGemmStrassenSize(int size);
+
+#endif //GEMM_H
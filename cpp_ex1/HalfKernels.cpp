@@ -0,0 +1,472 @@
+#include <cstring>
+#include "HalfKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HALF_X86
+#endif
+
+// ------------------------------------- conversions --------------------------------------
+
+/**
+ * converts a float to IEEE half, rounding to the nearest even.
+ * @param value the float.
+ * @return the bits of the half.
+ */
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const auto sign = (uint16_t) ((bits >> 16) & 0x8000);
+    uint32_t abs = bits & 0x7FFFFFFF;
+    if (abs >= 0x7F800000)
+    {
+        // inf stays inf, a nan stays a (quiet) nan.
+        return sign | 0x7C00 | ((abs > 0x7F800000) ? 0x200 : 0);
+    }
+    if (abs >= 0x47800000)
+    {
+        // 2^16 and above overflow to inf.
+        return sign | 0x7C00;
+    }
+    if (abs < 0x38800000)
+    {
+        // below the smallest normal half, adding 0.5 lines the half's subnormal bits up with the low bits of
+        // the float's mantissa and lets the fpu do the rounding.
+        float magnitude;
+        std::memcpy(&magnitude, &abs, sizeof(magnitude));
+        magnitude += 0.5f;
+        std::memcpy(&abs, &magnitude, sizeof(abs));
+        return sign | (uint16_t) (abs - 0x3F000000);
+    }
+    // rebias the exponent and round the 13 dropped mantissa bits to the nearest even.
+    const uint32_t odd = (abs >> 13) & 1;
+    abs += 0xC8000FFF + odd;
+    return sign | (uint16_t) (abs >> 13);
+}
+
+/**
+ * converts an IEEE half to float, exactly.
+ * @param bits the bits of the half.
+ * @return the float.
+ */
+float halfToFloat(uint16_t bits)
+{
+    const uint32_t sign = (uint32_t) (bits & 0x8000) << 16;
+    const uint32_t exponent = (bits >> 10) & 0x1F;
+    const uint32_t mantissa = bits & 0x3FF;
+    if (exponent == 0)
+    {
+        // zero or subnormal, mantissa * 2^-24.
+        float magnitude = (float) mantissa * 5.9604645e-8f;
+        return sign ? -magnitude : magnitude;
+    }
+    uint32_t result = (exponent == 0x1F) ? (sign | 0x7F800000 | (mantissa << 13))
+                                         : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+    float value;
+    std::memcpy(&value, &result, sizeof(value));
+    return value;
+}
+
+/**
+ * converts a float to bfloat16, rounding to the nearest even.
+ * @param value the float.
+ * @return the bits of the bfloat16.
+ */
+uint16_t floatToBf16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7FFFFFFF) > 0x7F800000)
+    {
+        return (uint16_t) ((bits >> 16) | 0x40);
+    }
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (uint16_t) (bits >> 16);
+}
+
+/**
+ * converts a bfloat16 to float, exactly.
+ * @param bits the bits of the bfloat16.
+ * @return the float.
+ */
+float bf16ToFloat(uint16_t bits)
+{
+    const uint32_t result = (uint32_t) bits << 16;
+    float value;
+    std::memcpy(&value, &result, sizeof(value));
+    return value;
+}
+
+// ---------------------------------------- scalar ----------------------------------------
+
+/**
+ * the sum of a[i] * b[i], a in IEEE half, one value at a time.
+ */
+static float _dotF16Scalar(const uint16_t *a, const float *b, int n)
+{
+    float sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sum += halfToFloat(a[i]) * b[i];
+    }
+    return sum;
+}
+
+/**
+ * the sum of a[i] * b[i], a in bfloat16, one value at a time.
+ */
+static float _dotBf16Scalar(const uint16_t *a, const float *b, int n)
+{
+    float sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sum += bf16ToFloat(a[i]) * b[i];
+    }
+    return sum;
+}
+
+/**
+ * y = x, x in IEEE half, one value at a time.
+ */
+static void _widenF16Scalar(float *y, const uint16_t *x, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = halfToFloat(x[i]);
+    }
+}
+
+/**
+ * y = x, x in bfloat16, one value at a time.
+ */
+static void _widenBf16Scalar(float *y, const uint16_t *x, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = bf16ToFloat(x[i]);
+    }
+}
+
+#ifdef HALF_X86
+
+/**
+ * copies the last n (less than a register of) 16 bit values and floats, either may be nullptr.
+ * the vector kernels finish their tails with one more step on zero padded copies, inline: calling the
+ * scalar kernels with dirty upper register halves costs an sse/avx transition on every call.
+ */
+static inline void _copyTail(uint16_t *dstHalves, float *dstFloats, const uint16_t *halves, const float *floats, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (dstHalves)
+        {
+            dstHalves[i] = halves[i];
+        }
+        if (dstFloats)
+        {
+            dstFloats[i] = floats[i];
+        }
+    }
+}
+
+// ------------------------------------- AVX2 + F16C --------------------------------------
+
+/**
+ * widens 8 IEEE halves with the F16C conversion.
+ */
+__attribute__((target("avx2,f16c")))
+static inline __m256 _loadF16Avx2(const uint16_t *x)
+{
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) x));
+}
+
+/**
+ * widens 8 bfloat16, a bfloat16 is the high half of a float.
+ */
+__attribute__((target("avx2")))
+static inline __m256 _loadBf16Avx2(const uint16_t *x)
+{
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) x)), 16));
+}
+
+/**
+ * the sum of the 8 lanes of a register.
+ */
+__attribute__((target("avx2")))
+static inline float _sumAvx2(__m256 acc)
+{
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+/**
+ * the sum of a[i] * b[i], a in IEEE half, 16 values at a time in 2 independent accumulators.
+ */
+__attribute__((target("avx2,fma,f16c")))
+static float _dotF16Avx2(const uint16_t *a, const float *b, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_loadF16Avx2(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_loadF16Avx2(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_loadF16Avx2(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        alignas(32) uint16_t tailA[8] = {};
+        alignas(32) float tailB[8] = {};
+        _copyTail(tailA, tailB, a + i, b + i, n - i);
+        acc1 = _mm256_fmadd_ps(_loadF16Avx2(tailA), _mm256_load_ps(tailB), acc1);
+    }
+    return _sumAvx2(_mm256_add_ps(acc0, acc1));
+}
+
+/**
+ * the sum of a[i] * b[i], a in bfloat16, 16 values at a time in 2 independent accumulators.
+ */
+__attribute__((target("avx2,fma")))
+static float _dotBf16Avx2(const uint16_t *a, const float *b, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_loadBf16Avx2(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_loadBf16Avx2(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_loadBf16Avx2(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        alignas(32) uint16_t tailA[8] = {};
+        alignas(32) float tailB[8] = {};
+        _copyTail(tailA, tailB, a + i, b + i, n - i);
+        acc1 = _mm256_fmadd_ps(_loadBf16Avx2(tailA), _mm256_load_ps(tailB), acc1);
+    }
+    return _sumAvx2(_mm256_add_ps(acc0, acc1));
+}
+
+/**
+ * y = x, x in IEEE half, 8 values at a time.
+ */
+__attribute__((target("avx2,f16c")))
+static void _widenF16Avx2(float *y, const uint16_t *x, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _loadF16Avx2(x + i));
+    }
+    if (i < n)
+    {
+        alignas(32) uint16_t tailX[8] = {};
+        alignas(32) float tailY[8];
+        _copyTail(tailX, nullptr, x + i, nullptr, n - i);
+        _mm256_store_ps(tailY, _loadF16Avx2(tailX));
+        _copyTail(nullptr, y + i, nullptr, tailY, n - i);
+    }
+}
+
+/**
+ * y = x, x in bfloat16, 8 values at a time.
+ */
+__attribute__((target("avx2")))
+static void _widenBf16Avx2(float *y, const uint16_t *x, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _loadBf16Avx2(x + i));
+    }
+    if (i < n)
+    {
+        alignas(32) uint16_t tailX[8] = {};
+        alignas(32) float tailY[8];
+        _copyTail(tailX, nullptr, x + i, nullptr, n - i);
+        _mm256_store_ps(tailY, _loadBf16Avx2(tailX));
+        _copyTail(nullptr, y + i, nullptr, tailY, n - i);
+    }
+}
+
+// ---------------------------------------- AVX-512 ---------------------------------------
+
+// the conversions go through the zero-masked forms with all lanes on, the plain forms trip gcc's
+// maybe-uninitialized warning on their undefined pass-through operand.
+#define ALL_LANES ((__mmask16) 0xFFFF)
+
+/**
+ * the mask of the first n lanes (n < 16) of a 16 float register.
+ */
+#define TAIL_MASK(n) ((__mmask16) ((1u << (n)) - 1))
+
+// an unaligned load of 16 halves (or bfloat16).
+#define LOAD_HALVES(p) _mm256_loadu_si256((const __m256i *) (p))
+
+/**
+ * widens 16 IEEE halves.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _cvtF16Avx512(__m256i x)
+{
+    return _mm512_maskz_cvtph_ps(ALL_LANES, x);
+}
+
+/**
+ * widens 16 bfloat16.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _cvtBf16Avx512(__m256i x)
+{
+    __m512i words = _mm512_maskz_cvtepu16_epi32(ALL_LANES, x);
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(ALL_LANES, words, 16));
+}
+
+/**
+ * the sum of the 16 lanes of a register, reduced through memory like the float dot product.
+ */
+__attribute__((target("avx512f")))
+static inline float _sumAvx512(__m512 acc)
+{
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    float sum = 0;
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+    return sum;
+}
+
+/**
+ * the sum of a[i] * b[i], a in IEEE half, 32 values at a time in 2 independent accumulators.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static float _dotF16Avx512(const uint16_t *a, const float *b, int n)
+{
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_cvtF16Avx512(LOAD_HALVES(a + i)), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_cvtF16Avx512(LOAD_HALVES(a + i + 16)), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_fmadd_ps(_cvtF16Avx512(LOAD_HALVES(a + i)), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        __m512 tail = _cvtF16Avx512(_mm256_maskz_loadu_epi16(m, a + i));
+        acc1 = _mm512_fmadd_ps(tail, _mm512_maskz_loadu_ps(m, b + i), acc1);
+    }
+    return _sumAvx512(_mm512_add_ps(acc0, acc1));
+}
+
+/**
+ * the sum of a[i] * b[i], a in bfloat16, 32 values at a time in 2 independent accumulators.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static float _dotBf16Avx512(const uint16_t *a, const float *b, int n)
+{
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_cvtBf16Avx512(LOAD_HALVES(a + i)), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_cvtBf16Avx512(LOAD_HALVES(a + i + 16)), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_fmadd_ps(_cvtBf16Avx512(LOAD_HALVES(a + i)), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        __m512 tail = _cvtBf16Avx512(_mm256_maskz_loadu_epi16(m, a + i));
+        acc1 = _mm512_fmadd_ps(tail, _mm512_maskz_loadu_ps(m, b + i), acc1);
+    }
+    return _sumAvx512(_mm512_add_ps(acc0, acc1));
+}
+
+/**
+ * y = x, x in IEEE half, 16 values at a time.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void _widenF16Avx512(float *y, const uint16_t *x, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _cvtF16Avx512(LOAD_HALVES(x + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _cvtF16Avx512(_mm256_maskz_loadu_epi16(m, x + i)));
+    }
+}
+
+/**
+ * y = x, x in bfloat16, 16 values at a time.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void _widenBf16Avx512(float *y, const uint16_t *x, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _cvtBf16Avx512(LOAD_HALVES(x + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _cvtBf16Avx512(_mm256_maskz_loadu_epi16(m, x + i)));
+    }
+}
+
+#endif
+
+/**
+ * checks the cpu and fills the kernel table with the widest supported instruction set.
+ * @return the kernel table.
+ */
+static HalfKernels _selectKernels()
+{
+#ifdef HALF_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+    {
+        return HalfKernels{_dotF16Avx512, _dotBf16Avx512, _widenF16Avx512, _widenBf16Avx512, "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+    {
+        return HalfKernels{_dotF16Avx2, _dotBf16Avx2, _widenF16Avx2, _widenBf16Avx2, "avx2+f16c"};
+    }
+#endif
+    return HalfKernels{_dotF16Scalar, _dotBf16Scalar, _widenF16Scalar, _widenBf16Scalar, "scalar"};
+}
+
+/**
+ * returns the kernel table for the running cpu, the cpu is checked only on the first call.
+ * @return a reference to the kernel table.
+ */
+const HalfKernels &halfKernels()
+{
+    static const HalfKernels kernels = _selectKernels();
+    return kernels;
+}
@@ -0,0 +1,77 @@
+// HalfKernels.h
+
+#ifndef HALFKERNELS_H
+#define HALFKERNELS_H
+
+#include <cstdint>
+
+/**
+ * @struct HalfKernels
+ * @brief a table of the kernels reading 16 bit weights (IEEE half or bfloat16), filled once at startup with
+ *        the widest instruction set the cpu supports (AVX-512, AVX2 with F16C, or plain scalar code).
+ *        the weights are widened to float in registers, the other operand and every sum stay float.
+ */
+typedef struct HalfKernels
+{
+    /**
+     * returns the sum of a[i] * b[i], a in IEEE half
+     */
+    float (*dotF16)(const uint16_t *a, const float *b, int n);
+
+    /**
+     * returns the sum of a[i] * b[i], a in bfloat16
+     */
+    float (*dotBf16)(const uint16_t *a, const float *b, int n);
+
+    /**
+     * y = x, x in IEEE half
+     */
+    void (*widenF16)(float *y, const uint16_t *x, int n);
+
+    /**
+     * y = x, x in bfloat16
+     */
+    void (*widenBf16)(float *y, const uint16_t *x, int n);
+
+    /**
+     * the name of the selected instruction set.
+     */
+    const char *isa;
+
+} HalfKernels;
+
+/**
+ * returns the kernel table for the running cpu, the cpu is checked only on the first call.
+ * @return a reference to the kernel table.
+ */
+const HalfKernels &halfKernels();
+
+/**
+ * converts a float to IEEE half, rounding to the nearest even.
+ * @param value the float.
+ * @return the bits of the half.
+ */
+uint16_t floatToHalf(float value);
+
+/**
+ * converts an IEEE half to float, exactly.
+ * @param bits the bits of the half.
+ * @return the float.
+ */
+float halfToFloat(uint16_t bits);
+
+/**
+ * converts a float to bfloat16, rounding to the nearest even.
+ * @param value the float.
+ * @return the bits of the bfloat16.
+ */
+uint16_t floatToBf16(float value);
+
+/**
+ * converts a bfloat16 to float, exactly.
+ * @param bits the bits of the bfloat16.
+ * @return the float.
+ */
+float bf16ToFloat(uint16_t bits);
+
+#endif //HALFKERNELS_H
@@ -0,0 +1,171 @@
+#include <exception>
+#include "ImageStream.h"
+
+// the images transposed together, a tile of the raw batch and of the matrix stay in L1.
+#define TRANSPOSE_TILE 16
+
+/**
+ * opens the file and starts reading it ahead.
+ * @param path the path of the file.
+ * @param batchSize the number of images in a batch.
+ * @param ringSize the number of batch buffers.
+ * @param imageSize the number of floats in an image.
+ */
+ImageStream :: ImageStream(const std::string &path, int batchSize, int ringSize, int imageSize)
+        : _file(path, std::ios::binary), _imageSize(imageSize), _batchSize(batchSize),
+          _filled(0), _readIndex(0), _writeIndex(0), _holding(false), _ended(false), _stop(false)
+{
+    if (batchSize <= 0 || ringSize < 2 || imageSize <= 0)
+    {
+        throw MatrixSizeError(BAD_STREAM_ERROR);
+    }
+    if (!_file.good())
+    {
+        throw MatrixFileError();
+    }
+    for (int i = 0; i < ringSize; ++i)
+    {
+        _batches.emplace_back(imageSize, batchSize);
+    }
+    _raw.resize((size_t) batchSize * imageSize);
+    _reader = std::thread(&ImageStream::_readLoop, this);
+}
+
+/**
+ * stops the read-ahead thread.
+ */
+ImageStream :: ~ImageStream()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+    _changed.notify_all();
+    _reader.join();
+}
+
+/**
+ * reads the next batch of the file into a buffer of the ring, throws MatrixFileError if the file ends
+ * inside an image.
+ * @param slot the index of the buffer.
+ * @return the number of images read, 0 at the end of the file.
+ */
+int ImageStream :: _readBatch(int slot)
+{
+    const auto imageBytes = (std::streamsize) (_imageSize * sizeof(float));
+    _file.read((char *) _raw.data(), imageBytes * _batchSize);
+    const std::streamsize bytes = _file.gcount();
+    if (bytes % imageBytes != 0)
+    {
+        throw MatrixFileError();
+    }
+    const int count = (int) (bytes / imageBytes);
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (count != _batches[slot].getCols())
+    {
+        // only the last batch is short.
+        _batches[slot] = Matrix(_imageSize, count);
+    }
+    // the raw batch has one image per row, the matrix one image per column.
+    float *dst = _batches[slot].data();
+    const float *src = _raw.data();
+    for (int j0 = 0; j0 < count; j0 += TRANSPOSE_TILE)
+    {
+        const int j1 = (j0 + TRANSPOSE_TILE < count) ? j0 + TRANSPOSE_TILE : count;
+        for (int i0 = 0; i0 < _imageSize; i0 += TRANSPOSE_TILE)
+        {
+            const int i1 = (i0 + TRANSPOSE_TILE < _imageSize) ? i0 + TRANSPOSE_TILE : _imageSize;
+            for (int i = i0; i < i1; ++i)
+            {
+                for (int j = j0; j < j1; ++j)
+                {
+                    dst[i * count + j] = src[j * _imageSize + i];
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * the loop of the read-ahead thread.
+ */
+void ImageStream :: _readLoop()
+{
+    const int ringSize = (int) _batches.size();
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _changed.wait(guard, [this, ringSize]
+            { return _stop || _filled < ringSize; });
+            if (_stop)
+            {
+                return;
+            }
+        }
+        // the slot is free, nobody else touches it until it is published.
+        int count = 0;
+        std::exception_ptr error;
+        try
+        {
+            count = _readBatch(_writeIndex);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _error = error;
+            if (count == 0)
+            {
+                _ended = true;
+            }
+            else
+            {
+                _writeIndex = (_writeIndex + 1) % ringSize;
+                ++_filled;
+            }
+        }
+        _changed.notify_all();
+        if (count == 0)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * hands the previous batch back to the ring and waits for the next one. throws the error of the read-ahead thread
+ * (MatrixFileError for a file that ends inside an image) after the batches read before it.
+ * @return an imageSize x N matrix of the next N images (N is the batch size except for the last batch),
+ *         valid until the next call, or nullptr at the end of the file.
+ */
+const Matrix *ImageStream :: next()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    if (_holding)
+    {
+        _holding = false;
+        _readIndex = (_readIndex + 1) % (int) _batches.size();
+        --_filled;
+        _changed.notify_all();
+    }
+    _changed.wait(guard, [this]
+    { return _filled > 0 || _ended; });
+    if (_filled == 0)
+    {
+        if (_error)
+        {
+            // the batches before the error were handed out, the stream ends with it.
+            std::rethrow_exception(_error);
+        }
+        return nullptr;
+    }
+    _holding = true;
+    return &_batches[_readIndex];
+}
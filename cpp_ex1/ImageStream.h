@@ -0,0 +1,86 @@
+// ImageStream.h
+
+#ifndef IMAGESTREAM_H
+#define IMAGESTREAM_H
+
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Matrix.h"
+#include "MlpNetwork.h"
+
+// the default number of images in a batch of the stream.
+#define IMAGE_STREAM_BATCH 256
+// the default number of batch buffers in the ring, one being classified while the others are read ahead.
+#define IMAGE_STREAM_RING 3
+#define BAD_STREAM_ERROR "Error: the image stream needs a positive batch size and at least 2 buffers"
+
+/**
+ * a stream of batches of images from a binary file of 28x28 float images, one image after the other.
+ * a background thread reads the file ahead in whole batches (one read per batch) into a ring of reusable
+ * buffers and transposes every batch into a 784 x N matrix, one image per column, ready for
+ * MlpNetwork::predictBatch. the consumer only waits when it is faster than the disk.
+ */
+class ImageStream
+{
+private:
+    std::ifstream _file;
+    const int _imageSize;
+    const int _batchSize;
+    std::vector<Matrix> _batches;
+    std::vector<float> _raw;
+    std::mutex _lock;
+    std::condition_variable _changed;
+    int _filled, _readIndex, _writeIndex;
+    bool _holding, _ended, _stop;
+    // the error of the read-ahead thread (a file that ends inside an image), thrown by next() in its place.
+    std::exception_ptr _error;
+    std::thread _reader;
+
+    /**
+     * the loop of the read-ahead thread.
+     */
+    void _readLoop();
+
+    /**
+     * reads the next batch of the file into a buffer of the ring, throws MatrixFileError if the file ends
+     * inside an image.
+     * @param slot the index of the buffer.
+     * @return the number of images read, 0 at the end of the file.
+     */
+    int _readBatch(int slot);
+
+public:
+
+    /**
+     * opens the file and starts reading it ahead.
+     * @param path the path of the file.
+     * @param batchSize the number of images in a batch.
+     * @param ringSize the number of batch buffers.
+     * @param imageSize the number of floats in an image.
+     */
+    explicit ImageStream(const std::string &path, int batchSize = IMAGE_STREAM_BATCH,
+                         int ringSize = IMAGE_STREAM_RING, int imageSize = imgDims.rows * imgDims.cols);
+
+    /**
+     * stops the read-ahead thread.
+     */
+    ~ImageStream();
+
+    ImageStream(const ImageStream &) = delete;
+    ImageStream &operator=(const ImageStream &) = delete;
+
+    /**
+     * hands the previous batch back to the ring and waits for the next one. throws the error of the read-ahead thread
+     * (MatrixFileError for a file that ends inside an image) after the batches read before it.
+     * @return an imageSize x N matrix of the next N images (N is the batch size except for the last batch),
+     *         valid until the next call, or nullptr at the end of the file.
+     */
+    const Matrix *next();
+};
+
+#endif //IMAGESTREAM_H
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstdlib>
+#include "InferenceServer.h"
+
+/**
+ * starts the scheduler of a network.
+ * @param network the network, it has to outlive the server.
+ * @param maxBatch the largest number of images in a batch.
+ * @param maxWaitUs the longest time (in microseconds) the oldest request waits for a batch to fill,
+ *        0 runs the requests as soon as the scheduler is free.
+ */
+InferenceServer :: InferenceServer(const MlpNetwork &network, int maxBatch, int maxWaitUs)
+        : _network(network), _maxBatch(maxBatch), _maxWait(maxWaitUs), _imageSize(network.getLayer(0).getCols()),
+          _stop(false), _batch(_imageSize, std::max(maxBatch, 1)), _batches(0), _requests(0)
+{
+    if (maxBatch <= 0 || maxWaitUs < 0)
+    {
+        throw MatrixSizeError(BAD_SERVER_ERROR);
+    }
+    _scheduler = std::thread(&InferenceServer::_scheduleLoop, this);
+}
+
+/**
+ * the destructor, runs the requests already submitted and joins the scheduler.
+ */
+InferenceServer :: ~InferenceServer()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+    _arrived.notify_one();
+    _scheduler.join();
+}
+
+/**
+ * queues an image for the next batch, from any thread. the image is copied, it may be reused at once.
+ * throws MatrixSizeError if the image is not of the size of the input of the network.
+ * @param img the image (28x28 or already vectorized).
+ * @return the future of the digit of the image, it holds the error of the network if its batch failed.
+ */
+std::future<Digit> InferenceServer :: submit(const Matrix &img)
+{
+    if (img.getRows() * img.getCols() != _imageSize)
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    std::promise<Digit> result;
+    std::future<Digit> future = result.get_future();
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_pendingResults.empty())
+        {
+            _oldest = Clock::now();
+        }
+        const size_t offset = _pendingImages.size();
+        _pendingImages.resize(offset + _imageSize);
+        img.assignTo(_pendingImages.data() + offset, img.getCols(), 1);
+        _pendingResults.push_back(std::move(result));
+        // the scheduler waits for the first request (to start its deadline) and for a full batch.
+        wake = _pendingResults.size() == 1 || (int) _pendingResults.size() == _maxBatch;
+    }
+    if (wake)
+    {
+        _arrived.notify_one();
+    }
+    return future;
+}
+
+/**
+ * the loop of the scheduler thread.
+ */
+void InferenceServer :: _scheduleLoop()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    while (true)
+    {
+        // a full batch, the deadline of the oldest request or the stop ends the wait.
+        while (!_stop && (int) _pendingResults.size() < _maxBatch)
+        {
+            if (_pendingResults.empty())
+            {
+                _arrived.wait(guard);
+            }
+            else if (_arrived.wait_until(guard, _oldest + _maxWait) == std::cv_status::timeout)
+            {
+                break;
+            }
+        }
+        if (_pendingResults.empty())
+        {
+            if (_stop)
+            {
+                return;
+            }
+            continue;
+        }
+        _images.swap(_pendingImages);
+        _results.swap(_pendingResults);
+        guard.unlock();
+        _runBatches();
+        guard.lock();
+    }
+}
+
+/**
+ * runs the taken requests in batches of at most maxBatch images, and completes their futures (with the
+ * error of a batch that throws).
+ */
+void InferenceServer :: _runBatches()
+{
+    const int count = (int) _results.size();
+    float *batch = _batch.data();
+    const int ld = _batch.getLd();
+    for (int first = 0; first < count; first += _maxBatch)
+    {
+        const int n = std::min(_maxBatch, count - first);
+        float *images = _images.data() + (size_t) first * _imageSize;
+        // an error of the network goes to the futures of its batch, the scheduler runs on.
+        try
+        {
+            if (n == 1)
+            {
+                // a lone image takes the single image path, which skips its blank pixels.
+                _results[first].set_value(_network(Matrix(_imageSize, 1, images)));
+            }
+            else
+            {
+                for (int j = 0; j < n; ++j)
+                {
+                    const float *src = images + (size_t) j * _imageSize;
+                    for (int i = 0; i < _imageSize; ++i)
+                    {
+                        batch[(size_t) i * ld + j] = src[i];
+                    }
+                }
+                const std::vector<Digit> digits = _network.predictBatch(_batch.view().colRange(0, n));
+                for (int j = 0; j < n; ++j)
+                {
+                    _results[first + j].set_value(digits[j]);
+                }
+            }
+        }
+        catch (...)
+        {
+            const std::exception_ptr error = std::current_exception();
+            for (int j = 0; j < n; ++j)
+            {
+                _results[first + j].set_exception(error);
+            }
+        }
+        _batches.fetch_add(1, std::memory_order_relaxed);
+        _requests.fetch_add(n, std::memory_order_relaxed);
+    }
+    _images.clear();
+    _results.clear();
+}
+
+/**
+ * a getter for the number of batches run so far.
+ * @return the number of batches.
+ */
+long InferenceServer :: getBatches() const
+{
+    return _batches.load(std::memory_order_relaxed);
+}
+
+/**
+ * a getter for the number of requests run so far.
+ * @return the number of requests.
+ */
+long InferenceServer :: getRequests() const
+{
+    return _requests.load(std::memory_order_relaxed);
+}
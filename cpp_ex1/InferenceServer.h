@@ -0,0 +1,109 @@
+// InferenceServer.h
+
+#ifndef INFERENCESERVER_H
+#define INFERENCESERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Matrix.h"
+#include "MlpNetwork.h"
+
+// the default largest batch of the server, and the default longest time a request waits for a batch to fill.
+// a request per batch without a wait: on the digits (mostly blank pixels) the single image path, which skips
+// the blank pixels, beats the batched product per image, so batching only adds latency (see make loadgen:
+// p50 70us at a batch of 1 against 370us at 64 with a 200us wait). larger batches pay off on dense images.
+#define SERVER_MAX_BATCH 1
+#define SERVER_MAX_WAIT_US 0
+#define BAD_SERVER_ERROR "Error: an inference server needs a positive batch size and a non negative wait"
+
+/**
+ * an in-process serving front end of a network: any number of threads submit single images and get futures
+ * of their digits, and a scheduler thread collects the requests into batches for MlpNetwork::predictBatch.
+ * a batch is run as soon as maxBatch requests are waiting, or when the oldest one has waited maxWaitUs
+ * microseconds, so a request waits at most maxWaitUs (plus the batches before it) under a light load and
+ * the weights are read once per batch under a heavy one. the requests that arrive while a batch runs are
+ * run next, in batches of at most maxBatch.
+ */
+class InferenceServer
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    const MlpNetwork &_network;
+    const int _maxBatch;
+    const std::chrono::microseconds _maxWait;
+    const int _imageSize;
+    std::mutex _lock;
+    std::condition_variable _arrived;
+    // the requests the scheduler has not taken yet: their images one after the other, their promises, and
+    // the arrival of the oldest one. the scheduler swaps them with its own (emptied) buffers, so the
+    // buffers keep their capacity and a request only allocates its promise.
+    std::vector<float> _pendingImages;
+    std::vector<std::promise<Digit>> _pendingResults;
+    Clock::time_point _oldest;
+    bool _stop;
+    // the requests being run by the scheduler, and the batch matrix their images are transposed into.
+    std::vector<float> _images;
+    std::vector<std::promise<Digit>> _results;
+    Matrix _batch;
+    std::atomic<long> _batches, _requests;
+    std::thread _scheduler;
+
+    /**
+     * the loop of the scheduler thread.
+     */
+    void _scheduleLoop();
+
+    /**
+     * runs the taken requests in batches of at most maxBatch images, and completes their futures (with the
+     * error of a batch that throws).
+     */
+    void _runBatches();
+
+public:
+
+    /**
+     * starts the scheduler of a network.
+     * @param network the network, it has to outlive the server.
+     * @param maxBatch the largest number of images in a batch.
+     * @param maxWaitUs the longest time (in microseconds) the oldest request waits for a batch to fill,
+     *        0 runs the requests as soon as the scheduler is free.
+     */
+    explicit InferenceServer(const MlpNetwork &network, int maxBatch = SERVER_MAX_BATCH,
+                             int maxWaitUs = SERVER_MAX_WAIT_US);
+
+    /**
+     * the destructor, runs the requests already submitted and joins the scheduler.
+     */
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer &) = delete;
+    InferenceServer &operator=(const InferenceServer &) = delete;
+
+    /**
+     * queues an image for the next batch, from any thread. the image is copied, it may be reused at once.
+     * throws MatrixSizeError if the image is not of the size of the input of the network.
+     * @param img the image (28x28 or already vectorized).
+     * @return the future of the digit of the image, it holds the error of the network if its batch failed.
+     */
+    std::future<Digit> submit(const Matrix &img);
+
+    /**
+     * a getter for the number of batches run so far.
+     * @return the number of batches.
+     */
+    long getBatches() const;
+
+    /**
+     * a getter for the number of requests run so far.
+     * @return the number of requests.
+     */
+    long getRequests() const;
+};
+
+#endif //INFERENCESERVER_H
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "InferenceServer.h"
+#include "MlpNetwork.h"
+#include "TestData.h"
+
+#define LOADGEN_USAGE_ERROR "Usage: loadgen [--rate r] [--seconds s] [--producers p] [--batch n] [--wait us]"
+#define LOADGEN_DIGIT_ERROR "Error: the server classified an image unlike the network"
+
+// the requests per second of all the producers together, the seconds of a run and the number of producers.
+#define LOADGEN_RATE 20000
+#define LOADGEN_SECONDS 1.0
+#define LOADGEN_PRODUCERS 4
+// the number of distinct images the producers submit, one after the other.
+#define LOADGEN_IMAGES 512
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double, std::micro> Micros;
+
+/**
+ * @struct LoadResult
+ * @brief the outcome of a run of the load generator, the latencies are in microseconds.
+ */
+typedef struct LoadResult
+{
+    double throughput, p50, p95, p99, max, meanBatch;
+    long mismatches;
+} LoadResult;
+
+/**
+ * a request of a producer that has not completed yet.
+ */
+typedef struct InFlight
+{
+    Clock::time_point arrival;
+    int image;
+    std::future<Digit> digit;
+} InFlight;
+
+/**
+ * the q quantile of sorted values.
+ * @param sorted the values, in increasing order.
+ * @param q the quantile, in [0, 1].
+ * @return the quantile, 0 for no values.
+ */
+static double _quantile(const std::vector<double> &sorted, double q)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t) (q * (double) sorted.size()))];
+}
+
+/**
+ * the loop of a producer: an open loop of requests at exponential intervals (like independent clients),
+ * whatever the latency of the server. between two arrivals it waits for its oldest request, the server
+ * completes the requests in order. a latency is counted from the planned arrival, so a late producer does
+ * not hide the time the server kept it waiting.
+ * @param server the server.
+ * @param images the images.
+ * @param expected the digit the network gives every image.
+ * @param rate the requests per second of the producer.
+ * @param end the end of the arrivals.
+ * @param seed the seed of the intervals.
+ * @param latencies the latencies of the requests of the producer.
+ * @param mismatches the number of requests whose digit is not the expected one.
+ */
+static void _produce(InferenceServer &server, const std::vector<Matrix> &images, const std::vector<Digit> &expected,
+                     double rate, Clock::time_point end, unsigned int seed, std::vector<double> &latencies,
+                     long &mismatches)
+{
+    std::mt19937 gen(seed);
+    std::exponential_distribution<double> gap(rate);
+    std::uniform_int_distribution<int> pick(0, (int) images.size() - 1);
+    std::deque<InFlight> inFlight;
+    Clock::time_point next = Clock::now();
+    while (next < end || !inFlight.empty())
+    {
+        if (next < end && Clock::now() >= next)
+        {
+            const int image = pick(gen);
+            inFlight.push_back(InFlight{next, image, server.submit(images[image])});
+            next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(gen)));
+            continue;
+        }
+        if (inFlight.empty())
+        {
+            std::this_thread::sleep_until(next);
+            continue;
+        }
+        InFlight &oldest = inFlight.front();
+        if (next < end && oldest.digit.wait_until(next) != std::future_status::ready)
+        {
+            continue;
+        }
+        const Digit digit = oldest.digit.get();
+        latencies.push_back(Micros(Clock::now() - oldest.arrival).count());
+        mismatches += digit.value != expected[oldest.image].value;
+        inFlight.pop_front();
+    }
+}
+
+/**
+ * runs the producers against a server with a batch size and a wait.
+ * @param network the network.
+ * @param images the images.
+ * @param expected the digit the network gives every image.
+ * @param maxBatch the largest batch of the server.
+ * @param maxWaitUs the longest wait of the server for a batch to fill.
+ * @param rate the requests per second of all the producers.
+ * @param seconds the time the producers submit requests.
+ * @param producers the number of producer threads.
+ * @return the throughput and the latencies of the run.
+ */
+static LoadResult _runLoad(const MlpNetwork &network, const std::vector<Matrix> &images,
+                           const std::vector<Digit> &expected, int maxBatch, int maxWaitUs, double rate,
+                           double seconds, int producers)
+{
+    InferenceServer server(network, maxBatch, maxWaitUs);
+    std::vector<std::vector<double>> latencies(producers);
+    std::vector<long> mismatches(producers, 0);
+    std::vector<std::thread> threads;
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(seconds));
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(_produce, std::ref(server), std::cref(images), std::cref(expected), rate / producers,
+                             end, p + 1, std::ref(latencies[p]), std::ref(mismatches[p]));
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> all;
+    LoadResult result = LoadResult();
+    for (int p = 0; p < producers; ++p)
+    {
+        all.insert(all.end(), latencies[p].begin(), latencies[p].end());
+        result.mismatches += mismatches[p];
+    }
+    std::sort(all.begin(), all.end());
+    result.throughput = (double) all.size() / elapsed;
+    result.p50 = _quantile(all, 0.5);
+    result.p95 = _quantile(all, 0.95);
+    result.p99 = _quantile(all, 0.99);
+    result.max = all.empty() ? 0 : all.back();
+    result.meanBatch = (double) server.getRequests() / std::max(server.getBatches(), 1L);
+    return result;
+}
+
+/**
+ * runs the load generator on random weights and images, against a sweep of batch sizes and waits (or one
+ * setting), and prints the throughput and the latency percentiles of every setting.
+ * @param argc the number of arguments.
+ * @param argv the arguments: --rate r for the requests per second, --seconds s for the time of a setting,
+ *        --producers p for the producer threads, --batch n and --wait us for a single setting.
+ * @return 0, or 1 if a request got another digit than the network gives its image.
+ */
+int main(int argc, char *argv[])
+{
+    double rate = LOADGEN_RATE, seconds = LOADGEN_SECONDS;
+    int producers = LOADGEN_PRODUCERS, batch = 0, wait = -1;
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--rate") == 0 && hasValue && std::atof(argv[i + 1]) > 0)
+        {
+            rate = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--seconds") == 0 && hasValue && std::atof(argv[i + 1]) > 0)
+        {
+            seconds = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--producers") == 0 && hasValue && std::atoi(argv[i + 1]) > 0)
+        {
+            producers = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--batch") == 0 && hasValue && std::atoi(argv[i + 1]) > 0)
+        {
+            batch = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--wait") == 0 && hasValue && std::atoi(argv[i + 1]) >= 0)
+        {
+            wait = std::atoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << LOADGEN_USAGE_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::mt19937 gen(1);
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+        biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+        fillNormal(weights[i], gen, 0.1f);
+        fillNormal(biases[i], gen, 0.1f);
+    }
+    const MlpNetwork network(weights, biases);
+    std::vector<Matrix> images;
+    std::vector<Digit> expected;
+    for (int i = 0; i < LOADGEN_IMAGES; ++i)
+    {
+        images.emplace_back(imgDims.rows, imgDims.cols);
+        fillImages(images.back(), gen);
+        expected.push_back(network(images.back()));
+    }
+
+    // the sweep, or the one setting of the arguments. a batch of 1 without a wait is a request per call.
+    std::vector<int> batches = {1, 8, 32, 64}, waits = {0, 100, 500};
+    if (batch > 0 || wait >= 0)
+    {
+        batches = {batch > 0 ? batch : SERVER_MAX_BATCH};
+        waits = {wait >= 0 ? wait : SERVER_MAX_WAIT_US};
+    }
+    std::printf("offered %.0f requests/s from %d producers, %.1f s per setting\n\n", rate, producers, seconds);
+    std::printf("%6s %8s %12s %10s %10s %10s %10s %10s\n", "batch", "wait us", "requests/s", "p50 us", "p95 us",
+                "p99 us", "max us", "mean batch");
+    long mismatches = 0;
+    for (int maxBatch : batches)
+    {
+        for (int maxWait : waits)
+        {
+            const LoadResult r = _runLoad(network, images, expected, maxBatch, maxWait, rate, seconds, producers);
+            std::printf("%6d %8d %12.0f %10.1f %10.1f %10.1f %10.1f %10.2f\n", maxBatch, maxWait, r.throughput,
+                        r.p50, r.p95, r.p99, r.max, r.meanBatch);
+            mismatches += r.mismatches;
+        }
+    }
+    if (mismatches != 0)
+    {
+        std::cerr << LOADGEN_DIGIT_ERROR << std::endl;
+        return 1;
+    }
+    return 0;
+}
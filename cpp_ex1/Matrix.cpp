@@ -1,29 +1,116 @@
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <new>
+#include <sys/mman.h>
 #include "Matrix.h"
+#include "Profile.h"
+#include "SimdKernels.h"
 
 /**
- * a method that initalizing the values of the matrix to 0.
+ * maps an anonymous buffer on a huge page boundary and asks the kernel to back it with transparent huge pages.
+ * @param bytes the size of the buffer, a multiple of MATRIX_HUGE_PAGE.
+ * @return the buffer, or nullptr if it cant be mapped.
  */
-void Matrix :: _initValues()
+static float *_mapHugePages(size_t bytes)
 {
-    for (int i = 0; i < _matSize; ++i)
+    // a huge page only backs an aligned range, so a huge page more is mapped and the ends are unmapped.
+    const size_t mappedBytes = bytes + MATRIX_HUGE_PAGE;
+    void *mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    const auto first = (uintptr_t) mapped;
+    const uintptr_t aligned = (first + MATRIX_HUGE_PAGE - 1) & ~(uintptr_t) (MATRIX_HUGE_PAGE - 1);
+    if (aligned != first)
+    {
+        munmap(mapped, aligned - first);
+    }
+    if (first + mappedBytes != aligned + bytes)
     {
-        _myMat[i] = 0;
+        munmap((void *) (aligned + bytes), first + mappedBytes - (aligned + bytes));
     }
+#ifdef MADV_HUGEPAGE
+    // only a hint, without transparent huge pages the buffer stays in normal pages.
+    madvise((void *) aligned, bytes, MADV_HUGEPAGE);
+#endif
+    return (float *) aligned;
 }
 
 /**
- * a method that initalizing the values of the matrix to 0.
- * @param m a new matrix to copy to the current matrix.
+ * the distance between two rows of a matrix in a layout.
+ * @param cols the num of cols in the matrix
+ * @param layout the layout
+ * @return the number of floats from a row to the next.
  */
-void Matrix :: _cpyMatVals(const Matrix &m)
+int Matrix :: _rowStride(const int cols, const MatrixLayout layout)
+{
+    const int unit = layout.rowAlignment / (int) sizeof(float);
+    if (unit < 1 || (unit & (unit - 1)) != 0)
+    {
+        throw MatrixSizeError(BAD_MAT_LAYOUT_ERROR);
+    }
+    // a single col is a vector, its rows are never padded.
+    if (cols <= 1 || unit == 1)
+    {
+        return cols;
+    }
+    int ld = (cols + unit - 1) / unit * unit;
+    const int bytes = ld * (int) sizeof(float);
+    if (bytes >= MATRIX_SKEW_BYTES && (bytes & (bytes - 1)) == 0 && layout.rowAlignment < MATRIX_PAGE_SIZE)
+    {
+        ld += unit;
+    }
+    return ld;
+}
+
+/**
+ * allocates an aligned buffer for the dimensions and the layout of the matrix, and sets its stride.
+ */
+void Matrix :: _allocMatVals()
 {
-    _myMat = new float [_matSize];
-    for (int i = 0; i < _matSize; ++i)
+    _ld = _rowStride(matDims.cols, _layout);
+    const size_t alignment = std::max((size_t) MATRIX_ALIGNMENT, (size_t) _layout.rowAlignment);
+    const size_t bytes = std::max(_extent(), (size_t) 1) * sizeof(float);
+    _allocBytes = (bytes + alignment - 1) / alignment * alignment;
+    _mapped = false;
+    _ownsData = true;
+    _myMat = nullptr;
+    if (_layout.hugePages && _allocBytes >= MATRIX_HUGE_PAGE)
+    {
+        _allocBytes = (_allocBytes + MATRIX_HUGE_PAGE - 1) / MATRIX_HUGE_PAGE * MATRIX_HUGE_PAGE;
+        _myMat = _mapHugePages(_allocBytes);
+        _mapped = _myMat != nullptr;
+    }
+    if (_myMat == nullptr)
+    {
+        _myMat = (float *) aligned_alloc(alignment, _allocBytes);
+    }
+    if (_myMat == nullptr)
     {
-        this->_myMat[i] = m._myMat[i];
+        throw std::bad_alloc();
     }
+    PROFILE_ALLOCATION(_allocBytes);
+}
+
+/**
+ * a method that initalizing the values of the matrix (and of the padding of its rows) to 0.
+ */
+void Matrix :: _initValues()
+{
+    std::memset(_myMat, 0, _extent() * sizeof(float));
+}
+
+/**
+ * a method that allocates a buffer in the layout of the matrix and copies the values of m into it.
+ * @param m a new matrix to copy to the current matrix.
+ */
+void Matrix :: _cpyMatVals(const Matrix &m)
+{
+    _allocMatVals();
+    m.assignTo(_myMat, _ld, 1);
 }
 
 /**
@@ -31,7 +118,26 @@ void Matrix :: _cpyMatVals(const Matrix &m)
  */
 void Matrix :: _delMatVals() const
 {
-    delete[] (this->_myMat);
+    if (!_ownsData)
+    {
+        return;
+    }
+    if (_mapped)
+    {
+        munmap(_myMat, _allocBytes);
+    }
+    else
+    {
+        free(_myMat);
+    }
+}
+
+/**
+ * throws the error of an index out of the bounds of a matrix, out of line so the checks stay small.
+ */
+void throwMatrixIndexError()
+{
+    throw MatrixIndexError();
 }
 
 /**
@@ -46,60 +152,105 @@ Matrix :: Matrix() : Matrix(BASE_MAT_SIZE, BASE_MAT_SIZE)
  * @param rows the num of rows in the matrix
  * @param cols the num of cols in the matrix
  */
-Matrix :: Matrix(const int rows, const int cols) : matDims{.rows = rows, .cols = cols}, _matSize(rows*cols)
+Matrix :: Matrix(const int rows, const int cols) : Matrix(rows, cols, packedLayout)
+{
+}
+
+/**
+ * Constructor for Matrix class, with the rows laid out in a given layout (like paddedLayout, or
+ * {MATRIX_PAGE_SIZE, true} for rows on pages of their own). operator[] and operator() index the matrix
+ * as if it were packed, whatever its layout.
+ * @param rows the num of rows in the matrix
+ * @param cols the num of cols in the matrix
+ * @param layout the layout of the rows, throws MatrixSizeError if its row alignment is not a power of two.
+ */
+Matrix :: Matrix(const int rows, const int cols, const MatrixLayout layout) : matDims{.rows = rows, .cols = cols},
+                                                                             _matSize(rows*cols), _layout(layout)
 {
     if (rows <= 0 || cols <= 0)
     {
-        std::cerr << NEG_MAT_SIZE_ERROR;
-        exit(EXIT_FAILURE);
+        throw MatrixSizeError(NEG_MAT_SIZE_ERROR);
     }
-    _myMat = new float [_matSize];
+    _allocMatVals();
     _initValues();
 }
 
 /**
- * a copy constructor of the class
+ * a constructor wrapping an existing row-major buffer without copying it (like the pages of a mapped
+ * model file). the matrix does not own the buffer, which has to outlive it. copies of it own their buffers,
+ * and an assignment to it never writes the buffer, the matrix gets a buffer of its own.
+ * @param rows the num of rows in the matrix
+ * @param cols the num of cols in the matrix
+ * @param buffer rows * cols floats.
+ */
+Matrix :: Matrix(const int rows, const int cols, float *buffer) : matDims{.rows = rows, .cols = cols},
+                                                                 _matSize(rows*cols), _ld(cols), _myMat(buffer),
+                                                                 _ownsData(false)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw MatrixSizeError(NEG_MAT_SIZE_ERROR);
+    }
+}
+
+/**
+ * a copy constructor of the class, the copy has the layout of m.
  * @param m a matrix to copy.
  */
-Matrix :: Matrix(const Matrix &m) : matDims{.rows = m.getRows(), .cols = m.getCols()}, _matSize(m.getRows()*m.getCols())
+Matrix :: Matrix(const Matrix &m) : matDims{.rows = m.getRows(), .cols = m.getCols()},
+                                    _matSize(m.getRows()*m.getCols()), _layout(m._layout)
 {
     _cpyMatVals(m);
 }
 
 /**
- * the class destructor.
+ * a move constructor of the class, takes the buffer of m and leaves m as an empty 0x0 matrix.
+ * @param m a matrix to move.
  */
-Matrix :: ~Matrix()
+Matrix :: Matrix(Matrix &&m) noexcept : matDims(m.matDims), _matSize(m._matSize), _ld(m._ld), _layout(m._layout),
+                                        _myMat(m._myMat), _allocBytes(m._allocBytes), _mapped(m._mapped),
+                                        _ownsData(m._ownsData)
 {
-    _delMatVals();
+    m.matDims = {0, 0};
+    m._matSize = 0;
+    m._ld = 0;
+    m._myMat = nullptr;
+    m._allocBytes = 0;
+    m._mapped = false;
+    m._ownsData = true;
 }
 
 /**
- * a getter for the number of rows in the matrix
- * @return the number of rows.
+ * the class destructor.
  */
-int Matrix :: getRows() const
+Matrix :: ~Matrix()
 {
-    return matDims.rows;
+    _delMatVals();
 }
 
 /**
- * a getter for the number of cols in the matrix
- * @return the number of cols.
+ * a getter for whether the matrix owns its buffer.
+ * @return false if the matrix borrows a buffer it was constructed with, true otherwise.
  */
-int Matrix :: getCols() const
+bool Matrix :: ownsData() const
 {
-    return matDims.cols;
+    return _ownsData;
 }
 
 /**
- * A method that creates a vector from the current matrix
+ * A method that creates a vector from the current matrix, a padded matrix is packed in place.
  * @return reference for the vectorize matrix.
  */
 Matrix& Matrix :: vectorize()
 {
+    // the rows of a padded matrix are moved up against each other, a col is never padded.
+    for (int i = 1; !isPacked() && i < matDims.rows; ++i)
+    {
+        std::memmove(_myMat + (size_t) i * matDims.cols, _myMat + (size_t) i * _ld, matDims.cols * sizeof(float));
+    }
     matDims.rows = _matSize;
     matDims.cols = BASE_MAT_SIZE;
+    _ld = BASE_MAT_SIZE;
     return *this;
 }
 
@@ -119,7 +270,8 @@ void Matrix :: plainPrint() const
 }
 
 /**
- * overriding the operator = for the matrix class, comparing two matrices.
+ * overriding the operator = for the matrix class, comparing two matrices. the matrix keeps its layout, and its
+ * buffer unless it borrows it.
  * @param m1 a matrix to init = on.
  * @return a reference to the new matrix.
  */
@@ -129,8 +281,18 @@ Matrix& Matrix :: operator=(const Matrix &m1)
     {
         return *this;
     }
+    const bool sameDims = matDims.rows == m1.getRows() && matDims.cols == m1.getCols();
+    const bool reshaped = !sameDims && _matSize == m1._matSize && isPacked()
+                          && _rowStride(m1.getCols(), _layout) == m1.getCols();
     matDims.rows = m1.getRows();
     matDims.cols = m1.getCols();
+    // a borrowed buffer (maybe read only, like a mapped model file) is never written, the copy gets its own.
+    if (_ownsData && (sameDims || reshaped))
+    {
+        _ld = sameDims ? _ld : matDims.cols;
+        m1.assignTo(_myMat, _ld, 1);
+        return *this;
+    }
     this->_matSize = m1._matSize;
     _delMatVals();
     _cpyMatVals(m1);
@@ -138,20 +300,33 @@ Matrix& Matrix :: operator=(const Matrix &m1)
 }
 
 /**
- * a constant method for the operator + on a matrices, add all the coordinates 1 by 1.
- * @param m1 a matrix to add to the current
- * @return the sum of the adding.
+ * a move assignment for the matrix class, takes the buffer of m1 and leaves m1 as an empty 0x0 matrix.
+ * @param m1 a matrix to move.
+ * @return a reference to the current matrix.
  */
-Matrix Matrix :: operator+(const Matrix &m1) const
+Matrix& Matrix :: operator=(Matrix &&m1) noexcept
 {
-    if (matDims.rows != m1.getRows() || matDims.cols != m1.getCols())
+    if (this == &m1)
     {
-        std::cerr << MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR << std::endl;
-        exit(EXIT_FAILURE);
+        return *this;
     }
-    Matrix newMat = Matrix(m1);
-    newMat += *this;
-    return newMat;
+    _delMatVals();
+    matDims = m1.matDims;
+    _matSize = m1._matSize;
+    _ld = m1._ld;
+    _layout = m1._layout;
+    _myMat = m1._myMat;
+    _allocBytes = m1._allocBytes;
+    _mapped = m1._mapped;
+    _ownsData = m1._ownsData;
+    m1.matDims = {0, 0};
+    m1._matSize = 0;
+    m1._ld = 0;
+    m1._myMat = nullptr;
+    m1._allocBytes = 0;
+    m1._mapped = false;
+    m1._ownsData = true;
+    return *this;
 }
 
 /**
@@ -163,178 +338,119 @@ Matrix& Matrix :: operator+=(const Matrix &m1)
 {
     if (matDims.rows != m1.getRows() || matDims.cols != m1.getCols())
     {
-        std::cerr << MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    for (int i = 0; i < this->_matSize; ++i)
-    {
-        (*this)[i] += m1[i];
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
     }
+    m1.addTo(_myMat, _ld, 1);
     return *this;
 }
 
 /**
- * override method the the () operator, returning the (i,j) position of the function, where
- * i is the row, and j is the colomn.
- * @param row the row index
- * @param col the col index
- * @return a reference to the (i,j) float of the matrix.
+ * checks whether writing the matrix into a destination would overwrite a float of it before it is read.
+ * @param first the first float of the destination
+ * @param last the float past the last float of the destination
+ * @param ldd the distance between two rows of the destination, 0 when any overlap counts.
+ * @return true if the matrix overlaps the destination and is not at the same place in it.
  */
-float& Matrix :: operator()(int row, int col)
+bool Matrix :: aliases(const float *first, const float *last, int ldd) const
 {
-    if (row < 0 || col < 0 || row >= matDims.rows || col >= matDims.cols)
-    {
-        std::cerr << BAD_MAT_INDEX_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    int index = (row* matDims.cols) + col;
-    return (*this)[index];
+    const bool overlaps = _myMat < last && first < _myMat + _extent();
+    return overlaps && !(first == _myMat && ldd == _ld);
 }
 
 /**
- * a const method, overrides the () operator, returning the (i,j) position of the function, where
- * i is the row, and j is the colomn.
- * @param row the row index
- * @param col the col index
- * @return the (i,j) float of the matrix.
+ * a view of the whole matrix, for slicing it without copying.
+ * @return a view of the floats of the matrix.
  */
-float Matrix :: operator()(int row, int col) const
+MatrixView Matrix :: view()
 {
-    if (row < 0 || col < 0 || row >= matDims.rows || col >= matDims.cols)
-    {
-        std::cerr << BAD_MAT_INDEX_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    int index = (row* matDims.cols) + col;
-    return (*this)[index];
-}
-
-/**
- * a const method, overrides the [] operator, returning the position in the matrix,
- * while the position = row*cols + col.
- * @param position the index for the float in the matrix
- * @return the [i] float of the matrix.
- */
-float Matrix :: operator[](int position) const
-{
-    if (position < 0 || position >= this->_matSize)
-    {
-        std::cerr << BAD_MAT_INDEX_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    return this->_myMat[position];
+    return MatrixView(_myMat, matDims.rows, matDims.cols, _ld);
 }
 
 /**
- * a non-const method, overrides the [] operator, returning the position in the matrix,
- * while the position = row*cols + col.
- * @param position the index for the float in the matrix
- * @return a reference to the [i] float of the matrix.
+ * a read only view of the whole matrix, for slicing it without copying.
+ * @return a view of the floats of the matrix.
  */
-float& Matrix :: operator[](int position)
+ConstMatrixView Matrix :: view() const
 {
-    if (position < 0 || position >= this->_matSize)
-    {
-        std::cerr << BAD_MAT_INDEX_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    return this->_myMat[position];
+    return ConstMatrixView(_myMat, matDims.rows, matDims.cols, _ld);
 }
 
 /**
- * a const override method for the operator *, representing a matrix multiplication.
- * @param b a matrix to multiply from right to this.
- * @return a matrix , the multiplication of this*b.
+ * writes f * this into the given buffer.
+ * @param dst the first float of the destination
+ * @param ldd the distance between two rows of the destination
+ * @param f a scalar for the matrix
  */
-Matrix Matrix :: operator*(const Matrix &b) const
+void Matrix :: assignTo(float *dst, int ldd, float f) const
 {
-    if (matDims.cols != b.getRows())
-    {
-        std::cerr << MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    Matrix newMat = Matrix(matDims.rows, b.getCols());
-    for(int i = 0; i < matDims.rows; i++)
+    if (ldd == matDims.cols && isPacked())
     {
-        for(int j = 0; j<b.getCols(); j++)
+        if (f != 1)
         {
-            float sum = 0;
-            for(int k = 0; k < matDims.cols; k++)
-            {
-                sum += this->_myMat[i * matDims.cols + k] * b._myMat[k * b.getCols() + j];
-            }
-            newMat._myMat[i * b.getCols() + j] = sum;
+            simdKernels().scale(dst, _myMat, f, _matSize);
+        }
+        else if (dst != _myMat)
+        {
+            std::memcpy(dst, _myMat, _matSize * sizeof(float));
         }
+        return;
     }
-    return newMat;
-}
-
-/**
- * a const override method for the operator *, representing a matrix and float from right.
- * @param c a float to multiply from right to this.
- * @return a matrix , the multiplication of this*c.
- */
-Matrix Matrix :: operator*(float c) const
-{
-    Matrix cMat = Matrix(*this);
     for (int i = 0; i < matDims.rows; ++i)
     {
-        for (int j = 0; j < matDims.cols; ++j)
+        float *dstRow = dst + (size_t) i * ldd;
+        const float *row = _myMat + (size_t) i * _ld;
+        if (f != 1)
+        {
+            simdKernels().scale(dstRow, row, f, matDims.cols);
+        }
+        else if (dstRow != row)
         {
-            cMat(i, j) *= c;
+            std::memcpy(dstRow, row, matDims.cols * sizeof(float));
         }
     }
-    return cMat;
 }
 
 /**
- * a non-const override method for the operator *, representing a matrix and float from right.
- * @param c a float to multiply from right to this.
- * @return a matrix ,the multiplication of this*c.
+ * adds f * this to the given buffer.
+ * @param dst the first float of the destination
+ * @param ldd the distance between two rows of the destination
+ * @param f a scalar for the matrix
  */
-Matrix Matrix :: operator*(float c)
+void Matrix :: addTo(float *dst, int ldd, float f) const
 {
-    Matrix cMat = Matrix(*this);
+    if (ldd == matDims.cols && isPacked())
+    {
+        simdKernels().axpy(dst, f, _myMat, _matSize);
+        return;
+    }
     for (int i = 0; i < matDims.rows; ++i)
     {
-        for (int j = 0; j < matDims.cols; ++j)
-        {
-            cMat(i, j) *= c;
-        }
+        simdKernels().axpy(dst + (size_t) i * ldd, f, _myMat + (size_t) i * _ld, matDims.cols);
     }
-    return cMat;
-}
-
-/**
- * a const override friend function for the operator *, representing a matrix and float from left.
- * @param c a float to multiply from left to a.
- * @param a a matrix to multiply by c.
- * @return a matrix , the multiplication of this*c.
- */
-Matrix operator *(float c, Matrix a)
-{
-    return a * c;
 }
 
 /**
  * a friend method overriding the >> operator, getting the floats to get in the matrix from the is input.
- * if the input is too short, returns an error.
+ * if the input is too short, throws MatrixFileError.
  * @param is an istream to read from.
  * @param a a reference to matrix, to insert the object from "is" to.
  */
 void operator>>(std::istream & is, Matrix &a)
 {
-    if (is.good())
+    if (!is.good())
     {
-        for (int i = 0; i < a.getRows() * a.getCols(); i++)
-        {
-            is.read((char *) &a[i], sizeof(float));
-        }
+        throw MatrixFileError();
     }
-    else
+    // the whole matrix in one read straight into its buffer, or a read per row of a padded matrix.
+    const int reads = a.isPacked() ? 1 : a.matDims.rows;
+    auto bytes = (std::streamsize) ((size_t) a._matSize / reads * sizeof(float));
+    for (int i = 0; i < reads; ++i)
     {
-        std::cerr << BAD_FILE_ERROR << std::endl;
-        exit(EXIT_FAILURE);
+        is.read((char *) (a._myMat + (size_t) i * a._ld), bytes);
+        if (is.gcount() != bytes)
+        {
+            throw MatrixFileError();
+        }
     }
 }
 
@@ -8,9 +8,27 @@
 #define MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR "Error: cant add those matrices"
 #define BAD_MAT_INDEX_ERROR "Error: bad mat index"
 #define MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR "Error: cant multiply those matrices"
+#define BAD_MAT_LAYOUT_ERROR "Error: the row alignment of a matrix has to be a power of two floats"
 #define BASE_MAT_SIZE 1
+// the alignment (in bytes) of the first float of every matrix buffer, a cache line and an AVX-512 register.
+#define MATRIX_ALIGNMENT 64
+// the size of a page, and of a transparent huge page, a huge-page layout maps buffers of at least this size.
+#define MATRIX_PAGE_SIZE 4096
+#define MATRIX_HUGE_PAGE (2 * 1024 * 1024)
+// a padded row of at least this many bytes whose size is a power of two gets one more alignment unit, so the
+// same col of consecutive rows does not fall on the same cache sets.
+#define MATRIX_SKEW_BYTES 256
 
 #include <iostream>
+#include <cstdlib>
+#include <stdexcept>
+
+// the indices of Matrix::operator[] and operator() are checked, unless MATRIX_UNCHECKED is defined: then
+// they are plain pointer arithmetic. a release build (NDEBUG, make RELEASE=1) defines it, unless
+// MATRIX_CHECKED keeps the checks.
+#if defined(NDEBUG) && !defined(MATRIX_CHECKED) && !defined(MATRIX_UNCHECKED)
+#define MATRIX_UNCHECKED
+#endif
 
 /**
  * @struct MatrixDims
@@ -22,16 +40,183 @@ typedef struct MatrixDims
 
 } MatrixDims;
 
+/**
+ * @struct MatrixLayout
+ * @brief how a matrix lays its rows out in its buffer
+ */
+typedef struct MatrixLayout
+{
+    // every row starts at a multiple of rowAlignment bytes, a power of two (sizeof(float) packs the rows).
+    int rowAlignment;
+    // whether a buffer of at least MATRIX_HUGE_PAGE bytes is backed by transparent huge pages.
+    bool hugePages;
+
+} MatrixLayout;
+
+// the rows one after the other, the layout of a matrix unless it is given another one.
+const MatrixLayout packedLayout = {sizeof(float), false};
+// every row starts on a cache line.
+const MatrixLayout paddedLayout = {MATRIX_ALIGNMENT, false};
+// the layout of the big weight matrices: rows on cache lines, in huge pages when the matrix is large enough.
+const MatrixLayout weightsLayout = {MATRIX_ALIGNMENT, true};
+
+/**
+ * the error of an index out of the bounds of a matrix.
+ */
+class MatrixIndexError : public std::out_of_range
+{
+public:
+
+    /**
+     * a constructor of the error.
+     */
+    MatrixIndexError() : std::out_of_range(BAD_MAT_INDEX_ERROR)
+    {
+    }
+};
+
+/**
+ * the error of matrix sizes that do not fit an operation (a negative size, or operands that cant be
+ * added or multiplied).
+ */
+class MatrixSizeError : public std::invalid_argument
+{
+public:
+
+    /**
+     * a constructor of the error.
+     * @param message the error message, one of the matrix error strings.
+     */
+    explicit MatrixSizeError(const char *message) : std::invalid_argument(message)
+    {
+    }
+};
+
+/**
+ * the error of a stream too short (or broken) to read a matrix from.
+ */
+class MatrixFileError : public std::runtime_error
+{
+public:
+
+    /**
+     * a constructor of the error.
+     */
+    MatrixFileError() : std::runtime_error(BAD_FILE_ERROR)
+    {
+    }
+
+    /**
+     * a constructor of the error with a message of its own.
+     * @param message the error message, one of the file error strings.
+     */
+    explicit MatrixFileError(const char *message) : std::runtime_error(message)
+    {
+    }
+};
+
+template<class T>
+class BasicMatrixView;
+// a view of the floats of a matrix it can write, and one it can only read (MatrixView.h).
+typedef BasicMatrixView<float> MatrixView;
+typedef BasicMatrixView<const float> ConstMatrixView;
+
+/**
+ * throws the error of an index out of the bounds of a matrix, out of line so the checks stay small.
+ */
+[[noreturn]] void throwMatrixIndexError();
+
+/**
+ * checks that an index of a matrix (or a view) is in [0, size), nothing when MATRIX_UNCHECKED is defined.
+ * @param index the index.
+ * @param size the number of indices.
+ */
+inline void checkMatrixIndex(int index, int size)
+{
+#ifndef MATRIX_UNCHECKED
+    // a single unsigned compare rejects the negative indices too.
+    if ((unsigned int) index >= (unsigned int) size)
+    {
+        throwMatrixIndexError();
+    }
+#else
+    (void) index;
+    (void) size;
+#endif
+}
+
+/**
+ * the base of every matrix expression (a Matrix, or a lazy sum/scale/product of expressions).
+ * an expression is only evaluated when it is assigned into a Matrix, in a single pass.
+ * @tparam E the concrete expression type.
+ */
+template<class E>
+class MatExpr
+{
+public:
+
+    /**
+     * a getter for the concrete expression.
+     * @return a reference to the concrete expression.
+     */
+    const E &self() const
+    {
+        return static_cast<const E &>(*this);
+    }
+};
+
 /**
  * a class represnts a matrix.
  */
-class Matrix
+class Matrix : public MatExpr<Matrix>
 {
 private:
 
     MatrixDims matDims{};
     int _matSize;
-    float *_myMat;
+    // the distance (in floats) between two rows of the buffer, cols unless the layout pads the rows.
+    int _ld = 0;
+    MatrixLayout _layout = packedLayout;
+    float *_myMat = nullptr;
+    // the bytes of an owned buffer, and whether they are mapped (huge pages) rather than allocated.
+    size_t _allocBytes = 0;
+    bool _mapped = false;
+    bool _ownsData = true;
+
+    /**
+     * the distance between two rows of a matrix in a layout.
+     * @param cols the num of cols in the matrix
+     * @param layout the layout
+     * @return the number of floats from a row to the next.
+     */
+    static int _rowStride(int cols, MatrixLayout layout);
+
+    /**
+     * allocates an aligned buffer for the dimensions and the layout of the matrix, and sets its stride.
+     */
+    void _allocMatVals();
+
+    /**
+     * @return the number of floats from the first float of the matrix to the float past its last one.
+     */
+    size_t _extent() const
+    {
+        return (matDims.rows == 0) ? 0 : (size_t) (matDims.rows - 1) * _ld + matDims.cols;
+    }
+
+    /**
+     * the place in the buffer of a float of the logical (row-major, packed) order of operator[].
+     * @param position the index for the float in the matrix
+     * @return the index of the float in the buffer.
+     */
+    size_t _offset(int position) const
+    {
+        if (_ld == matDims.cols)
+        {
+            return position;
+        }
+        return (size_t) (position / matDims.cols) * _ld + position % matDims.cols;
+    }
 
     /**
      * a method that initalizing the values of the matrix to 0.
@@ -39,7 +224,7 @@ private:
     void _initValues();
 
     /**
-     * a method that initalizing the values of the matrix to 0.
+     * a method that allocates a buffer in the layout of the matrix and copies the values of m into it.
      * @param m a new matrix to copy to the current matrix.
      */
     void _cpyMatVals(const Matrix &m);
@@ -51,6 +236,11 @@ private:
 
 public:
 
+    /**
+     * a Matrix is read one coordinate at a time by an expression that contains it.
+     */
+    static constexpr bool isElementwise = true;
+
     /**
      * A default constructor for class Matrix.
      */
@@ -63,31 +253,122 @@ public:
      */
     Matrix(int rows, int cols);
 
+    /**
+     * Constructor for Matrix class, with the rows laid out in a given layout (like paddedLayout, or
+     * {MATRIX_PAGE_SIZE, true} for rows on pages of their own). operator[] and operator() index the matrix
+     * as if it were packed, whatever its layout.
+     * @param rows the num of rows in the matrix
+     * @param cols the num of cols in the matrix
+     * @param layout the layout of the rows, throws MatrixSizeError if its row alignment is not a power of two.
+     */
+    Matrix(int rows, int cols, MatrixLayout layout);
+
+    /**
+     * a constructor wrapping an existing row-major buffer without copying it (like the pages of a mapped
+     * model file). the matrix does not own the buffer, which has to outlive it. copies of it own their buffers,
+     * and an assignment to it never writes the buffer, the matrix gets a buffer of its own.
+     * @param rows the num of rows in the matrix
+     * @param cols the num of cols in the matrix
+     * @param buffer rows * cols floats.
+     */
+    Matrix(int rows, int cols, float *buffer);
+
     /**
      * a copy constructor of the class
      * @param m a matrix to copy.
      */
     Matrix(const Matrix &m);
 
+    /**
+     * a move constructor of the class, takes the buffer of m and leaves m as an empty 0x0 matrix.
+     * @param m a matrix to move.
+     */
+    Matrix(Matrix &&m) noexcept;
+
+    /**
+     * a constructor evaluating a matrix expression (like W*x + b) directly into the new matrix, also copies a
+     * matrix into another layout (like Matrix(weights, paddedLayout)).
+     * @param expr the expression to evaluate.
+     * @param layout the layout of the new matrix.
+     */
+    template<class E>
+    Matrix(const MatExpr<E> &expr, MatrixLayout layout = packedLayout)
+            : matDims{.rows = expr.self().getRows(), .cols = expr.self().getCols()},
+              _matSize(matDims.rows * matDims.cols), _layout(layout)
+    {
+        _allocMatVals();
+        expr.self().assignTo(_myMat, _ld, 1);
+    }
+
     /**
      * the class destructor.
      */
     ~Matrix();
 
     /**
-     * a getter for the number of rows in the matrix
+     * a getter for the number of rows in the matrix, inline so loops bounded by it can be vectorized.
      * @return the number of rows.
      */
-    int getRows() const;
+    int getRows() const
+    {
+        return matDims.rows;
+    }
 
     /**
-     * a getter for the number of cols in the matrix
+     * a getter for the number of cols in the matrix, inline so loops bounded by it can be vectorized.
      * @return the number of cols.
      */
-    int getCols() const;
+    int getCols() const
+    {
+        return matDims.cols;
+    }
+
+    /**
+     * a getter for the distance between two rows of the buffer, cols unless the layout pads the rows.
+     * @return the number of floats from a row to the next.
+     */
+    int getLd() const
+    {
+        return _ld;
+    }
+
+    /**
+     * a getter for whether the rows of the buffer are one after the other, as data() users read them by default.
+     * @return true if getLd() == getCols().
+     */
+    bool isPacked() const
+    {
+        return _ld == matDims.cols;
+    }
 
     /**
-     * A method that creates a vector from the current matrix
+     * a getter for the raw row-major buffer of the matrix (rows getLd() floats apart), for the vectorized
+     * kernels. the buffer is aligned to MATRIX_ALIGNMENT, unless the matrix borrows it.
+     * @return a pointer to the first float of the matrix.
+     */
+    float *data()
+    {
+        return _myMat;
+    }
+
+    /**
+     * a const getter for the raw row-major buffer of the matrix (rows getLd() floats apart), for the vectorized
+     * kernels. the buffer is aligned to MATRIX_ALIGNMENT, unless the matrix borrows it.
+     * @return a pointer to the first float of the matrix.
+     */
+    const float *data() const
+    {
+        return _myMat;
+    }
+
+    /**
+     * a getter for whether the matrix owns its buffer.
+     * @return false if the matrix borrows a buffer it was constructed with, true otherwise.
+     */
+    bool ownsData() const;
+
+    /**
+     * A method that creates a vector from the current matrix, a padded matrix is packed in place.
      * @return reference for the vectorize matrix.
      */
     Matrix &vectorize();
@@ -98,18 +379,45 @@ public:
     void plainPrint() const;
 
     /**
-     * overriding the operator = for the matrix class, comparing two matrices.
+     * overriding the operator = for the matrix class, comparing two matrices. the matrix keeps its layout, and its
+     * buffer unless it borrows it.
      * @param m1 a matrix to init = on.
      * @return a reference to the new matrix.
      */
     Matrix &operator=(const Matrix &m1);
 
     /**
-     * a constant method for the operator + on a matrices, add all the coordinates 1 by 1.
-     * @param m1 a matrix to add to the current
-     * @return the sum of the adding.
+     * a move assignment for the matrix class, takes the buffer of m1 and leaves m1 as an empty 0x0 matrix.
+     * @param m1 a matrix to move.
+     * @return a reference to the current matrix.
+     */
+    Matrix &operator=(Matrix &&m1) noexcept;
+
+    /**
+     * evaluates a matrix expression into the current matrix, which keeps its layout. the current buffer is
+     * reused when the sizes match (or a packed matrix is only reshaped) and the expression does not read a
+     * float of it after writing it (like r = W*r + b). a borrowed buffer is never reused.
+     * @param expr the expression to evaluate.
+     * @return a reference to the current matrix.
      */
-    Matrix operator+(const Matrix &m1) const;
+    template<class E>
+    Matrix &operator=(const MatExpr<E> &expr)
+    {
+        const E &e = expr.self();
+        const bool sameDims = e.getRows() == matDims.rows && e.getCols() == matDims.cols;
+        const bool reshaped = !sameDims && e.getRows() * e.getCols() == _matSize && isPacked()
+                              && _rowStride(e.getCols(), _layout) == e.getCols();
+        if (!_ownsData || !(sameDims || reshaped) ||
+            e.aliases(_myMat, _myMat + _extent(), sameDims ? _ld : e.getCols()))
+        {
+            return *this = Matrix(e, _layout);
+        }
+        matDims.rows = e.getRows();
+        matDims.cols = e.getCols();
+        _ld = sameDims ? _ld : matDims.cols;
+        e.assignTo(_myMat, _ld, 1);
+        return *this;
+    }
 
     /**
     * a non-constant method for the operator + on a matrices, add all the coordinates 1 by 1.
@@ -118,71 +426,132 @@ public:
     */
     Matrix &operator+=(const Matrix &m1);
 
+    /**
+     * adds a matrix expression to the current matrix in a single pass, without evaluating it first.
+     * @param expr the expression to add
+     * @return a reference to the current matrix.
+     */
+    template<class E>
+    Matrix &operator+=(const MatExpr<E> &expr)
+    {
+        const E &e = expr.self();
+        if (matDims.rows != e.getRows() || matDims.cols != e.getCols())
+        {
+            throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
+        }
+        if (e.aliases(_myMat, _myMat + _extent(), _ld))
+        {
+            return *this += Matrix(e);
+        }
+        e.addTo(_myMat, _ld, 1);
+        return *this;
+    }
+
     /**
      * override method the the () operator, returning the (i,j) position of the function, where
-     * i is the row, and j is the colomn.
+     * i is the row, and j is the colomn. throws MatrixIndexError out of the bounds, unless MATRIX_UNCHECKED.
      * @param row the row index
      * @param col the col index
      * @return a reference to the (i,j) float of the matrix.
      */
-    float& operator()(int row, int col);
+    float& operator()(int row, int col)
+    {
+        checkMatrixIndex(row, matDims.rows);
+        checkMatrixIndex(col, matDims.cols);
+        return _myMat[(size_t) row * _ld + col];
+    }
 
     /**
      * a const method, overrides the () operator, returning the (i,j) position of the function, where
-     * i is the row, and j is the colomn.
+     * i is the row, and j is the colomn. throws MatrixIndexError out of the bounds, unless MATRIX_UNCHECKED.
      * @param row the row index
      * @param col the col index
      * @return the (i,j) float of the matrix.
      */
-    float operator()(int row, int col) const;
+    float operator()(int row, int col) const
+    {
+        checkMatrixIndex(row, matDims.rows);
+        checkMatrixIndex(col, matDims.cols);
+        return _myMat[(size_t) row * _ld + col];
+    }
 
     /**
      * a const method, overrides the [] operator, returning the position in the matrix,
-     * while the position = row*cols + col.
+     * while the position = row*cols + col (in any layout). throws MatrixIndexError out of the bounds, unless
+     * MATRIX_UNCHECKED.
      * @param position the index for the float in the matrix
      * @return the [i] float of the matrix.
      */
-    float operator[](int position) const;
+    float operator[](int position) const
+    {
+        checkMatrixIndex(position, _matSize);
+        return _myMat[_offset(position)];
+    }
 
     /**
      * a non-const method, overrides the [] operator, returning the position in the matrix,
-     * while the position = row*cols + col.
+     * while the position = row*cols + col (in any layout). throws MatrixIndexError out of the bounds, unless
+     * MATRIX_UNCHECKED.
      * @param position the index for the float in the matrix
      * @return a reference to the [i] float of the matrix.
      */
-    float& operator[](int position);
+    float& operator[](int position)
+    {
+        checkMatrixIndex(position, _matSize);
+        return _myMat[_offset(position)];
+    }
 
     /**
-     * a const override method for the operator *, representing a matrix multiplication.
-     * @param b a matrix to multiply from right to this.
-     * @return a matrix , the multiplication of this*b.
+     * an inline unchecked read of the (row, col) float, used by the expressions.
+     * @param row the row index
+     * @param col the col index
+     * @return the (row, col) float of the matrix.
      */
-    Matrix operator*(const Matrix &b) const;
+    float coeff(int row, int col) const
+    {
+        return _myMat[(size_t) row * _ld + col];
+    }
 
     /**
-     * a const override method for the operator *, representing a matrix and float from right.
-     * @param c a float to multiply from right to this.
-     * @return a matrix ,the multiplication of this*c.
+     * checks whether writing the matrix into a destination would overwrite a float of it before it is read.
+     * @param first the first float of the destination
+     * @param last the float past the last float of the destination
+     * @param ldd the distance between two rows of the destination, 0 when any overlap counts.
+     * @return true if the matrix overlaps the destination and is not at the same place in it.
      */
-    Matrix operator*(float c) const;
+    bool aliases(const float *first, const float *last, int ldd) const;
 
     /**
-     * a non-const override method for the operator *, representing a matrix and float from right.
-     * @param c a float to multiply from right to this.
-     * @return a matrix ,the multiplication of this*c.
+     * a view of the whole matrix, for slicing it without copying.
+     * @return a view of the floats of the matrix.
      */
-    Matrix operator*(float c);
+    MatrixView view();
+
     /**
-     * a const override friend function for the operator *, representing a matrix and float from left.
-     * @param c a float to multiply from left to a.
-     * @param a a matrix to multiply by c.
-     * @return a matrix , the multiplication of this*c.
+     * a read only view of the whole matrix, for slicing it without copying.
+     * @return a view of the floats of the matrix.
      */
-    friend Matrix operator*(float c, Matrix a);
+    ConstMatrixView view() const;
+
+    /**
+     * writes f * this into the given buffer.
+     * @param dst the first float of the destination
+     * @param ldd the distance between two rows of the destination
+     * @param f a scalar for the matrix
+     */
+    void assignTo(float *dst, int ldd, float f) const;
+
+    /**
+     * adds f * this to the given buffer.
+     * @param dst the first float of the destination
+     * @param ldd the distance between two rows of the destination
+     * @param f a scalar for the matrix
+     */
+    void addTo(float *dst, int ldd, float f) const;
 
     /**
      * a friend method overriding the >> operator, getting the floats to get in the matrix from the is input.
-     * if the input is too short, returns an error.
+     * if the input is too short, throws MatrixFileError.
      * @param is an istream to read from.
      * @param a a reference to matrix, to insert the object from "is" to.
      */
@@ -197,4 +566,9 @@ public:
     friend std::ostream & operator<<(std::ostream & os, const Matrix &a);
 
 };
+
+// the views of matrices, and the lazy operators +, * and their expression nodes.
+#include "MatrixView.h"
+#include "MatrixExpr.h"
+
 #endif //MATRIX_H
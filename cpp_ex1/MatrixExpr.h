@@ -0,0 +1,491 @@
+// MatrixExpr.h
+// the lazy matrix expressions, included at the end of Matrix.h (the nodes need the complete Matrix).
+//
+// every expression node provides:
+//  isElementwise             - true when any coordinate can be computed alone by coeff(row, col).
+//  getRows(), getCols()      - the dimensions of the result.
+//  aliases(first, last, ldd) - whether writing the expression into [first, last), rows ldd apart, would
+//                              overwrite a float it still has to read (ldd 0: whether it reads the range).
+//  assignTo(dst, ldd, f)     - dst = f * expr, in a single pass and without allocating.
+//  addTo(dst, ldd, f)        - dst += f * expr, in a single pass and without allocating.
+
+#ifndef MATRIXEXPR_H
+#define MATRIXEXPR_H
+
+#include <type_traits>
+#include "Gemm.h"
+#include "SimdKernels.h"
+
+/**
+ * how an expression node stores an operand: an expression node (or a view) by value, so an expression may be
+ * kept in an auto after the statement that built it (auto e = (a + b) * c), and a Matrix by reference, since
+ * copying it would copy its floats (the matrices a stored expression reads have to outlive it).
+ * @tparam E the operand type.
+ */
+template<class E>
+struct ExprStorage
+{
+    typedef const E type;
+};
+
+/**
+ * a Matrix operand is stored by reference.
+ */
+template<>
+struct ExprStorage<Matrix>
+{
+    typedef const Matrix &type;
+};
+
+/**
+ * writes f * e into dst, one coordinate at a time.
+ * @param e an element-wise expression
+ * @param dst the first float of the destination
+ * @param ldd the distance between two rows of the destination
+ * @param f a scalar for the expression
+ */
+template<class E>
+void assignCoeffs(const E &e, float *dst, int ldd, float f)
+{
+    for (int i = 0; i < e.getRows(); ++i)
+    {
+        for (int j = 0; j < e.getCols(); ++j)
+        {
+            dst[i * ldd + j] = f * e.coeff(i, j);
+        }
+    }
+}
+
+/**
+ * adds f * e to dst, one coordinate at a time.
+ * @param e an element-wise expression
+ * @param dst the first float of the destination
+ * @param ldd the distance between two rows of the destination
+ * @param f a scalar for the expression
+ */
+template<class E>
+void addCoeffs(const E &e, float *dst, int ldd, float f)
+{
+    for (int i = 0; i < e.getRows(); ++i)
+    {
+        for (int j = 0; j < e.getCols(); ++j)
+        {
+            dst[i * ldd + j] += f * e.coeff(i, j);
+        }
+    }
+}
+
+/**
+ * an operand of a product as a complete Matrix, an expression is evaluated into a temporary.
+ * @tparam E the operand type.
+ */
+template<class E>
+class Evaluated
+{
+private:
+    Matrix _value;
+public:
+
+    /**
+     * evaluates the expression.
+     * @param e the expression
+     */
+    explicit Evaluated(const E &e) : _value(e)
+    {
+    }
+
+    /**
+     * @return the first float of the evaluated matrix.
+     */
+    const float *data() const
+    {
+        return _value.data();
+    }
+
+    /**
+     * @return the distance between two rows of the evaluated matrix.
+     */
+    int ld() const
+    {
+        return _value.getLd();
+    }
+};
+
+/**
+ * a Matrix operand of a product is used in place.
+ */
+template<>
+class Evaluated<Matrix>
+{
+private:
+    const Matrix &_value;
+public:
+
+    /**
+     * refers to the matrix.
+     * @param m the matrix
+     */
+    explicit Evaluated(const Matrix &m) : _value(m)
+    {
+    }
+
+    /**
+     * @return the first float of the matrix.
+     */
+    const float *data() const
+    {
+        return _value.data();
+    }
+
+    /**
+     * @return the distance between two rows of the matrix.
+     */
+    int ld() const
+    {
+        return _value.getLd();
+    }
+};
+
+/**
+ * a view operand of a product is used in place, with its stride.
+ */
+template<class T>
+class Evaluated<BasicMatrixView<T>>
+{
+private:
+    BasicMatrixView<T> _value;
+public:
+
+    /**
+     * refers to the floats of the view.
+     * @param v the view
+     */
+    explicit Evaluated(const BasicMatrixView<T> &v) : _value(v)
+    {
+    }
+
+    /**
+     * @return the first float of the view.
+     */
+    const float *data() const
+    {
+        return _value.data();
+    }
+
+    /**
+     * @return the distance between two rows of the view.
+     */
+    int ld() const
+    {
+        return _value.getLd();
+    }
+};
+
+/**
+ * the lazy sum of two expressions of the same dimensions.
+ * @tparam L the left expression type.
+ * @tparam R the right expression type.
+ */
+template<class L, class R>
+class MatSum : public MatExpr<MatSum<L, R>>
+{
+private:
+    typename ExprStorage<L>::type _l;
+    typename ExprStorage<R>::type _r;
+public:
+
+    static constexpr bool isElementwise = L::isElementwise && R::isElementwise;
+
+    /**
+     * the constructor of the sum, the dimensions are checked by operator+.
+     * @param l the left expression
+     * @param r the right expression
+     */
+    MatSum(const L &l, const R &r) : _l(l), _r(r)
+    {
+    }
+
+    /**
+     * @return the number of rows of the sum.
+     */
+    int getRows() const
+    {
+        return _l.getRows();
+    }
+
+    /**
+     * @return the number of cols of the sum.
+     */
+    int getCols() const
+    {
+        return _l.getCols();
+    }
+
+    /**
+     * @return the (row, col) float of the sum.
+     */
+    float coeff(int row, int col) const
+    {
+        return _l.coeff(row, col) + _r.coeff(row, col);
+    }
+
+    /**
+     * @return whether one of the operands would be overwritten before it is read.
+     */
+    bool aliases(const float *first, const float *last, int ldd) const
+    {
+        return _l.aliases(first, last, ldd) || _r.aliases(first, last, ldd);
+    }
+
+    /**
+     * dst = f * (l + r). an element-wise sum is computed in one pass, a sum with a product writes the other
+     * operand and then accumulates the product on top of it.
+     */
+    void assignTo(float *dst, int ldd, float f) const
+    {
+        if constexpr (std::is_same<L, Matrix>::value && std::is_same<R, Matrix>::value)
+        {
+            if (f == 1 && ldd == getCols() && _l.isPacked() && _r.isPacked())
+            {
+                simdKernels().add(dst, _l.data(), _r.data(), getRows() * getCols());
+                return;
+            }
+        }
+        if constexpr (isElementwise)
+        {
+            assignCoeffs(*this, dst, ldd, f);
+        }
+        else if constexpr (!L::isElementwise)
+        {
+            _r.assignTo(dst, ldd, f);
+            _l.addTo(dst, ldd, f);
+        }
+        else
+        {
+            _l.assignTo(dst, ldd, f);
+            _r.addTo(dst, ldd, f);
+        }
+    }
+
+    /**
+     * dst += f * (l + r).
+     */
+    void addTo(float *dst, int ldd, float f) const
+    {
+        if constexpr (isElementwise)
+        {
+            addCoeffs(*this, dst, ldd, f);
+        }
+        else
+        {
+            _l.addTo(dst, ldd, f);
+            _r.addTo(dst, ldd, f);
+        }
+    }
+};
+
+/**
+ * the lazy product of an expression by a float.
+ * @tparam E the expression type.
+ */
+template<class E>
+class MatScale : public MatExpr<MatScale<E>>
+{
+private:
+    typename ExprStorage<E>::type _e;
+    float _c;
+public:
+
+    static constexpr bool isElementwise = E::isElementwise;
+
+    /**
+     * the constructor of the scale.
+     * @param e the expression
+     * @param c the float
+     */
+    MatScale(const E &e, float c) : _e(e), _c(c)
+    {
+    }
+
+    /**
+     * @return the number of rows of the result.
+     */
+    int getRows() const
+    {
+        return _e.getRows();
+    }
+
+    /**
+     * @return the number of cols of the result.
+     */
+    int getCols() const
+    {
+        return _e.getCols();
+    }
+
+    /**
+     * @return the (row, col) float of the result.
+     */
+    float coeff(int row, int col) const
+    {
+        return _c * _e.coeff(row, col);
+    }
+
+    /**
+     * @return whether the expression would be overwritten before it is read.
+     */
+    bool aliases(const float *first, const float *last, int ldd) const
+    {
+        return _e.aliases(first, last, ldd);
+    }
+
+    /**
+     * dst = f * c * e, the float is folded into the expression's own pass.
+     */
+    void assignTo(float *dst, int ldd, float f) const
+    {
+        _e.assignTo(dst, ldd, f * _c);
+    }
+
+    /**
+     * dst += f * c * e, the float is folded into the expression's own pass.
+     */
+    void addTo(float *dst, int ldd, float f) const
+    {
+        _e.addTo(dst, ldd, f * _c);
+    }
+};
+
+/**
+ * the lazy matrix product of two expressions, evaluated by sgemm straight into the destination.
+ * @tparam L the left expression type.
+ * @tparam R the right expression type.
+ */
+template<class L, class R>
+class MatProduct : public MatExpr<MatProduct<L, R>>
+{
+private:
+    typename ExprStorage<L>::type _l;
+    typename ExprStorage<R>::type _r;
+
+    /**
+     * dst = f * l * r + beta * dst.
+     */
+    void _gemm(float *dst, int ldd, float f, float beta) const
+    {
+        Evaluated<L> a(_l);
+        Evaluated<R> b(_r);
+        sgemm(getRows(), getCols(), _l.getCols(), f, a.data(), a.ld(), b.data(), b.ld(), beta, dst, ldd);
+    }
+
+public:
+
+    static constexpr bool isElementwise = false;
+
+    /**
+     * the constructor of the product, the dimensions are checked by operator*.
+     * @param l the left expression
+     * @param r the right expression
+     */
+    MatProduct(const L &l, const R &r) : _l(l), _r(r)
+    {
+    }
+
+    /**
+     * @return the number of rows of the product.
+     */
+    int getRows() const
+    {
+        return _l.getRows();
+    }
+
+    /**
+     * @return the number of cols of the product.
+     */
+    int getCols() const
+    {
+        return _r.getCols();
+    }
+
+    /**
+     * @return whether one of the operands reads the range, every float of C reads whole rows and cols of them.
+     */
+    bool aliases(const float *first, const float *last, int) const
+    {
+        return _l.aliases(first, last, 0) || _r.aliases(first, last, 0);
+    }
+
+    /**
+     * dst = f * l * r.
+     */
+    void assignTo(float *dst, int ldd, float f) const
+    {
+        _gemm(dst, ldd, f, 0);
+    }
+
+    /**
+     * dst += f * l * r.
+     */
+    void addTo(float *dst, int ldd, float f) const
+    {
+        _gemm(dst, ldd, f, 1);
+    }
+};
+
+/**
+ * the operator + on two matrix expressions, add all the coordinates 1 by 1 when assigned.
+ * @param l the left expression
+ * @param r the right expression
+ * @return the lazy sum.
+ */
+template<class L, class R>
+MatSum<L, R> operator+(const MatExpr<L> &l, const MatExpr<R> &r)
+{
+    if (l.self().getRows() != r.self().getRows() || l.self().getCols() != r.self().getCols())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
+    }
+    return MatSum<L, R>(l.self(), r.self());
+}
+
+/**
+ * the operator * on two matrix expressions, representing a matrix multiplication.
+ * @param l the left expression
+ * @param r the right expression
+ * @return the lazy product l*r.
+ */
+template<class L, class R>
+MatProduct<L, R> operator*(const MatExpr<L> &l, const MatExpr<R> &r)
+{
+    if (l.self().getCols() != r.self().getRows())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    return MatProduct<L, R>(l.self(), r.self());
+}
+
+/**
+ * the operator * on a matrix expression and a float from right.
+ * @param e the expression
+ * @param c a float to multiply from right to e.
+ * @return the lazy e*c.
+ */
+template<class E>
+MatScale<E> operator*(const MatExpr<E> &e, float c)
+{
+    return MatScale<E>(e.self(), c);
+}
+
+/**
+ * the operator * on a matrix expression and a float from left.
+ * @param c a float to multiply from left to e.
+ * @param e the expression
+ * @return the lazy c*e.
+ */
+template<class E>
+MatScale<E> operator*(float c, const MatExpr<E> &e)
+{
+    return MatScale<E>(e.self(), c);
+}
+
+#endif //MATRIXEXPR_H
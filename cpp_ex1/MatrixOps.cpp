@@ -0,0 +1,151 @@
+#include <algorithm>
+#include "MatrixOps.h"
+#include "Gemm.h"
+#include "SimdKernels.h"
+
+/**
+ * whether the rows of a view are one after the other, so an operation on it is a single call of a kernel.
+ * @param v the view.
+ * @return true if the view is one contiguous run of floats.
+ */
+template<class T>
+static bool _isContiguous(const BasicMatrixView<T> &v)
+{
+    return v.getLd() == v.getCols() || v.getRows() <= 1;
+}
+
+/**
+ * out = alpha * a * b + beta * out, with sgemm. when beta is 0, out is never read.
+ * throws MatrixSizeError if the sizes dont fit.
+ * @param out an m x n destination, may not overlap a or b.
+ * @param a an m x k matrix.
+ * @param b a k x n matrix.
+ * @param alpha a scalar for a * b.
+ * @param beta a scalar for the previous values of out.
+ */
+void gemm(MatrixView out, ConstMatrixView a, ConstMatrixView b, float alpha, float beta)
+{
+    if (a.getCols() != b.getRows() || out.getRows() != a.getRows() || out.getCols() != b.getCols())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    if (a.getCols() == 0)
+    {
+        // an empty product, sgemm would leave out as it is.
+        for (int i = 0; i < out.getRows(); ++i)
+        {
+            float *row = out.data() + (size_t) i * out.getLd();
+            std::transform(row, row + out.getCols(), row, [beta](float v)
+            {
+                return (beta == 0) ? 0 : beta * v;
+            });
+        }
+        return;
+    }
+    sgemm(out.getRows(), out.getCols(), a.getCols(), alpha, a.data(), a.getLd(), b.data(), b.getLd(), beta,
+          out.data(), out.getLd());
+}
+
+/**
+ * y = alpha * a * x + beta * y, a dot product per row of a. when beta is 0, y is never read.
+ * throws MatrixSizeError if the sizes dont fit.
+ * @param y an m x 1 destination, may not overlap a or x.
+ * @param a an m x k matrix.
+ * @param x a k x 1 vector (a col of a matrix too).
+ * @param alpha a scalar for a * x.
+ * @param beta a scalar for the previous values of y.
+ */
+void gemv(MatrixView y, ConstMatrixView a, ConstMatrixView x, float alpha, float beta)
+{
+    if (x.getCols() != 1 || y.getCols() != 1 || a.getCols() != x.getRows() || y.getRows() != a.getRows())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    if (!_isContiguous(x))
+    {
+        // the floats of a col of a matrix are a row apart, sgemm gathers them first.
+        gemm(y, a, x, alpha, beta);
+        return;
+    }
+    const SimdKernels &kernels = simdKernels();
+    for (int i = 0; i < a.getRows(); ++i)
+    {
+        float &yi = y.data()[(size_t) i * y.getLd()];
+        const float val = alpha * kernels.dot(a.data() + (size_t) i * a.getLd(), x.data(), a.getCols());
+        yi = (beta == 0) ? val : val + beta * yi;
+    }
+}
+
+/**
+ * y += alpha * x. throws MatrixSizeError if the sizes are not the same.
+ * @param y the destination.
+ * @param alpha a scalar for x.
+ * @param x a matrix of the size of y, x may be y itself.
+ */
+void axpy(MatrixView y, float alpha, ConstMatrixView x)
+{
+    if (y.getRows() != x.getRows() || y.getCols() != x.getCols())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
+    }
+    x.addTo(y.data(), y.getLd(), alpha);
+}
+
+/**
+ * x *= alpha.
+ * @param x the matrix to scale.
+ * @param alpha the scalar.
+ */
+void scaleInPlace(MatrixView x, float alpha)
+{
+    const SimdKernels &kernels = simdKernels();
+    if (_isContiguous(x))
+    {
+        kernels.scale(x.data(), x.data(), alpha, x.getRows() * x.getCols());
+        return;
+    }
+    for (int i = 0; i < x.getRows(); ++i)
+    {
+        float *row = x.data() + (size_t) i * x.getLd();
+        kernels.scale(row, row, alpha, x.getCols());
+    }
+}
+
+/**
+ * y += x, where x is broadcast over y: x is a matrix of the size of y, a rows x 1 col added to every col of
+ * y (a bias over a batch of outputs), or a 1 x cols row added to every row of y. throws MatrixSizeError if x
+ * is none of them.
+ * @param y the destination.
+ * @param x the matrix, col or row to add.
+ */
+void addInPlace(MatrixView y, ConstMatrixView x)
+{
+    const bool sameSize = x.getRows() == y.getRows() && x.getCols() == y.getCols();
+    const bool col = x.getRows() == y.getRows() && x.getCols() == 1;
+    const bool row = x.getRows() == 1 && x.getCols() == y.getCols();
+    if (!sameSize && !col && !row)
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
+    }
+    const SimdKernels &kernels = simdKernels();
+    if (sameSize && _isContiguous(y) && _isContiguous(x))
+    {
+        kernels.add(y.data(), y.data(), x.data(), y.getRows() * y.getCols());
+        return;
+    }
+    for (int i = 0; i < y.getRows(); ++i)
+    {
+        float *dst = y.data() + (size_t) i * y.getLd();
+        if (sameSize || row)
+        {
+            kernels.add(dst, dst, x.data() + (sameSize ? (size_t) i * x.getLd() : 0), y.getCols());
+            continue;
+        }
+        // a float of the col is added to a whole row, a loop the compiler vectorizes.
+        const float value = x.data()[(size_t) i * x.getLd()];
+        for (int j = 0; j < y.getCols(); ++j)
+        {
+            dst[j] += value;
+        }
+    }
+}
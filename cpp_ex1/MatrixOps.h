@@ -0,0 +1,57 @@
+// MatrixOps.h
+// the destination-passing operations on matrices: every operation writes into a matrix (or a view of one) the
+// caller already has, like BLAS, and never allocates. a Matrix converts to a view, so any of them takes a
+// Matrix, a row, a col or a block of one. the operators of MatrixExpr.h stay the convenient (allocating) form.
+
+#ifndef MATRIXOPS_H
+#define MATRIXOPS_H
+
+#include "Matrix.h"
+
+/**
+ * out = alpha * a * b + beta * out, with sgemm. when beta is 0, out is never read.
+ * throws MatrixSizeError if the sizes dont fit.
+ * @param out an m x n destination, may not overlap a or b.
+ * @param a an m x k matrix.
+ * @param b a k x n matrix.
+ * @param alpha a scalar for a * b.
+ * @param beta a scalar for the previous values of out.
+ */
+void gemm(MatrixView out, ConstMatrixView a, ConstMatrixView b, float alpha = 1, float beta = 0);
+
+/**
+ * y = alpha * a * x + beta * y, a dot product per row of a. when beta is 0, y is never read.
+ * throws MatrixSizeError if the sizes dont fit.
+ * @param y an m x 1 destination, may not overlap a or x.
+ * @param a an m x k matrix.
+ * @param x a k x 1 vector (a col of a matrix too).
+ * @param alpha a scalar for a * x.
+ * @param beta a scalar for the previous values of y.
+ */
+void gemv(MatrixView y, ConstMatrixView a, ConstMatrixView x, float alpha = 1, float beta = 0);
+
+/**
+ * y += alpha * x. throws MatrixSizeError if the sizes are not the same.
+ * @param y the destination.
+ * @param alpha a scalar for x.
+ * @param x a matrix of the size of y, x may be y itself.
+ */
+void axpy(MatrixView y, float alpha, ConstMatrixView x);
+
+/**
+ * x *= alpha.
+ * @param x the matrix to scale.
+ * @param alpha the scalar.
+ */
+void scaleInPlace(MatrixView x, float alpha);
+
+/**
+ * y += x, where x is broadcast over y: x is a matrix of the size of y, a rows x 1 col added to every col of
+ * y (a bias over a batch of outputs), or a 1 x cols row added to every row of y. throws MatrixSizeError if x
+ * is none of them.
+ * @param y the destination.
+ * @param x the matrix, col or row to add.
+ */
+void addInPlace(MatrixView y, ConstMatrixView x);
+
+#endif //MATRIXOPS_H
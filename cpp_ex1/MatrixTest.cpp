@@ -0,0 +1,316 @@
+// MatrixTest.cpp
+// checks of the matrices, their lazy expressions and their products that the programs do not exercise: make
+// matrixtest builds and runs it, it exits with 1 on the first check that fails.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Gemm.h"
+#include "Matrix.h"
+#include "TestData.h"
+
+#define TEST_FAILED_ERROR "Error: a matrix check failed: "
+
+// the largest difference between an expression and its expected value that is accepted.
+#define TEST_TOLERANCE 1e-4f
+// the largest difference between a Strassen product and the classic one, in units of k * u * |A| * |B| (the
+// inner dimension, the unit roundoff of a float and the max norms): a few times the growth of two levels.
+#define TEST_STRASSEN_FACTOR 50
+
+/**
+ * computes l * r one coordinate at a time.
+ * @param l the left matrix.
+ * @param r the right matrix.
+ * @return the product.
+ */
+static Matrix _naiveProduct(const Matrix &l, const Matrix &r)
+{
+    Matrix result(l.getRows(), r.getCols());
+    for (int i = 0; i < l.getRows(); ++i)
+    {
+        for (int j = 0; j < r.getCols(); ++j)
+        {
+            float sum = 0;
+            for (int k = 0; k < l.getCols(); ++k)
+            {
+                sum += l(i, k) * r(k, j);
+            }
+            result(i, j) = sum;
+        }
+    }
+    return result;
+}
+
+/**
+ * exits with 1 if a check failed.
+ * @param passed whether the check passed.
+ * @param name the name of the check.
+ */
+static void _expect(bool passed, const char *name)
+{
+    if (!passed)
+    {
+        std::fprintf(stderr, "%s%s\n", TEST_FAILED_ERROR, name);
+        std::exit(EXIT_FAILURE);
+    }
+    std::printf("ok  %s\n", name);
+}
+
+/**
+ * exits with 1 if a result differs from its expected value.
+ * @param name the name of the check.
+ * @param result the result of the expression.
+ * @param expected the expected value.
+ */
+static void _expectEqual(const char *name, const Matrix &result, const Matrix &expected)
+{
+    bool equal = result.getRows() == expected.getRows() && result.getCols() == expected.getCols();
+    for (int i = 0; equal && i < expected.getRows(); ++i)
+    {
+        for (int j = 0; equal && j < expected.getCols(); ++j)
+        {
+            equal = std::fabs(result(i, j) - expected(i, j)) <= TEST_TOLERANCE;
+        }
+    }
+    _expect(equal, name);
+}
+
+/**
+ * the expressions kept in an auto and assigned after the statement that built them: their inner nodes are
+ * temporaries of that statement, the outer node has to hold them by value.
+ * @param gen the random generator.
+ */
+static void _testStoredExpressions(std::mt19937 &gen)
+{
+    Matrix a(24, 40), b(24, 40), c(40, 16);
+    fillUniform(a, gen);
+    fillUniform(b, gen);
+    fillUniform(c, gen);
+
+    Matrix sum(24, 40), scaled(24, 40);
+    for (int i = 0; i < a.getRows() * a.getCols(); ++i)
+    {
+        sum[i] = a[i] + b[i];
+        scaled[i] = 2 * (a[i] + 0.5f * b[i]);
+    }
+
+    auto product = (a + b) * c;
+    Matrix productResult = product;
+    _expectEqual("auto e = (a + b) * c", productResult, _naiveProduct(sum, c));
+
+    auto scale = 2.f * (a + b * 0.5f);
+    Matrix scaleResult = scale;
+    _expectEqual("auto e = 2 * (a + b * 0.5)", scaleResult, scaled);
+
+    auto chain = ((a + b) * c) * 0.5f;
+    Matrix chainResult = chain;
+    Matrix halfProduct = _naiveProduct(sum, c);
+    for (int i = 0; i < halfProduct.getRows() * halfProduct.getCols(); ++i)
+    {
+        halfProduct[i] *= 0.5f;
+    }
+    _expectEqual("auto e = ((a + b) * c) * 0.5", chainResult, halfProduct);
+
+    auto viewSum = a.view().rowRange(0, 8) + b.view().rowRange(0, 8);
+    Matrix viewResult = viewSum;
+    Matrix firstRows(8, 40);
+    for (int i = 0; i < firstRows.getRows() * firstRows.getCols(); ++i)
+    {
+        firstRows[i] = sum[i];
+    }
+    _expectEqual("auto e = a.rows(0, 8) + b.rows(0, 8)", viewResult, firstRows);
+
+    Matrix into(24, 16);
+    into = product;
+    into += product;
+    Matrix twice = _naiveProduct(sum, c);
+    for (int i = 0; i < twice.getRows() * twice.getCols(); ++i)
+    {
+        twice[i] *= 2;
+    }
+    _expectEqual("m = e; m += e", into, twice);
+}
+
+/**
+ * the assignments to a matrix borrowing a buffer: the buffer (maybe read only, like a mapped model file) is
+ * never written, the matrix gets a buffer of its own.
+ * @param gen the random generator.
+ */
+static void _testBorrowedAssignment(std::mt19937 &gen)
+{
+    Matrix source(6, 5), other(6, 5);
+    fillUniform(source, gen);
+    fillUniform(other, gen);
+    float buffer[30] = {};
+    Matrix borrowed(6, 5, buffer);
+    borrowed = source;
+    _expectEqual("borrowed = m (same size)", borrowed, source);
+
+    Matrix reshaped(5, 6, buffer);
+    reshaped = source;
+    _expectEqual("borrowed = m (reshaped)", reshaped, source);
+
+    Matrix assigned(6, 5, buffer);
+    assigned = source + other;
+    Matrix sum(6, 5);
+    for (int i = 0; i < 30; ++i)
+    {
+        sum[i] = source[i] + other[i];
+    }
+    _expectEqual("borrowed = a + b", assigned, sum);
+    bool untouched = borrowed.ownsData() && reshaped.ownsData() && assigned.ownsData();
+    for (float value : buffer)
+    {
+        untouched = untouched && value == 0;
+    }
+    _expect(untouched, "the borrowed buffer is not written, the matrices own their copies");
+}
+
+/**
+ * the assignments whose source reads the floats they write: shifted copies inside one matrix, products into
+ * a view of their own operand, and reshaping assignments reading the matrix they replace.
+ * @param gen the random generator.
+ */
+static void _testAliasedAssignment(std::mt19937 &gen)
+{
+    Matrix original(8, 40);
+    fillUniform(original, gen);
+    Matrix shifted = original, expected = original;
+    shifted.view().rowRange(2, 6) = shifted.view().rowRange(0, 6);
+    for (int i = 2; i < 8; ++i)
+    {
+        for (int j = 0; j < 40; ++j)
+        {
+            expected(i, j) = original(i - 2, j);
+        }
+    }
+    _expectEqual("m.rows(2, 6) = m.rows(0, 6)", shifted, expected);
+
+    shifted = original;
+    expected = original;
+    shifted.view().colRange(1, 39) = 2.f * shifted.view().colRange(0, 39);
+    for (int i = 0; i < 8; ++i)
+    {
+        for (int j = 1; j < 40; ++j)
+        {
+            expected(i, j) = 2 * original(i, j - 1);
+        }
+    }
+    _expectEqual("m.cols(1, 39) = 2 * m.cols(0, 39)", shifted, expected);
+
+    // an inner dimension past GEMM_KC: the second block of B is read after the first one wrote C.
+    Matrix a(300, 300), b(300, 40);
+    fillUniform(a, gen);
+    fillUniform(b, gen);
+    Matrix firstCols(300, 24);
+    for (int i = 0; i < 300; ++i)
+    {
+        for (int j = 0; j < 24; ++j)
+        {
+            firstCols(i, j) = b(i, j);
+        }
+    }
+    const Matrix product = _naiveProduct(a, firstCols);
+    expected = b;
+    for (int i = 0; i < 300; ++i)
+    {
+        for (int j = 0; j < 24; ++j)
+        {
+            expected(i, j) = product(i, j);
+        }
+    }
+    b.view().colRange(0, 24) = a.view() * b.view().colRange(0, 24);
+    _expectEqual("b.cols(0, 24) = a * b.cols(0, 24)", b, expected);
+
+    Matrix square(4, 6), left(6, 4);
+    fillUniform(square, gen);
+    fillUniform(left, gen);
+    Matrix firstSquare(4, 4);
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            firstSquare(i, j) = square(i, j);
+        }
+    }
+    square = left * square.view().colRange(0, 4);
+    _expectEqual("m (4x6) = l * m.cols(0, 4) (6x4)", square, _naiveProduct(left, firstSquare));
+
+    Matrix reshaped = original;
+    const Matrix other = original;
+    reshaped = ConstMatrixView(reshaped.data(), 40, 8, 8) + ConstMatrixView(other.data(), 40, 8, 8);
+    bool doubled = reshaped.getRows() == 40 && reshaped.getCols() == 8;
+    for (int i = 0; doubled && i < 320; ++i)
+    {
+        doubled = reshaped[i] == 2 * original[i];
+    }
+    _expect(doubled, "m (8x40) = m as 40x8 + m as 40x8");
+}
+
+/**
+ * the largest absolute value of a matrix.
+ * @param m the matrix.
+ * @return the max norm of m.
+ */
+static double _maxNorm(const Matrix &m)
+{
+    double norm = 0;
+    for (int i = 0; i < m.getRows() * m.getCols(); ++i)
+    {
+        norm = std::max(norm, (double) std::fabs(m[i]));
+    }
+    return norm;
+}
+
+/**
+ * sgemmStrassen against the classic sgemm on odd and non-square products above the cutoff, which the
+ * recursion splits into uneven halves and peels: the difference has to be within
+ * TEST_STRASSEN_FACTOR * k * u * |A| * |B|.
+ * @param gen the random generator.
+ */
+static void _testStrassen(std::mt19937 &gen)
+{
+    const int shapes[][3] = {{777, 777, 777}, {1025, 1031, 1027}};
+    setGemmStrassenSize(0);
+    for (const auto &shape : shapes)
+    {
+        const int m = shape[0], n = shape[1], k = shape[2];
+        Matrix a(m, k), b(k, n), classic(m, n), strassen(m, n);
+        fillUniform(a, gen);
+        fillUniform(b, gen);
+        sgemm(m, n, k, 1, a.data(), a.getLd(), b.data(), b.getLd(), 0, classic.data(), classic.getLd());
+        std::vector<float> workspace(sgemmStrassenWorkspace(m, n, k, 1, 0));
+        sgemmStrassen(m, n, k, 1, a.data(), a.getLd(), b.data(), b.getLd(), 0, strassen.data(), strassen.getLd(),
+                      workspace.data());
+        double error = 0;
+        for (int i = 0; i < m; ++i)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                error = std::max(error, (double) std::fabs(strassen(i, j) - classic(i, j)));
+            }
+        }
+        const double bound = TEST_STRASSEN_FACTOR * k * std::ldexp(1.0, -24) * _maxNorm(a) * _maxNorm(b);
+        char name[96];
+        std::snprintf(name, sizeof(name), "sgemmStrassen %dx%dx%d (error %.3g, bound %.3g)", m, n, k, error, bound);
+        _expect(!workspace.empty() && error <= bound, name);
+    }
+    setGemmStrassenSize(GEMM_STRASSEN_SIZE);
+}
+
+/**
+ * the checks of the expressions.
+ * @return 0, or 1 (by exit) on the first failed check.
+ */
+int main()
+{
+    std::mt19937 gen(7);
+    _testStoredExpressions(gen);
+    _testBorrowedAssignment(gen);
+    _testAliasedAssignment(gen);
+    _testStrassen(gen);
+    return EXIT_SUCCESS;
+}
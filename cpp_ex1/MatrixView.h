@@ -0,0 +1,318 @@
+// MatrixView.h
+// the non-owning views of matrices, included at the end of Matrix.h (a view converts from a complete Matrix).
+
+#ifndef MATRIXVIEW_H
+#define MATRIXVIEW_H
+
+#define MAT_VIEW_SIZE_ERROR "Error: cant assign to a view of another size"
+
+#include <cstring>
+#include <type_traits>
+#include "SimdKernels.h"
+
+/**
+ * a view of rows x cols floats of a row-major buffer it does not own, rows ld floats apart: a whole Matrix,
+ * or a row, a col or a block of one, sliced without copying. a view is an expression like a Matrix, so it may
+ * be an operand of +, * and of the products, and a MatrixView may be assigned (or added) an expression, which
+ * writes the floats it views. the buffer has to outlive the view.
+ * @tparam T float for a view that writes its floats, const float for one that only reads them.
+ */
+template<class T>
+class BasicMatrixView : public MatExpr<BasicMatrixView<T>>
+{
+private:
+    T *_data;
+    int _rows, _cols, _ld;
+
+    /**
+     * checks that a slice [first, first + count) is in [0, size), in every build (it is once per slice).
+     * @param first the first index of the slice.
+     * @param count the number of indices of the slice.
+     * @param size the number of indices.
+     */
+    static void _checkSlice(int first, int count, int size)
+    {
+        if (first < 0 || count < 0 || first > size - count)
+        {
+            throwMatrixIndexError();
+        }
+    }
+
+public:
+
+    /**
+     * a view reads a coordinate at a time, like a Matrix.
+     */
+    static constexpr bool isElementwise = true;
+
+    /**
+     * a constructor of a view of a buffer.
+     * @param data the first float of the view.
+     * @param rows the number of rows of the view.
+     * @param cols the number of cols of the view.
+     * @param ld the distance (in floats) between two rows of the buffer, at least cols.
+     */
+    BasicMatrixView(T *data, int rows, int cols, int ld) : _data(data), _rows(rows), _cols(cols), _ld(ld)
+    {
+        if (rows < 0 || cols < 0 || ld < cols)
+        {
+            throw MatrixSizeError(NEG_MAT_SIZE_ERROR);
+        }
+    }
+
+    /**
+     * a view of a whole matrix, a const matrix only gives a ConstMatrixView.
+     * @param m the matrix.
+     */
+    BasicMatrixView(typename std::conditional<std::is_const<T>::value, const Matrix, Matrix>::type &m)
+            : BasicMatrixView(m.data(), m.getRows(), m.getCols(), m.getLd())
+    {
+    }
+
+    /**
+     * a read only view of the floats of a MatrixView.
+     * @param v the view.
+     */
+    template<class U, class = typename std::enable_if<std::is_const<T>::value && !std::is_const<U>::value>::type>
+    BasicMatrixView(const BasicMatrixView<U> &v) : _data(v.data()), _rows(v.getRows()), _cols(v.getCols()),
+                                                   _ld(v.getLd())
+    {
+    }
+
+    BasicMatrixView(const BasicMatrixView &v) = default;
+
+    /**
+     * copies the floats of another view of the same size into the floats of this one, like a Matrix would.
+     * @param v the view to copy.
+     * @return a reference to this view.
+     */
+    BasicMatrixView &operator=(const BasicMatrixView &v)
+    {
+        return *this = static_cast<const MatExpr<BasicMatrixView> &>(v);
+    }
+
+    /**
+     * @return the number of rows of the view.
+     */
+    int getRows() const
+    {
+        return _rows;
+    }
+
+    /**
+     * @return the number of cols of the view.
+     */
+    int getCols() const
+    {
+        return _cols;
+    }
+
+    /**
+     * @return the distance (in floats) between two rows of the view.
+     */
+    int getLd() const
+    {
+        return _ld;
+    }
+
+    /**
+     * @return the first float of the view.
+     */
+    T *data() const
+    {
+        return _data;
+    }
+
+    /**
+     * the (row, col) float of the view. throws MatrixIndexError out of the bounds, unless MATRIX_UNCHECKED.
+     * @param row the row index
+     * @param col the col index
+     * @return a reference to the float.
+     */
+    T &operator()(int row, int col) const
+    {
+        checkMatrixIndex(row, _rows);
+        checkMatrixIndex(col, _cols);
+        return _data[(size_t) row * _ld + col];
+    }
+
+    /**
+     * an inline unchecked read of the (row, col) float, used by the expressions.
+     * @param row the row index
+     * @param col the col index
+     * @return the float.
+     */
+    float coeff(int row, int col) const
+    {
+        return _data[(size_t) row * _ld + col];
+    }
+
+    /**
+     * a view of the rows [first, first + count), throws MatrixIndexError out of the bounds.
+     * @param first the first row.
+     * @param count the number of rows.
+     * @return the view of the rows.
+     */
+    BasicMatrixView rowRange(int first, int count) const
+    {
+        _checkSlice(first, count, _rows);
+        return BasicMatrixView(_data + (size_t) first * _ld, count, _cols, _ld);
+    }
+
+    /**
+     * a view of the cols [first, first + count), like a tile of the images of a batch. throws MatrixIndexError
+     * out of the bounds.
+     * @param first the first col.
+     * @param count the number of cols.
+     * @return the view of the cols.
+     */
+    BasicMatrixView colRange(int first, int count) const
+    {
+        _checkSlice(first, count, _cols);
+        return BasicMatrixView(_data + first, _rows, count, _ld);
+    }
+
+    /**
+     * a view of a block, throws MatrixIndexError out of the bounds.
+     * @param row the first row of the block.
+     * @param col the first col of the block.
+     * @param rows the number of rows of the block.
+     * @param cols the number of cols of the block.
+     * @return the view of the block.
+     */
+    BasicMatrixView block(int row, int col, int rows, int cols) const
+    {
+        return rowRange(row, rows).colRange(col, cols);
+    }
+
+    /**
+     * a view of a row, throws MatrixIndexError out of the bounds.
+     * @param i the index of the row.
+     * @return a 1 x cols view.
+     */
+    BasicMatrixView row(int i) const
+    {
+        return rowRange(i, 1);
+    }
+
+    /**
+     * a view of a col, throws MatrixIndexError out of the bounds.
+     * @param j the index of the col.
+     * @return a rows x 1 view.
+     */
+    BasicMatrixView col(int j) const
+    {
+        return colRange(j, 1);
+    }
+
+    /**
+     * checks whether writing the view into a destination would overwrite a float of it before it is read.
+     * @param first the first float of the destination
+     * @param last the float past the last float of the destination
+     * @param ldd the distance between two rows of the destination, 0 when any overlap counts.
+     * @return true if the view overlaps the destination and is not at the same place in it.
+     */
+    bool aliases(const float *first, const float *last, int ldd) const
+    {
+        if (_rows == 0 || _cols == 0)
+        {
+            return false;
+        }
+        const bool overlaps = _data < last && first < _data + (size_t) (_rows - 1) * _ld + _cols;
+        return overlaps && !(first == _data && ldd == _ld);
+    }
+
+    /**
+     * writes f * this into the given buffer, a row at a time.
+     * @param dst the first float of the destination
+     * @param ldd the distance between two rows of the destination
+     * @param f a scalar for the view
+     */
+    void assignTo(float *dst, int ldd, float f) const
+    {
+        const SimdKernels &kernels = simdKernels();
+        for (int i = 0; i < _rows; ++i)
+        {
+            float *dstRow = dst + (size_t) i * ldd;
+            const float *row = _data + (size_t) i * _ld;
+            if (f != 1)
+            {
+                kernels.scale(dstRow, row, f, _cols);
+            }
+            else if (dstRow != row)
+            {
+                std::memcpy(dstRow, row, _cols * sizeof(float));
+            }
+        }
+    }
+
+    /**
+     * adds f * this to the given buffer, a row at a time.
+     * @param dst the first float of the destination
+     * @param ldd the distance between two rows of the destination
+     * @param f a scalar for the view
+     */
+    void addTo(float *dst, int ldd, float f) const
+    {
+        const SimdKernels &kernels = simdKernels();
+        for (int i = 0; i < _rows; ++i)
+        {
+            kernels.axpy(dst + (size_t) i * ldd, f, _data + (size_t) i * _ld, _cols);
+        }
+    }
+
+    /**
+     * evaluates an expression into the floats of the view, which has its size. an expression that reads the
+     * floats in another place than it writes them is evaluated into a temporary first.
+     * @param expr the expression to evaluate.
+     * @return a reference to this view.
+     */
+    template<class E>
+    BasicMatrixView &operator=(const MatExpr<E> &expr)
+    {
+        const E &e = expr.self();
+        if (e.getRows() != _rows || e.getCols() != _cols)
+        {
+            throw MatrixSizeError(MAT_VIEW_SIZE_ERROR);
+        }
+        if (_rows == 0 || _cols == 0)
+        {
+            return *this;
+        }
+        if (e.aliases(_data, _data + (size_t) (_rows - 1) * _ld + _cols, _ld))
+        {
+            Matrix(e).assignTo(_data, _ld, 1);
+            return *this;
+        }
+        e.assignTo(_data, _ld, 1);
+        return *this;
+    }
+
+    /**
+     * adds an expression to the floats of the view, which has its size.
+     * @param expr the expression to add.
+     * @return a reference to this view.
+     */
+    template<class E>
+    BasicMatrixView &operator+=(const MatExpr<E> &expr)
+    {
+        const E &e = expr.self();
+        if (e.getRows() != _rows || e.getCols() != _cols)
+        {
+            throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_ADD_ERROR);
+        }
+        if (_rows == 0 || _cols == 0)
+        {
+            return *this;
+        }
+        if (e.aliases(_data, _data + (size_t) (_rows - 1) * _ld + _cols, _ld))
+        {
+            Matrix(e).addTo(_data, _ld, 1);
+            return *this;
+        }
+        e.addTo(_data, _ld, 1);
+        return *this;
+    }
+};
+
+#endif //MATRIXVIEW_H
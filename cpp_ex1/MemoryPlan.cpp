@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include "MemoryPlan.h"
+#include "Profile.h"
+
+/**
+ * rounds a number of floats up to the plan alignment.
+ * @param floats a number of floats.
+ * @return the first aligned number at or after it.
+ */
+static size_t _alignFloats(size_t floats)
+{
+    return (floats + PLAN_ALIGNMENT - 1) / PLAN_ALIGNMENT * PLAN_ALIGNMENT;
+}
+
+/**
+ * an empty plan.
+ */
+MemoryPlan :: MemoryPlan() : _floats(0)
+{
+}
+
+/**
+ * places the buffers, the largest first, each at the lowest offset that does not overlap a placed
+ * buffer live at the same time.
+ * @param buffers the buffers of the computation.
+ */
+MemoryPlan :: MemoryPlan(const std::vector<BufferLifetime> &buffers) : _offsets(buffers.size(), 0), _floats(0)
+{
+    std::vector<int> order(buffers.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = (int) i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buffers](int a, int b)
+    { return buffers[a].floats > buffers[b].floats; });
+
+    std::vector<int> placed;
+    for (int buffer : order)
+    {
+        const BufferLifetime &current = buffers[buffer];
+        const size_t floats = _alignFloats(current.floats);
+        // the ranges of the placed buffers live together with this one, by offset.
+        std::vector<std::pair<size_t, size_t>> taken;
+        for (int other : placed)
+        {
+            if (buffers[other].firstStep <= current.lastStep && current.firstStep <= buffers[other].lastStep)
+            {
+                taken.emplace_back(_offsets[other], _offsets[other] + _alignFloats(buffers[other].floats));
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+        size_t offset = 0;
+        for (const auto &range : taken)
+        {
+            if (offset + floats <= range.first)
+            {
+                break;
+            }
+            offset = std::max(offset, range.second);
+        }
+        _offsets[buffer] = offset;
+        _floats = std::max(_floats, offset + floats);
+        placed.push_back(buffer);
+    }
+}
+
+/**
+ * a getter for the place of a buffer.
+ * @param buffer the index of the buffer.
+ * @return the offset of the buffer in the arena, in floats.
+ */
+size_t MemoryPlan :: offset(int buffer) const
+{
+    return _offsets[buffer];
+}
+
+/**
+ * a getter for the size of the arena.
+ * @return the number of floats the plan needs.
+ */
+size_t MemoryPlan :: size() const
+{
+    return _floats;
+}
+
+/**
+ * allocates an aligned block of floats.
+ * @param floats the number of floats, a multiple of PLAN_ALIGNMENT.
+ * @return the block.
+ */
+static float *_allocBlock(size_t floats)
+{
+    auto *block = (float *) std::aligned_alloc(PLAN_ALIGNMENT * sizeof(float), floats * sizeof(float));
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    PROFILE_ALLOCATION(floats * sizeof(float));
+    return block;
+}
+
+/**
+ * the aligned arena of one thread, a stack of frames, freed when the thread exits.
+ */
+struct Arena
+{
+    float *data = nullptr;
+    size_t capacity = 0;
+    size_t top = 0;
+    size_t peak = 0;
+
+    /**
+     * frees the arena.
+     */
+    ~Arena()
+    {
+        std::free(data);
+    }
+};
+
+/**
+ * the arena of the calling thread.
+ * @return a reference to the arena.
+ */
+static Arena &_threadArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+/**
+ * takes a frame from the top of the arena (or from a block of its own while the arena is too small),
+ * throws std::bad_alloc if there is no memory for it.
+ * @param floats the number of floats of the frame.
+ */
+ArenaFrame :: ArenaFrame(size_t floats) : _data(nullptr), _floats(_alignFloats(floats)), _previousTop(0),
+                                          _ownBlock(false)
+{
+    Arena &arena = _threadArena();
+    _previousTop = arena.top;
+    arena.peak = std::max(arena.peak, arena.top + _floats);
+    if (arena.top == 0 && arena.peak > arena.capacity)
+    {
+        // the arena is empty, it grows to the deepest nesting of frames seen so far (and stays empty if that
+        // throws).
+        std::free(arena.data);
+        arena.data = nullptr;
+        arena.capacity = 0;
+        arena.data = _allocBlock(arena.peak);
+        arena.capacity = arena.peak;
+    }
+    if (arena.top + _floats > arena.capacity)
+    {
+        // the frames below still use the arena, it can only grow when they are gone.
+        _data = _allocBlock(_floats);
+        _ownBlock = true;
+        return;
+    }
+    _data = arena.data + arena.top;
+    arena.top += _floats;
+}
+
+/**
+ * gives the frame back to the arena.
+ */
+ArenaFrame :: ~ArenaFrame()
+{
+    if (_ownBlock)
+    {
+        std::free(_data);
+        return;
+    }
+    _threadArena().top = _previousTop;
+}
+
+/**
+ * a getter for the memory of the frame, 64 byte aligned, its contents are undefined.
+ * @return the first float of the frame.
+ */
+float *ArenaFrame :: data() const
+{
+    return _data;
+}
@@ -0,0 +1,101 @@
+// MemoryPlan.h
+
+#ifndef MEMORYPLAN_H
+#define MEMORYPLAN_H
+
+#include <cstddef>
+#include <vector>
+
+// every planned buffer starts at a multiple of this many floats (64 bytes) from the start of the arena.
+#define PLAN_ALIGNMENT 16
+
+/**
+ * @struct BufferLifetime
+ * @brief an intermediate buffer of a computation: its size and the steps it is live in (written in
+ *        firstStep, read for the last time in lastStep).
+ */
+typedef struct BufferLifetime
+{
+    size_t floats;
+    int firstStep;
+    int lastStep;
+
+} BufferLifetime;
+
+/**
+ * a layout of the intermediate buffers of a computation in one arena. buffers whose lifetimes overlap get
+ * disjoint ranges, the others may share memory. the plan is made once, from the shapes alone.
+ */
+class MemoryPlan
+{
+private:
+    std::vector<size_t> _offsets;
+    size_t _floats;
+
+public:
+
+    /**
+     * an empty plan.
+     */
+    MemoryPlan();
+
+    /**
+     * places the buffers, the largest first, each at the lowest offset that does not overlap a placed
+     * buffer live at the same time.
+     * @param buffers the buffers of the computation.
+     */
+    explicit MemoryPlan(const std::vector<BufferLifetime> &buffers);
+
+    /**
+     * a getter for the place of a buffer.
+     * @param buffer the index of the buffer.
+     * @return the offset of the buffer in the arena, in floats.
+     */
+    size_t offset(int buffer) const;
+
+    /**
+     * a getter for the size of the arena.
+     * @return the number of floats the plan needs.
+     */
+    size_t size() const;
+};
+
+/**
+ * a frame of the calling thread's arena, released when it goes out of scope. frames are a stack, so a
+ * computation nested in another on the same thread (a task run while waiting for a parallel loop) gets
+ * memory past its caller's. the arena grows to the deepest stack seen once it is empty again, so a steady
+ * state computation does not allocate.
+ */
+class ArenaFrame
+{
+private:
+    float *_data;
+    size_t _floats;
+    size_t _previousTop;
+    bool _ownBlock;
+
+public:
+
+    /**
+     * takes a frame from the top of the arena (or from a block of its own while the arena is too small),
+     * throws std::bad_alloc if there is no memory for it.
+     * @param floats the number of floats of the frame.
+     */
+    explicit ArenaFrame(size_t floats);
+
+    /**
+     * gives the frame back to the arena.
+     */
+    ~ArenaFrame();
+
+    ArenaFrame(const ArenaFrame &) = delete;
+    ArenaFrame &operator=(const ArenaFrame &) = delete;
+
+    /**
+     * a getter for the memory of the frame, 64 byte aligned, its contents are undefined.
+     * @return the first float of the frame.
+     */
+    float *data() const;
+};
+
+#endif //MEMORYPLAN_H
@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Activation.h"
+#include "Bench.h"
+#include "Gemm.h"
+#include "MlpNetwork.h"
+#include "QuantizedMlpNetwork.h"
+#include "SparseDense.h"
+#include "StaticMlp.h"
+#include "TestData.h"
+
+#define BENCH_USAGE_ERROR "Usage: mlpbench [--samples n] [--json file]"
+#define BENCH_JSON_ERROR "Error: cant write the json report"
+
+// the number of images the networks are compared on.
+#define BENCH_IMAGES 2000
+// the number of images of a batch in the throughput cases.
+#define BENCH_BATCH 256
+// the shares of the weights of the first layer pruned in the sparse cases.
+#define BENCH_SPARSITIES {0.8f, 0.95f}
+// the size of the square products the Strassen product is timed on.
+#define BENCH_STRASSEN_N 1536
+// the rows of those products checked against a double precision product.
+#define BENCH_STRASSEN_ROWS 16
+
+typedef StaticMlp<784, 128, 64, 20, 10> DigitMlp;
+
+/**
+ * times the products of matrices of a shape.
+ * @param suite the suite.
+ * @param gen the random generator.
+ * @param m the rows of the left matrix.
+ * @param k the cols of the left matrix.
+ * @param n the cols of the right matrix.
+ */
+static void _benchProduct(BenchSuite &suite, std::mt19937 &gen, int m, int k, int n)
+{
+    Matrix a(m, k), b(k, n), c(m, n);
+    fillNormal(a, gen, 1);
+    fillNormal(b, gen, 1);
+    const std::string name = "matrix product " + std::to_string(m) + "x" + std::to_string(k) + " * " +
+                             std::to_string(k) + "x" + std::to_string(n);
+    suite.run(name, 2.0 * m * k * n, 0, [&]()
+    {
+        c = a * b;
+        benchKeep(c.data());
+    });
+}
+
+/**
+ * the largest error of the given rows of a product against a double precision product.
+ * @param a the left matrix.
+ * @param b the right matrix.
+ * @param c the product of a and b.
+ * @param step the distance between two checked rows.
+ * @return the largest absolute error.
+ */
+static double _productError(const Matrix &a, const Matrix &b, const Matrix &c, int step)
+{
+    std::vector<double> exact(b.getCols());
+    double error = 0;
+    for (int i = 0; i < a.getRows(); i += step)
+    {
+        std::fill(exact.begin(), exact.end(), 0.0);
+        for (int p = 0; p < a.getCols(); ++p)
+        {
+            for (int j = 0; j < b.getCols(); ++j)
+            {
+                exact[j] += (double) a(i, p) * b(p, j);
+            }
+        }
+        for (int j = 0; j < b.getCols(); ++j)
+        {
+            error = std::max(error, std::fabs(exact[j] - c(i, j)));
+        }
+    }
+    return error;
+}
+
+/**
+ * times a large square product the classic way and with Strassen-Winograd, and prints the error of both
+ * against a double precision product (matrixtest checks the Strassen error).
+ * @param suite the suite.
+ * @param gen the random generator.
+ */
+static void _benchStrassen(BenchSuite &suite, std::mt19937 &gen)
+{
+    const int n = BENCH_STRASSEN_N;
+    Matrix a(n, n), b(n, n), classic(n, n), strassen(n, n);
+    fillNormal(a, gen, 1);
+    fillNormal(b, gen, 1);
+    const std::string shape = std::to_string(n) + "x" + std::to_string(n);
+    setGemmStrassenSize(0);
+    suite.run("classic product " + shape, 2.0 * n * n * n, 0, [&]()
+    {
+        classic = a * b;
+        benchKeep(classic.data());
+    });
+    setGemmStrassenSize(n);
+    suite.run("strassen product " + shape, 2.0 * n * n * n, 0, [&]()
+    {
+        strassen = a * b;
+        benchKeep(strassen.data());
+    });
+    setGemmStrassenSize(GEMM_STRASSEN_SIZE);
+    std::printf("%dx%d product error: classic %.3g, strassen %.3g\n\n", n, n,
+                _productError(a, b, classic, n / BENCH_STRASSEN_ROWS),
+                _productError(a, b, strassen, n / BENCH_STRASSEN_ROWS));
+}
+
+/**
+ * times the element-wise operations of Matrix and the activations.
+ * @param suite the suite.
+ * @param gen the random generator.
+ */
+static void _benchElementwise(BenchSuite &suite, std::mt19937 &gen)
+{
+    Matrix a(784, BENCH_BATCH), b(784, BENCH_BATCH), c(784, BENCH_BATCH);
+    fillNormal(a, gen, 1);
+    fillNormal(b, gen, 1);
+    const double size = 784.0 * BENCH_BATCH;
+    suite.run("matrix += 784x256", size, 0, [&]()
+    {
+        a += b;
+        benchKeep(a.data());
+    });
+    suite.run("matrix scale 784x256", size, 0, [&]()
+    {
+        c = 2 * b;
+        benchKeep(c.data());
+    });
+
+    Matrix hidden(128, 1), logits(10, 1), batchLogits(10, BENCH_BATCH);
+    fillNormal(hidden, gen, 1);
+    fillNormal(logits, gen, 1);
+    fillNormal(batchLogits, gen, 1);
+    const Activation relu(Relu), softmax(Softmax);
+    suite.run("relu 128", 128, 1, [&]()
+    {
+        relu.activate(hidden.data(), 128);
+        benchKeep(hidden.data());
+    });
+    suite.run("softmax 10", 0, 1, [&]()
+    {
+        softmax.activate(logits.data(), 10);
+        benchKeep(logits.data());
+    });
+    suite.run("softmax columns 10x256", 0, BENCH_BATCH, [&]()
+    {
+        softmax.activateColumns(batchLogits.data(), 10, BENCH_BATCH);
+        benchKeep(batchLogits.data());
+    });
+}
+
+/**
+ * times a dense layer and the networks, on one image and on batches.
+ * @param suite the suite.
+ * @param gen the random generator.
+ * @param network the float network.
+ * @param staticMlp the compile time network of the same weights.
+ */
+static void _benchNetworks(BenchSuite &suite, std::mt19937 &gen, const MlpNetwork &network,
+                           const DigitMlp &staticMlp)
+{
+    double networkFlops = 0;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        networkFlops += 2.0 * weightsDims[i].rows * weightsDims[i].cols;
+    }
+    const Dense &first = network.getLayer(0);
+    Matrix image(imgDims.rows * imgDims.cols, 1), fullImage(imgDims.rows * imgDims.cols, 1);
+    Matrix batch(imgDims.rows * imgDims.cols, BENCH_BATCH);
+    fillImages(image, gen);
+    fillNormal(fullImage, gen, 1);
+    fillImages(batch, gen);
+    std::vector<float> out(first.getRows());
+    const double layerFlops = 2.0 * first.getRows() * first.getCols();
+    suite.run("dense forward 784x128", layerFlops, 1, [&]()
+    {
+        first.forward(fullImage.data(), out.data());
+        benchKeep(out.data());
+    });
+    suite.run("dense forward 784x128 (image)", layerFlops, 1, [&]()
+    {
+        first.forward(image.data(), out.data());
+        benchKeep(out.data());
+    });
+
+    unsigned int sink = 0;
+    suite.run("MlpNetwork latency", networkFlops, 1, [&]()
+    {
+        sink += network(image).value;
+    });
+    suite.run("MlpNetwork throughput (batch 256)", networkFlops * BENCH_BATCH, BENCH_BATCH, [&]()
+    {
+        sink += network.predictBatch(batch)[0].value;
+    });
+    suite.run("StaticMlp latency", networkFlops, 1, [&]()
+    {
+        sink += staticMlp(image.data()).value;
+    });
+    // the same on an input without blank pixels, where neither network can skip columns of its weights.
+    suite.run("MlpNetwork latency (dense input)", networkFlops, 1, [&]()
+    {
+        sink += network(fullImage).value;
+    });
+    suite.run("StaticMlp latency (dense input)", networkFlops, 1, [&]()
+    {
+        sink += staticMlp(fullImage.data()).value;
+    });
+    benchKeep(&sink);
+}
+
+/**
+ * prunes a weight matrix by magnitude: the groups of weights with the smallest sum of squares are set to 0,
+ * a group is groupRows rows of one column (1 for single weights, SIMD_PANEL_ROWS for the blocks of a panel).
+ * @param w the weights, rows a multiple of groupRows.
+ * @param sparsity the share of the groups set to 0.
+ * @param groupRows the number of rows of a group.
+ */
+static void _prune(Matrix &w, float sparsity, int groupRows)
+{
+    const int groupsPerCol = w.getRows() / groupRows;
+    std::vector<float> scores((size_t) groupsPerCol * w.getCols());
+    for (int g = 0; g < groupsPerCol; ++g)
+    {
+        for (int k = 0; k < w.getCols(); ++k)
+        {
+            float score = 0;
+            for (int r = g * groupRows; r < (g + 1) * groupRows; ++r)
+            {
+                score += w(r, k) * w(r, k);
+            }
+            scores[(size_t) g * w.getCols() + k] = score;
+        }
+    }
+    std::vector<float> sorted(scores);
+    const size_t pruned = (size_t) (sparsity * (float) sorted.size());
+    std::nth_element(sorted.begin(), sorted.begin() + pruned, sorted.end());
+    const float threshold = sorted[pruned];
+    for (int g = 0; g < groupsPerCol; ++g)
+    {
+        for (int k = 0; k < w.getCols(); ++k)
+        {
+            if (scores[(size_t) g * w.getCols() + k] < threshold)
+            {
+                for (int r = g * groupRows; r < (g + 1) * groupRows; ++r)
+                {
+                    w(r, k) = 0;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * times the first layer pruned to every share of BENCH_SPARSITIES, on an image: the dense forward of the
+ * pruned weights, CSC and blocks on weights pruned one by one, and blocks on weights pruned a block at a time.
+ * prints the density each format stores and the format SparseDense::convert picks.
+ * @param suite the suite.
+ * @param gen the random generator.
+ * @param network the float network, its first layer is pruned in copies.
+ */
+static void _benchSparse(BenchSuite &suite, std::mt19937 &gen, const MlpNetwork &network)
+{
+    const Dense &first = network.getLayer(0);
+    const double layerFlops = 2.0 * first.getRows() * first.getCols();
+    Matrix image(imgDims.rows * imgDims.cols, 1);
+    fillImages(image, gen);
+    std::vector<float> out(first.getRows());
+    for (const float sparsity : BENCH_SPARSITIES)
+    {
+        const std::string percent = std::to_string((int) std::lround(100 * sparsity)) + "%";
+        Matrix single = first.getWeights(), blocked = first.getWeights();
+        _prune(single, sparsity, 1);
+        _prune(blocked, sparsity, SIMD_PANEL_ROWS);
+        const Dense dense(single, first.getBias(), Relu), denseBlocked(blocked, first.getBias(), Relu);
+        const SparseDense csc(dense, SparseCsc), blocks(dense, SparseBlocks);
+        const SparseDense blocksBlocked(denseBlocked, SparseBlocks);
+        const std::shared_ptr<const SparseDense> picked = SparseDense::convert(dense);
+        const std::shared_ptr<const SparseDense> pickedBlocked = SparseDense::convert(denseBlocked);
+        std::printf("first layer %s pruned: csc stores %.1f%%, blocks %.1f%% (block pruned %.1f%%), convert picks "
+                    "%s (block pruned %s)\n", percent.c_str(), 100.0 * csc.density(), 100.0 * blocks.density(),
+                    100.0 * blocksBlocked.density(),
+                    !picked ? "dense" : (picked->getFormat() == SparseCsc ? "csc" : "blocks"),
+                    !pickedBlocked ? "dense" : (pickedBlocked->getFormat() == SparseCsc ? "csc" : "blocks"));
+
+        suite.run("dense 784x128, " + percent + " pruned", layerFlops, 1, [&]()
+        {
+            dense.forward(image.data(), out.data());
+            benchKeep(out.data());
+        });
+        suite.run("csc 784x128, " + percent + " pruned", csc.flops(1), 1, [&]()
+        {
+            csc.forward(image.data(), out.data());
+            benchKeep(out.data());
+        });
+        suite.run("blocks 784x128, " + percent + " pruned", blocks.flops(1), 1, [&]()
+        {
+            blocks.forward(image.data(), out.data());
+            benchKeep(out.data());
+        });
+        suite.run("blocks 784x128, " + percent + " block pruned", blocksBlocked.flops(1), 1, [&]()
+        {
+            blocksBlocked.forward(image.data(), out.data());
+            benchKeep(out.data());
+        });
+    }
+    std::printf("\n");
+}
+
+/**
+ * compares the int8 network to the float network it was quantized from: prints how often they agree on the
+ * digit, the difference of their probabilities and the size of their weights, and times the int8 latency
+ * next to the float one.
+ * @param suite the suite.
+ * @param gen the random generator.
+ * @param network the float network.
+ */
+static void _benchQuantized(BenchSuite &suite, std::mt19937 &gen, const MlpNetwork &network)
+{
+    const QuantizedMlpNetwork quantized(network);
+    std::vector<Matrix> images(BENCH_IMAGES, Matrix(imgDims.rows * imgDims.cols, 1));
+    for (Matrix &image : images)
+    {
+        fillImages(image, gen);
+    }
+    const QuantizationReport report = compareQuantization(network, quantized, images.data(), BENCH_IMAGES);
+    std::printf("int8 agrees with float on %d/%d images (%.2f%%), probability delta mean %.2e max %.2e, "
+                "weights %zu -> %zu bytes (%.2fx)\n\n", report.agreements, report.images,
+                100.0 * report.agreementRate, report.meanProbabilityDelta, report.maxProbabilityDelta,
+                report.floatWeightBytes, report.quantizedWeightBytes,
+                (double) report.floatWeightBytes / (double) report.quantizedWeightBytes);
+
+    double networkFlops = 0;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        networkFlops += 2.0 * weightsDims[i].rows * weightsDims[i].cols;
+    }
+    const Matrix &image = images[0];
+    unsigned int sink = 0;
+    suite.run("MlpNetwork latency (float32)", networkFlops, 1, [&]()
+    {
+        sink += network(image).value;
+    });
+    suite.run("QuantizedMlpNetwork latency (int8)", networkFlops, 1, [&]()
+    {
+        sink += quantized(image).value;
+    });
+    benchKeep(&sink);
+}
+
+/**
+ * runs the benchmark suite on random weights and images, and prints a table (and a JSON report).
+ * @param argc the number of arguments.
+ * @param argv the arguments: --samples n for the samples of a case, --json file for the report.
+ * @return 0.
+ */
+int main(int argc, char *argv[])
+{
+    int samples = BENCH_SAMPLES;
+    const char *jsonPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+        {
+            samples = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else
+        {
+            std::cerr << BENCH_USAGE_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::mt19937 gen(1);
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+        biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+        fillNormal(weights[i], gen, 0.1f);
+        fillNormal(biases[i], gen, 0.1f);
+    }
+    const MlpNetwork network(weights, biases);
+    const auto staticMlp = std::make_unique<DigitMlp>(network);
+
+    // the networks classify alike, or their times are not comparable.
+    Matrix image(imgDims.rows * imgDims.cols, 1);
+    int agree = 0;
+    for (int j = 0; j < BENCH_IMAGES; ++j)
+    {
+        fillImages(image, gen);
+        agree += network(image).value == (*staticMlp)(image).value;
+    }
+    std::printf("isa %s, StaticMlp agrees with MlpNetwork on %d/%d images\n\n", simdKernels().isa, agree,
+                BENCH_IMAGES);
+
+    BenchSuite suite(samples);
+    _benchProduct(suite, gen, 128, 784, 1);
+    _benchProduct(suite, gen, 128, 784, 64);
+    _benchProduct(suite, gen, 256, 256, 256);
+    _benchProduct(suite, gen, 512, 512, 512);
+    _benchStrassen(suite, gen);
+    _benchElementwise(suite, gen);
+    _benchNetworks(suite, gen, network, *staticMlp);
+    _benchQuantized(suite, gen, network);
+    _benchSparse(suite, gen, network);
+    suite.printTable(std::cout);
+
+    if (jsonPath != nullptr)
+    {
+        std::ofstream json(jsonPath);
+        suite.writeJson(json);
+        if (!json)
+        {
+            std::cerr << BENCH_JSON_ERROR << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
@@ -1,42 +1,407 @@
+#include <algorithm>
 #include "Matrix.h"
 #include "MlpNetwork.h"
 #include "Digit.h"
+#include "ImageStream.h"
+#include "Profile.h"
 
 /**
  * a constructor for the mlpnetwork class.
+ * @param precision the format to store the weights of every layer in.
  */
-MlpNetwork :: MlpNetwork(Matrix weights[], Matrix biases[]): denseArr
+MlpNetwork :: MlpNetwork(Matrix weights[], Matrix biases[], WeightPrecision precision): denseArr
 {
-    Dense(weights[0], biases[0], Relu), Dense(weights[1], biases[1], Relu),
-    Dense(weights[2], biases[2], Relu), Dense(weights[3], biases[3], Softmax)
+    Dense(weights[0], biases[0], Relu, precision), Dense(weights[1], biases[1], Relu, precision),
+    Dense(weights[2], biases[2], Relu, precision), Dense(weights[3], biases[3], Softmax, precision)
 }
 
 {
+    _planMemory();
+}
+
+/**
+ * plans the arena from the sizes of the layers. the output of a layer is live from its layer to the next,
+ * so the outputs alternate between (at most) two places.
+ */
+void MlpNetwork :: _planMemory()
+{
+    // step i runs layer i, step MLP_SIZE reads the probabilities.
+    std::vector<BufferLifetime> outputs, packed;
+    packed.push_back(BufferLifetime{(size_t) denseArr[0].getCols(), 0, 1});
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        outputs.push_back(BufferLifetime{(size_t) denseArr[i].getRows(), i, i + 1});
+        packed.push_back(BufferLifetime{(size_t) denseArr[i].getRows(), i + 1, i + 2});
+    }
+    plan = MemoryPlan(outputs);
+    packedPlan = MemoryPlan(packed);
+}
+
+/**
+ * activates a layer on one input, in its sparse form if it has one.
+ * @param layer the index of the layer.
+ * @param input the input vector.
+ * @param output the output vector.
+ */
+void MlpNetwork :: _forwardLayer(int layer, const float *input, float *output) const
+{
+    PROFILE_SCOPE(ProfileImage, layer, _layerFlops(layer, 1), _layerBytes(layer, 1));
+    if (sparseArr[layer] != nullptr)
+    {
+        sparseArr[layer]->forward(input, output);
+        return;
+    }
+    denseArr[layer].forward(input, output);
+}
+
+/**
+ * the work of a layer for the profile, in the form it runs in.
+ * @param layer the index of the layer, or PROFILE_NETWORK for all of them.
+ * @param batch the number of inputs.
+ * @return the floating point operations of the layer.
+ */
+double MlpNetwork :: _layerFlops(int layer, int batch) const
+{
+    if (layer == PROFILE_NETWORK)
+    {
+        double flops = 0;
+        for (int i = 0; i < MLP_SIZE; ++i)
+        {
+            flops += _layerFlops(i, batch);
+        }
+        return flops;
+    }
+    return (sparseArr[layer] != nullptr) ? sparseArr[layer]->flops(batch) : denseArr[layer].flops(batch);
+}
+
+/**
+ * the memory traffic of a layer for the profile: its weights and bias, its inputs and its outputs.
+ * @param layer the index of the layer, or PROFILE_NETWORK for all of them.
+ * @param batch the number of inputs.
+ * @return the bytes the layer reads and writes.
+ */
+double MlpNetwork :: _layerBytes(int layer, int batch) const
+{
+    if (layer == PROFILE_NETWORK)
+    {
+        double bytes = 0;
+        for (int i = 0; i < MLP_SIZE; ++i)
+        {
+            bytes += _layerBytes(i, batch);
+        }
+        return bytes;
+    }
+    const Dense &dense = denseArr[layer];
+    const double weights = (sparseArr[layer] != nullptr) ? (double) sparseArr[layer]->weightBytes()
+                                                         : (double) dense.weightBytes();
+    return weights + (double) (dense.getRows() * (batch + 1) + dense.getCols() * batch) * sizeof(float);
+}
+
+/**
+ * activates a layer on a batch of inputs, in its sparse form if it has one.
+ * @param layer the index of the layer.
+ * @param input the inputs, one per column.
+ * @param output the outputs, one per column.
+ */
+void MlpNetwork :: _forwardLayerBatch(int layer, ConstMatrixView input, MatrixView output) const
+{
+    PROFILE_SCOPE(ProfileBatch, layer, _layerFlops(layer, input.getCols()), _layerBytes(layer, input.getCols()));
+    if (sparseArr[layer] != nullptr)
+    {
+        sparseArr[layer]->forwardBatch(input, output);
+        return;
+    }
+    denseArr[layer].forwardBatch(input, output);
+}
+
+/**
+ * checks that a mapped model file has the layers of the network.
+ * @param model the mapped file.
+ * @return the mapped file.
+ */
+static const std::shared_ptr<const MappedModel> &_checkModel(const std::shared_ptr<const MappedModel> &model)
+{
+    if (model->getLayerCount() != MLP_SIZE)
+    {
+        throw MatrixFileError(BAD_MODEL_ERROR);
+    }
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        if (model->getWeights(i).getRows() != weightsDims[i].rows ||
+            model->getWeights(i).getCols() != weightsDims[i].cols)
+        {
+            throw MatrixFileError(BAD_MODEL_ERROR);
+        }
+    }
+    return model;
+}
+
+/**
+ * a constructor using the weights of a mapped model file in place, without copying them.
+ * the network keeps the mapping alive.
+ * @param mappedModel a mapped file of MLP_SIZE layers with the sizes of weightsDims.
+ */
+MlpNetwork :: MlpNetwork(const std::shared_ptr<const MappedModel> &mappedModel): denseArr
+{
+    Dense(_checkModel(mappedModel)->getWeights(0), mappedModel->getBias(0), mappedModel->getActivationType(0)),
+    Dense(mappedModel->getWeights(1), mappedModel->getBias(1), mappedModel->getActivationType(1)),
+    Dense(mappedModel->getWeights(2), mappedModel->getBias(2), mappedModel->getActivationType(2)),
+    Dense(mappedModel->getWeights(3), mappedModel->getBias(3), mappedModel->getActivationType(3))
+}, model(mappedModel)
+{
+    _planMemory();
+}
+
+/**
+ * converts the layers of a pruned network to sparse layers, SparseDense::convert picks dense or a sparse
+ * format per layer from the measured density of its weights. the dense layers stay the reference
+ * (getLayer, save), the sparse ones only replace them at inference time.
+ * @return the number of layers that run sparse.
+ */
+int MlpNetwork :: sparsify()
+{
+    int sparse = 0;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        sparseArr[i] = SparseDense::convert(denseArr[i]);
+        sparse += sparseArr[i] != nullptr;
+    }
+    return sparse;
+}
+
+/**
+ * a getter for the sparse form of a layer.
+ * @param index the index of the layer, 0 is the input layer.
+ * @return the sparse layer, or nullptr when the layer runs dense.
+ */
+const SparseDense *MlpNetwork :: getSparseLayer(int index) const
+{
+    if (index < 0 || index >= MLP_SIZE)
+    {
+        throw MatrixIndexError();
+    }
+    return sparseArr[index].get();
+}
+
+/**
+ * writes the network in the model file format, for the mapping constructor.
+ * @param path the path of the file.
+ */
+void MlpNetwork :: save(const std::string &path) const
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    ActivationType activations[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = denseArr[i].getWeights();
+        biases[i] = denseArr[i].getBias();
+        activations[i] = denseArr[i].getActivation().getActivationType();
+    }
+    saveModel(path, weights, biases, activations, MLP_SIZE);
 }
 
 /**
  * an override method for the operator (), activating a mlpnetwork on a given image.
+ * the network is not changed, so one network may classify images from several threads at once.
  * @param img a matrix representing the image.
  * @return a digit which the mlp discovered from the image.
  */
-Digit MlpNetwork :: operator()(Matrix &img)
+Digit MlpNetwork :: operator()(const Matrix &img) const
 {
-    Matrix r1 = img;
-    for (const auto & i : denseArr)
+    if (img.getRows() * img.getCols() != denseArr[0].getCols())
     {
-        // maybe del.
-        r1 = i.getActivation()(((i.getWeights() * r1) + i.getBias()));
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    if (!img.isPacked())
+    {
+        // the layers read the image as one vector.
+        return (*this)(Matrix(img, packedLayout));
+    }
+    PROFILE_SCOPE(ProfileImage, PROFILE_NETWORK, _layerFlops(PROFILE_NETWORK, 1), _layerBytes(PROFILE_NETWORK, 1));
+    // every layer writes its planned place in the thread's arena, nothing is allocated.
+    ArenaFrame frame(plan.size());
+    float *arena = frame.data();
+    const float *in = img.data();
+    float *out = nullptr;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        out = arena + plan.offset(i);
+        _forwardLayer(i, in, out);
+        in = out;
     }
     int index = 0;
-    for (int i = 0; i < r1.getRows(); ++i)
+    for (int i = 0; i < denseArr[MLP_SIZE - 1].getRows(); ++i)
     {
-        if (r1[i] > r1[index])
+        if (out[i] > out[index])
         {
             index = i;
         }
     }
     Digit num = Digit();
     num.value = index;
-    num.probability = r1[index];
+    num.probability = out[index];
     return num;
 }
+
+/**
+ * a getter for one of the layers of the network.
+ * @param index the index of the layer, 0 is the input layer.
+ * @return a reference to the layer.
+ */
+const Dense &MlpNetwork :: getLayer(int index) const
+{
+    if (index < 0 || index >= MLP_SIZE)
+    {
+        throw MatrixIndexError();
+    }
+    return denseArr[index];
+}
+
+/**
+ * activates the mlpnetwork on a batch of images at once, every layer is one matrix-matrix product
+ * over the whole batch, so the weights are read once per batch instead of once per image.
+ * @param images a 784 x N matrix (or a view of some of its columns), one vectorized image per column.
+ * @return the N digits, in the order of the columns.
+ */
+std::vector<Digit> MlpNetwork :: predictBatch(ConstMatrixView images) const
+{
+    ArenaFrame frame(plan.size() * images.getCols());
+    return _predictColumns(images, plan, 0, frame.data());
+}
+
+/**
+ * activates the layers on a batch whose outputs are placed in the arena according to a plan.
+ * @param images the batch, one vectorized image per column.
+ * @param memoryPlan the plan of the arena.
+ * @param firstOutput the index of the output of the first layer in the plan.
+ * @param arena the arena, memoryPlan.size() floats per image.
+ * @return the N digits, in the order of the columns.
+ */
+std::vector<Digit> MlpNetwork :: _predictColumns(ConstMatrixView images, const MemoryPlan &memoryPlan,
+                                                 int firstOutput, float *arena) const
+{
+    const int batch = images.getCols();
+    if (images.getRows() != denseArr[0].getCols())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    PROFILE_SCOPE(ProfileBatch, PROFILE_NETWORK, _layerFlops(PROFILE_NETWORK, batch),
+                  _layerBytes(PROFILE_NETWORK, batch));
+    // every layer writes its planned place in the arena, one column per image. the images are read in place.
+    const float *p = images.data();
+    int ld = images.getLd();
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        float *out = arena + memoryPlan.offset(firstOutput + i) * batch;
+        _forwardLayerBatch(i, ConstMatrixView(p, denseArr[i].getCols(), batch, ld),
+                           MatrixView(out, denseArr[i].getRows(), batch, batch));
+        p = out;
+        ld = batch;
+    }
+    const int classes = denseArr[MLP_SIZE - 1].getRows();
+    std::vector<Digit> digits(batch);
+    for (int j = 0; j < batch; ++j)
+    {
+        int index = 0;
+        for (int i = 0; i < classes; ++i)
+        {
+            if (p[i * batch + j] > p[index * batch + j])
+            {
+                index = i;
+            }
+        }
+        digits[j].value = index;
+        digits[j].probability = p[index * batch + j];
+    }
+    return digits;
+}
+
+/**
+ * activates the mlpnetwork on an array of images at once, the images are packed into the columns
+ * of a single batch matrix.
+ * @param images an array of n images (28x28 or already vectorized).
+ * @param n the number of images.
+ * @return the n digits, in the order of the images.
+ */
+std::vector<Digit> MlpNetwork :: predictBatch(const Matrix images[], int n) const
+{
+    const int size = denseArr[0].getCols();
+    ArenaFrame frame(packedPlan.size() * n);
+    float *arena = frame.data();
+    MatrixView batch(arena + packedPlan.offset(0) * n, size, n, n);
+    float *dst = batch.data();
+    for (int j = 0; j < n; ++j)
+    {
+        if (images[j].getRows() * images[j].getCols() != size)
+        {
+            throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+        }
+        const float *src = images[j].data();
+        const int cols = images[j].getCols(), ld = images[j].getLd();
+        for (int r = 0, i = 0; r < images[j].getRows(); ++r)
+        {
+            for (int c = 0; c < cols; ++c, ++i)
+            {
+                dst[i * n + j] = src[r * ld + c];
+            }
+        }
+    }
+    return _predictColumns(batch, packedPlan, 1, arena);
+}
+
+/**
+ * activates the mlpnetwork on an array of images, spread in tiles over the workers of a thread pool.
+ * every tile is classified as one batch.
+ * @param images an array of n images (28x28 or already vectorized).
+ * @param n the number of images.
+ * @param pool the pool to run the tiles on.
+ * @param tileSize the number of images in a tile.
+ * @return the n digits, in the order of the images.
+ */
+std::vector<Digit> MlpNetwork :: predictParallel(const Matrix images[], int n, ThreadPool &pool,
+                                                 int tileSize) const
+{
+    std::vector<Digit> digits(n);
+    pool.parallelFor(0, n, tileSize, [&](int first, int last)
+    {
+        std::vector<Digit> tile = predictBatch(images + first, last - first);
+        std::copy(tile.begin(), tile.end(), digits.begin() + first);
+    });
+    return digits;
+}
+
+/**
+ * activates the mlpnetwork on a batch of images, spread in tiles of its columns over the workers of a thread
+ * pool. a tile is a view of the batch, its images are not copied.
+ * @param images a 784 x N matrix (or a view), one vectorized image per column.
+ * @param pool the pool to run the tiles on.
+ * @param tileSize the number of images in a tile.
+ * @return the N digits, in the order of the columns.
+ */
+std::vector<Digit> MlpNetwork :: predictParallel(ConstMatrixView images, ThreadPool &pool, int tileSize) const
+{
+    std::vector<Digit> digits(images.getCols());
+    pool.parallelFor(0, images.getCols(), tileSize, [&](int first, int last)
+    {
+        std::vector<Digit> tile = predictBatch(images.colRange(first, last - first));
+        std::copy(tile.begin(), tile.end(), digits.begin() + first);
+    });
+    return digits;
+}
+
+/**
+ * activates the mlpnetwork on every image of a stream, one batch at a time, while the stream reads
+ * the next batches in the background. throws the error of the stream (see ImageStream::next).
+ * @param stream the stream of images.
+ * @return the digits, in the order of the images in the stream.
+ */
+std::vector<Digit> MlpNetwork :: predictStream(ImageStream &stream) const
+{
+    std::vector<Digit> digits;
+    for (const Matrix *batch = stream.next(); batch != nullptr; batch = stream.next())
+    {
+        std::vector<Digit> batchDigits = predictBatch(*batch);
+        digits.insert(digits.end(), batchDigits.begin(), batchDigits.end());
+    }
+    return digits;
+}
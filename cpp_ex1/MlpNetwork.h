@@ -6,8 +6,19 @@
 #include "Dense.h"
 #include "Matrix.h"
 #include "Digit.h"
+#include "ThreadPool.h"
+#include "ModelFile.h"
+#include "MemoryPlan.h"
+#include "SparseDense.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 #define MLP_SIZE 4
+// the number of images a worker classifies as one batch in predictParallel.
+#define MLP_TILE_SIZE 64
+
+class ImageStream;
 
 const MatrixDims imgDims = {28, 28};
 const MatrixDims weightsDims[] = {{128, 784}, {64, 128}, {20, 64}, {10, 20}};
@@ -21,19 +32,158 @@ class MlpNetwork
 private:
 
     Dense denseArr[MLP_SIZE];
+    // the sparse form of the layers sparsify found sparse enough, nullptr for the dense ones.
+    std::shared_ptr<const SparseDense> sparseArr[MLP_SIZE];
+    // the mapped file the layers borrow their weights from, if any.
+    std::shared_ptr<const MappedModel> model;
+    // the places of the layer outputs (per image) in the thread's arena, without and with a packed input.
+    MemoryPlan plan, packedPlan;
+
+    /**
+     * plans the arena from the sizes of the layers. the output of a layer is live from its layer to the next,
+     * so the outputs alternate between (at most) two places.
+     */
+    void _planMemory();
+
+    /**
+     * activates a layer on one input, in its sparse form if it has one.
+     * @param layer the index of the layer.
+     * @param input the input vector.
+     * @param output the output vector.
+     */
+    void _forwardLayer(int layer, const float *input, float *output) const;
+
+    /**
+     * the work of a layer for the profile, in the form it runs in.
+     * @param layer the index of the layer, or PROFILE_NETWORK for all of them.
+     * @param batch the number of inputs.
+     * @return the floating point operations of the layer.
+     */
+    double _layerFlops(int layer, int batch) const;
+
+    /**
+     * the memory traffic of a layer for the profile: its weights and bias, its inputs and its outputs.
+     * @param layer the index of the layer, or PROFILE_NETWORK for all of them.
+     * @param batch the number of inputs.
+     * @return the bytes the layer reads and writes.
+     */
+    double _layerBytes(int layer, int batch) const;
+
+    /**
+     * activates a layer on a batch of inputs, in its sparse form if it has one.
+     * @param layer the index of the layer.
+     * @param input the inputs, one per column.
+     * @param output the outputs, one per column.
+     */
+    void _forwardLayerBatch(int layer, ConstMatrixView input, MatrixView output) const;
+
+    /**
+     * activates the layers on a batch whose outputs are placed in the arena according to a plan.
+     * @param images the batch, one vectorized image per column.
+     * @param memoryPlan the plan of the arena.
+     * @param firstOutput the index of the output of the first layer in the plan.
+     * @param arena the arena, memoryPlan.size() floats per image.
+     * @return the N digits, in the order of the columns.
+     */
+    std::vector<Digit> _predictColumns(ConstMatrixView images, const MemoryPlan &memoryPlan, int firstOutput,
+                                       float *arena) const;
 public:
 
     /**
      * a constructor for the mlpnetwork class.
+     * @param precision the format to store the weights of every layer in.
+     */
+    MlpNetwork(Matrix weights[], Matrix biases[], WeightPrecision precision = Float32);
+
+    /**
+     * a constructor using the weights of a mapped model file in place, without copying them.
+     * the network keeps the mapping alive.
+     * @param mappedModel a mapped file of MLP_SIZE layers with the sizes of weightsDims.
+     */
+    explicit MlpNetwork(const std::shared_ptr<const MappedModel> &mappedModel);
+
+    /**
+     * converts the layers of a pruned network to sparse layers, SparseDense::convert picks dense or a sparse
+     * format per layer from the measured density of its weights. the dense layers stay the reference
+     * (getLayer, save), the sparse ones only replace them at inference time.
+     * @return the number of layers that run sparse.
      */
-    MlpNetwork(Matrix weights[], Matrix biases[]);
+    int sparsify();
+
+    /**
+     * a getter for the sparse form of a layer.
+     * @param index the index of the layer, 0 is the input layer.
+     * @return the sparse layer, or nullptr when the layer runs dense.
+     */
+    const SparseDense *getSparseLayer(int index) const;
+
+    /**
+     * writes the network in the model file format, for the mapping constructor.
+     * @param path the path of the file.
+     */
+    void save(const std::string &path) const;
 
     /**
      * an override method for the operator (), activating a mlpnetwork on a given image.
+     * the network is not changed, so one network may classify images from several threads at once.
      * @param img a matrix representing the image.
      * @return a digit which the mlp discovered from the image.
      */
-    Digit operator()(Matrix &img);
+    Digit operator()(const Matrix &img) const;
+
+    /**
+     * a getter for one of the layers of the network.
+     * @param index the index of the layer, 0 is the input layer.
+     * @return a reference to the layer.
+     */
+    const Dense &getLayer(int index) const;
+
+    /**
+     * activates the mlpnetwork on a batch of images at once, every layer is one matrix-matrix product
+     * over the whole batch, so the weights are read once per batch instead of once per image.
+     * @param images a 784 x N matrix (or a view of some of its columns), one vectorized image per column.
+     * @return the N digits, in the order of the columns.
+     */
+    std::vector<Digit> predictBatch(ConstMatrixView images) const;
+
+    /**
+     * activates the mlpnetwork on an array of images at once, the images are packed into the columns
+     * of a single batch matrix.
+     * @param images an array of n images (28x28 or already vectorized).
+     * @param n the number of images.
+     * @return the n digits, in the order of the images.
+     */
+    std::vector<Digit> predictBatch(const Matrix images[], int n) const;
+
+    /**
+     * activates the mlpnetwork on an array of images, spread in tiles over the workers of a thread pool.
+     * every tile is classified as one batch.
+     * @param images an array of n images (28x28 or already vectorized).
+     * @param n the number of images.
+     * @param pool the pool to run the tiles on.
+     * @param tileSize the number of images in a tile.
+     * @return the n digits, in the order of the images.
+     */
+    std::vector<Digit> predictParallel(const Matrix images[], int n, ThreadPool &pool,
+                                       int tileSize = MLP_TILE_SIZE) const;
+
+    /**
+     * activates the mlpnetwork on a batch of images, spread in tiles of its columns over the workers of a thread
+     * pool. a tile is a view of the batch, its images are not copied.
+     * @param images a 784 x N matrix (or a view), one vectorized image per column.
+     * @param pool the pool to run the tiles on.
+     * @param tileSize the number of images in a tile.
+     * @return the N digits, in the order of the columns.
+     */
+    std::vector<Digit> predictParallel(ConstMatrixView images, ThreadPool &pool, int tileSize = MLP_TILE_SIZE) const;
+
+    /**
+     * activates the mlpnetwork on every image of a stream, one batch at a time, while the stream reads
+     * the next batches in the background. throws the error of the stream (see ImageStream::next).
+     * @param stream the stream of images.
+     * @return the digits, in the order of the images in the stream.
+     */
+    std::vector<Digit> predictStream(ImageStream &stream) const;
 };
 
 #endif // MLPNETWORK_H
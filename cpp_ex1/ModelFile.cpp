@@ -0,0 +1,267 @@
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ModelFile.h"
+
+static_assert(sizeof(ModelHeader) == 64, "the model header is 64 bytes on disk");
+static_assert(sizeof(ModelLayer) == 32, "a model layer is 32 bytes on disk");
+
+/**
+ * rounds an offset up to the model alignment.
+ * @param offset an offset in bytes.
+ * @return the first aligned offset at or after it.
+ */
+static uint64_t _alignOffset(uint64_t offset)
+{
+    return (offset + MODEL_ALIGNMENT - 1) / MODEL_ALIGNMENT * MODEL_ALIGNMENT;
+}
+
+/**
+ * the checksum of a model file, FNV-1a over 64 bit words in 4 interleaved lanes (independent multiply
+ * chains, so the checksum keeps up with the memory), the lanes and the trailing bytes are folded at the end.
+ * @param data the first byte.
+ * @param bytes the number of bytes.
+ * @return the checksum.
+ */
+static uint64_t _checksum(const unsigned char *data, size_t bytes)
+{
+    const uint64_t prime = 0x100000001B3ULL;
+    uint64_t lanes[4] = {0xCBF29CE484222325ULL, 0xCBF29CE484222325ULL, 0xCBF29CE484222325ULL,
+                         0xCBF29CE484222325ULL};
+    size_t i = 0;
+    for (; i + sizeof(lanes) <= bytes; i += sizeof(lanes))
+    {
+        uint64_t words[4];
+        std::memcpy(words, data + i, sizeof(words));
+        for (int k = 0; k < 4; ++k)
+        {
+            lanes[k] = (lanes[k] ^ words[k]) * prime;
+        }
+    }
+    uint64_t hash = lanes[0];
+    for (int k = 1; k < 4; ++k)
+    {
+        hash = (hash ^ lanes[k]) * prime;
+    }
+    for (; i < bytes; ++i)
+    {
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+/**
+ * reports a bad model file, throws MatrixFileError with the message.
+ * @param message the error message.
+ */
+[[noreturn]] static void _modelError(const char *message)
+{
+    throw MatrixFileError(message);
+}
+
+/**
+ * writes the layers of a network in the model file format.
+ * @param path the path of the file.
+ * @param weights an array of the weight matrices.
+ * @param biases an array of the bias matrices (rows x 1).
+ * @param activations an array of the activations of the layers.
+ * @param layers the number of layers.
+ */
+void saveModel(const std::string &path, const Matrix weights[], const Matrix biases[],
+               const ActivationType activations[], int layers)
+{
+    std::vector<ModelLayer> table((size_t) layers);
+    uint64_t offset = _alignOffset(sizeof(ModelHeader) + layers * sizeof(ModelLayer));
+    for (int i = 0; i < layers; ++i)
+    {
+        if (biases[i].getRows() * biases[i].getCols() != weights[i].getRows())
+        {
+            _modelError(BAD_MODEL_ERROR);
+        }
+        table[i] = ModelLayer();
+        table[i].rows = (uint32_t) weights[i].getRows();
+        table[i].cols = (uint32_t) weights[i].getCols();
+        table[i].activation = (uint32_t) activations[i];
+        table[i].weightsOffset = offset;
+        offset = _alignOffset(offset + (uint64_t) table[i].rows * table[i].cols * sizeof(float));
+        table[i].biasOffset = offset;
+        offset = _alignOffset(offset + (uint64_t) table[i].rows * sizeof(float));
+    }
+    // the file is assembled in memory, so the checksum can go in the header before the single write.
+    std::vector<unsigned char> file(offset, 0);
+    std::memcpy(file.data() + sizeof(ModelHeader), table.data(), table.size() * sizeof(ModelLayer));
+    for (int i = 0; i < layers; ++i)
+    {
+        // the rows of a padded matrix are packed in the file.
+        weights[i].assignTo((float *) (file.data() + table[i].weightsOffset), (int) table[i].cols, 1);
+        std::memcpy(file.data() + table[i].biasOffset, biases[i].data(), (size_t) table[i].rows * sizeof(float));
+    }
+    ModelHeader header = ModelHeader();
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.byteOrder = MODEL_BYTE_ORDER;
+    header.layerCount = (uint32_t) layers;
+    header.dataType = ModelFloat32;
+    header.alignment = MODEL_ALIGNMENT;
+    header.fileBytes = offset;
+    header.checksum = _checksum(file.data() + sizeof(ModelHeader), file.size() - sizeof(ModelHeader));
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char *) file.data(), (std::streamsize) file.size());
+    if (!out)
+    {
+        _modelError(MODEL_WRITE_ERROR);
+    }
+}
+
+/**
+ * maps a model file and checks it, a bad file is an error.
+ * @param path the path of the file.
+ * @param verifyChecksum whether to read the whole file to check its checksum.
+ */
+MappedModel :: MappedModel(const std::string &path, bool verifyChecksum) : _base(nullptr), _bytes(0),
+                                                                             _header(nullptr), _layers(nullptr)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        _modelError(BAD_FILE_ERROR);
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(ModelHeader))
+    {
+        close(fd);
+        _modelError(BAD_MODEL_ERROR);
+    }
+    _bytes = (size_t) info.st_size;
+    // a read only mapping: the pages stay shared with the page cache (and other processes), and a stray
+    // write through a view of the weights faults instead of silently changing the model.
+    void *base = mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        _modelError(BAD_MODEL_ERROR);
+    }
+    madvise(base, _bytes, MADV_WILLNEED);
+    _base = (const unsigned char *) base;
+    _header = (const ModelHeader *) _base;
+    _layers = (const ModelLayer *) (_base + sizeof(ModelHeader));
+    try
+    {
+        _validate(verifyChecksum);
+    }
+    catch (const MatrixFileError &)
+    {
+        // the destructor does not run for a constructor that throws.
+        munmap(base, _bytes);
+        throw;
+    }
+}
+
+/**
+ * unmaps the file.
+ */
+MappedModel :: ~MappedModel()
+{
+    munmap((void *) _base, _bytes);
+}
+
+/**
+ * checks the header, the layer table and (optionally) the checksum of the mapped file.
+ * @param verifyChecksum whether to read the whole file to check its checksum.
+ */
+void MappedModel :: _validate(bool verifyChecksum) const
+{
+    if (std::memcmp(_header->magic, MODEL_MAGIC, sizeof(_header->magic)) != 0 ||
+        _header->version != MODEL_VERSION || _header->byteOrder != MODEL_BYTE_ORDER ||
+        _header->dataType != ModelFloat32 || _header->alignment != MODEL_ALIGNMENT ||
+        _header->fileBytes != _bytes || _header->layerCount == 0 ||
+        sizeof(ModelHeader) + (uint64_t) _header->layerCount * sizeof(ModelLayer) > _bytes)
+    {
+        _modelError(BAD_MODEL_ERROR);
+    }
+    for (uint32_t i = 0; i < _header->layerCount; ++i)
+    {
+        const ModelLayer &layer = _layers[i];
+        // a matrix indexes its rows * cols floats with an int, larger dims would wrap in the sizes below
+        // (and in the int casts of the views), so they are rejected before anything is multiplied.
+        if (layer.rows == 0 || layer.cols == 0 || layer.rows > (uint32_t) INT_MAX || layer.cols > (uint32_t) INT_MAX ||
+            (uint64_t) layer.rows * layer.cols > (uint64_t) INT_MAX)
+        {
+            _modelError(BAD_MODEL_ERROR);
+        }
+        const uint64_t weightBytes = (uint64_t) layer.rows * layer.cols * sizeof(float);
+        const uint64_t biasBytes = (uint64_t) layer.rows * sizeof(float);
+        if (layer.activation > LogSoftmax ||
+            layer.weightsOffset % MODEL_ALIGNMENT != 0 || layer.biasOffset % MODEL_ALIGNMENT != 0 ||
+            layer.weightsOffset > _bytes || weightBytes > _bytes - layer.weightsOffset ||
+            layer.biasOffset > _bytes || biasBytes > _bytes - layer.biasOffset)
+        {
+            _modelError(BAD_MODEL_ERROR);
+        }
+    }
+    if (verifyChecksum && _checksum(_base + sizeof(ModelHeader), _bytes - sizeof(ModelHeader)) != _header->checksum)
+    {
+        _modelError(MODEL_CHECKSUM_ERROR);
+    }
+}
+
+/**
+ * a getter for the number of layers in the file.
+ * @return the number of layers.
+ */
+int MappedModel :: getLayerCount() const
+{
+    return (int) _header->layerCount;
+}
+
+/**
+ * a getter for the activation of a layer, throws MatrixIndexError for a layer out of range.
+ * @param index the index of the layer.
+ * @return the activation type of the layer.
+ */
+ActivationType MappedModel :: getActivationType(int index) const
+{
+    if (index < 0 || index >= getLayerCount())
+    {
+        throw MatrixIndexError();
+    }
+    return (ActivationType) _layers[index].activation;
+}
+
+/**
+ * the weights of a layer, a view of the mapped pages. throws MatrixIndexError for a layer out of range.
+ * @param index the index of the layer.
+ * @return a read only view of the weights.
+ */
+ConstMatrixView MappedModel :: getWeights(int index) const
+{
+    if (index < 0 || index >= getLayerCount())
+    {
+        throw MatrixIndexError();
+    }
+    const ModelLayer &layer = _layers[index];
+    return ConstMatrixView((const float *) (_base + layer.weightsOffset), (int) layer.rows, (int) layer.cols,
+                           (int) layer.cols);
+}
+
+/**
+ * the bias of a layer, a view of the mapped pages. throws MatrixIndexError for a layer out of range.
+ * @param index the index of the layer.
+ * @return a read only view of the bias.
+ */
+ConstMatrixView MappedModel :: getBias(int index) const
+{
+    if (index < 0 || index >= getLayerCount())
+    {
+        throw MatrixIndexError();
+    }
+    const ModelLayer &layer = _layers[index];
+    return ConstMatrixView((const float *) (_base + layer.biasOffset), (int) layer.rows, 1, 1);
+}
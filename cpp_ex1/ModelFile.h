@@ -0,0 +1,143 @@
+// ModelFile.h
+
+#ifndef MODELFILE_H
+#define MODELFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Matrix.h"
+#include "Activation.h"
+
+#define BAD_MODEL_ERROR "Error: bad model file"
+#define MODEL_CHECKSUM_ERROR "Error: model file checksum mismatch"
+#define MODEL_WRITE_ERROR "Error: can not write the model file"
+
+#define MODEL_MAGIC "MLPMODEL"
+#define MODEL_VERSION 1
+// a little endian writer stores this as 04 03 02 01, a reader of the other byte order sees it swapped.
+#define MODEL_BYTE_ORDER 0x01020304u
+// every weight and bias array starts at a multiple of this many bytes from the start of the file.
+#define MODEL_ALIGNMENT 64
+
+/**
+ * @enum ModelDataType
+ * @brief the element type of the arrays of a model file.
+ */
+enum ModelDataType
+{
+    ModelFloat32 = 0
+};
+
+/**
+ * @struct ModelHeader
+ * @brief the first 64 bytes of a model file. it is followed by layerCount ModelLayer entries and the arrays.
+ *        checksum covers every byte after the header.
+ */
+typedef struct ModelHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t layerCount;
+    uint32_t dataType;
+    uint32_t alignment;
+    uint32_t reserved;
+    uint64_t fileBytes;
+    uint64_t checksum;
+    uint64_t padding[2];
+
+} ModelHeader;
+
+/**
+ * @struct ModelLayer
+ * @brief the description of one dense layer of a model file, the offsets are from the start of the file.
+ */
+typedef struct ModelLayer
+{
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t activation;
+    uint32_t reserved;
+    uint64_t weightsOffset;
+    uint64_t biasOffset;
+
+} ModelLayer;
+
+/**
+ * writes the layers of a network in the model file format.
+ * @param path the path of the file.
+ * @param weights an array of the weight matrices.
+ * @param biases an array of the bias matrices (rows x 1).
+ * @param activations an array of the activations of the layers.
+ * @param layers the number of layers.
+ */
+void saveModel(const std::string &path, const Matrix weights[], const Matrix biases[],
+               const ActivationType activations[], int layers);
+
+/**
+ * a model file mapped into memory, read only. the weights and biases it hands out are const views of the
+ * mapped pages, so loading copies nothing, and processes mapping the same file share its page cache.
+ * the mapping lives as long as the MappedModel, which has to outlive the views it handed out.
+ */
+class MappedModel
+{
+private:
+    const unsigned char *_base;
+    size_t _bytes;
+    const ModelHeader *_header;
+    const ModelLayer *_layers;
+
+    /**
+     * checks the header, the layer table and (optionally) the checksum of the mapped file.
+     * @param verifyChecksum whether to read the whole file to check its checksum.
+     */
+    void _validate(bool verifyChecksum) const;
+
+public:
+
+    /**
+     * maps a model file and checks it, a bad file is an error.
+     * @param path the path of the file.
+     * @param verifyChecksum whether to read the whole file to check its checksum.
+     */
+    explicit MappedModel(const std::string &path, bool verifyChecksum = true);
+
+    MappedModel(const MappedModel &) = delete;
+
+    MappedModel &operator=(const MappedModel &) = delete;
+
+    /**
+     * unmaps the file.
+     */
+    ~MappedModel();
+
+    /**
+     * a getter for the number of layers in the file.
+     * @return the number of layers.
+     */
+    int getLayerCount() const;
+
+    /**
+     * a getter for the activation of a layer, throws MatrixIndexError for a layer out of range.
+     * @param index the index of the layer.
+     * @return the activation type of the layer.
+     */
+    ActivationType getActivationType(int index) const;
+
+    /**
+     * the weights of a layer, a view of the mapped pages. throws MatrixIndexError for a layer out of range.
+     * @param index the index of the layer.
+     * @return a read only view of the weights.
+     */
+    ConstMatrixView getWeights(int index) const;
+
+    /**
+     * the bias of a layer, a view of the mapped pages. throws MatrixIndexError for a layer out of range.
+     * @param index the index of the layer.
+     * @return a read only view of the bias.
+     */
+    ConstMatrixView getBias(int index) const;
+};
+
+#endif //MODELFILE_H
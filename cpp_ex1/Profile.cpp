@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include "Profile.h"
+
+#ifdef MLP_PROFILE
+
+// a slot per layer and one for the network, in each phase.
+#define PROFILE_PHASE_SLOTS (PROFILE_LAYERS + 1)
+#define PROFILE_SLOTS (2 * PROFILE_PHASE_SLOTS)
+
+/**
+ * @struct ProfileCounters
+ * @brief the counters of one scope in one thread. only the thread writes them (a relaxed load and store,
+ *        no locked instruction), a dump reads them from any thread.
+ */
+typedef struct ProfileCounters
+{
+    std::atomic<uint64_t> calls{0}, nanos{0}, flops{0}, bytes{0}, allocations{0}, allocatedBytes{0};
+} ProfileCounters;
+
+/**
+ * @struct ProfileTotals
+ * @brief the counters of one scope summed over the threads.
+ */
+typedef struct ProfileTotals
+{
+    uint64_t calls, nanos, flops, bytes, allocations, allocatedBytes;
+} ProfileTotals;
+
+/**
+ * @struct ProfileRegistry
+ * @brief the counters of every thread that ran a scope, and the totals at the last reset. the counters of
+ *        a thread outlive it, so its work stays in the totals.
+ */
+typedef struct ProfileRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileCounters[]>> threads;
+    ProfileTotals baseline[PROFILE_SLOTS] = {};
+} ProfileRegistry;
+
+// the heap allocations of the calling thread, plain thread locals so operator new can count them at any time.
+static thread_local uint64_t _threadAllocations = 0;
+static thread_local uint64_t _threadAllocatedBytes = 0;
+
+/**
+ * prints the profile to the standard error at exit.
+ */
+static void _dumpAtExit()
+{
+    profileDump(std::cerr);
+}
+
+/**
+ * the registry of the process. it is never destroyed, a thread may still end a scope while the statics
+ * are destroyed at exit.
+ * @return a reference to the registry.
+ */
+static ProfileRegistry &_registry()
+{
+    static ProfileRegistry *registry = []()
+    {
+        std::atexit(_dumpAtExit);
+        return new ProfileRegistry();
+    }();
+    return *registry;
+}
+
+/**
+ * the counters of the calling thread, registered on its first scope.
+ * @return the PROFILE_SLOTS counters of the thread.
+ */
+static ProfileCounters *_threadCounters()
+{
+    static thread_local ProfileCounters *counters = nullptr;
+    if (counters == nullptr)
+    {
+        ProfileRegistry &registry = _registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.emplace_back(new ProfileCounters[PROFILE_SLOTS]);
+        counters = registry.threads.back().get();
+    }
+    return counters;
+}
+
+/**
+ * adds to a counter of the calling thread, the only writer of the counter.
+ * @param counter the counter.
+ * @param value the value to add.
+ */
+static void _add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/**
+ * sums the counters of the threads, the registry is locked by the caller.
+ * @param registry the registry.
+ * @param totals PROFILE_SLOTS totals to fill.
+ */
+static void _sumThreads(const ProfileRegistry &registry, ProfileTotals totals[])
+{
+    std::fill(totals, totals + PROFILE_SLOTS, ProfileTotals{});
+    for (const std::unique_ptr<ProfileCounters[]> &counters : registry.threads)
+    {
+        for (int s = 0; s < PROFILE_SLOTS; ++s)
+        {
+            const ProfileCounters &c = counters[s];
+            totals[s].calls += c.calls.load(std::memory_order_relaxed);
+            totals[s].nanos += c.nanos.load(std::memory_order_relaxed);
+            totals[s].flops += c.flops.load(std::memory_order_relaxed);
+            totals[s].bytes += c.bytes.load(std::memory_order_relaxed);
+            totals[s].allocations += c.allocations.load(std::memory_order_relaxed);
+            totals[s].allocatedBytes += c.allocatedBytes.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * the current time of the steady clock.
+ * @return the time in nanoseconds.
+ */
+static uint64_t _nowNanos()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * counts a heap allocation of the calling thread that does not go through operator new.
+ * @param bytes the size of the allocation.
+ */
+void profileAllocation(size_t bytes)
+{
+    ++_threadAllocations;
+    _threadAllocatedBytes += bytes;
+}
+
+/**
+ * a getter for the heap allocations of the calling thread since it started, through operator new or
+ * profileAllocation, inside a scope or not.
+ * @return the number of allocations.
+ */
+uint64_t profileThreadAllocations()
+{
+    return _threadAllocations;
+}
+
+/**
+ * starts a scope.
+ * @param phase the kind of inference.
+ * @param layer the index of the layer, or PROFILE_NETWORK for a whole network.
+ * @param flops the floating point operations of the scope.
+ * @param bytes the bytes the scope reads and writes (weights, inputs and outputs).
+ */
+ProfileScope :: ProfileScope(ProfilePhase phase, int layer, double flops, double bytes)
+        : _slot(phase * PROFILE_PHASE_SLOTS + ((layer == PROFILE_NETWORK) ? PROFILE_LAYERS
+                                                                          : std::min(layer, PROFILE_LAYERS - 1))),
+          _flops((uint64_t) flops), _bytes((uint64_t) bytes), _allocations(0), _allocatedBytes(0),
+          _startNanos(0)
+{
+    // registered before the allocations are read, the registration allocates.
+    _threadCounters();
+    _allocations = _threadAllocations;
+    _allocatedBytes = _threadAllocatedBytes;
+    _startNanos = _nowNanos();
+}
+
+/**
+ * ends the scope and adds it to the counters.
+ */
+ProfileScope :: ~ProfileScope()
+{
+    const uint64_t nanos = _nowNanos() - _startNanos;
+    ProfileCounters &counters = _threadCounters()[_slot];
+    _add(counters.calls, 1);
+    _add(counters.nanos, nanos);
+    _add(counters.flops, _flops);
+    _add(counters.bytes, _bytes);
+    _add(counters.allocations, _threadAllocations - _allocations);
+    _add(counters.allocatedBytes, _threadAllocatedBytes - _allocatedBytes);
+}
+
+/**
+ * prints the counters of every scope that ran since the start (or the last reset), summed over the
+ * threads: the calls, the wall time, the flops and bytes (and their rates), and the heap allocations.
+ * the counters keep running while they are read, a dump during inference is a snapshot.
+ * @param os the stream to print to.
+ */
+void profileDump(std::ostream &os)
+{
+    ProfileRegistry &registry = _registry();
+    ProfileTotals totals[PROFILE_SLOTS];
+    size_t threads;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        _sumThreads(registry, totals);
+        threads = registry.threads.size();
+        for (int s = 0; s < PROFILE_SLOTS; ++s)
+        {
+            totals[s].calls -= registry.baseline[s].calls;
+            totals[s].nanos -= registry.baseline[s].nanos;
+            totals[s].flops -= registry.baseline[s].flops;
+            totals[s].bytes -= registry.baseline[s].bytes;
+            totals[s].allocations -= registry.baseline[s].allocations;
+            totals[s].allocatedBytes -= registry.baseline[s].allocatedBytes;
+        }
+    }
+    char line[160];
+    std::snprintf(line, sizeof(line), "profile of %zu thread(s)\n%-16s %10s %11s %10s %9s %9s %12s %12s\n",
+                  threads, "scope", "calls", "total ms", "mean us", "GFLOP/s", "GB/s", "allocs/call", "bytes/call");
+    os << line;
+    for (int s = 0; s < PROFILE_SLOTS; ++s)
+    {
+        const ProfileTotals &t = totals[s];
+        if (t.calls == 0)
+        {
+            continue;
+        }
+        const int layer = s % PROFILE_PHASE_SLOTS;
+        const std::string name = std::string(s < PROFILE_PHASE_SLOTS ? "image " : "batch ") +
+                                 ((layer == PROFILE_LAYERS) ? "network" : "layer " + std::to_string(layer));
+        const double nanos = (double) std::max(t.nanos, (uint64_t) 1);
+        std::snprintf(line, sizeof(line), "%-16s %10llu %11.3f %10.3f %9.2f %9.2f %12.2f %12.0f\n", name.c_str(),
+                      (unsigned long long) t.calls, nanos / 1e6, nanos / 1e3 / (double) t.calls,
+                      (double) t.flops / nanos, (double) t.bytes / nanos,
+                      (double) t.allocations / (double) t.calls, (double) t.allocatedBytes / (double) t.calls);
+        os << line;
+    }
+}
+
+/**
+ * starts the counters over from the current values, for the next dump.
+ */
+void profileReset()
+{
+    ProfileRegistry &registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    _sumThreads(registry, registry.baseline);
+}
+
+/**
+ * the global allocation function of the profiling build, counts the allocations of the calling thread.
+ * @param size the size of the allocation.
+ * @return the allocated memory.
+ */
+void *operator new(size_t size)
+{
+    ++_threadAllocations;
+    _threadAllocatedBytes += size;
+    void *block = std::malloc(size == 0 ? 1 : size);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+/**
+ * the global deallocation function matching operator new.
+ * @param block the memory.
+ */
+void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+/**
+ * the sized global deallocation function matching operator new.
+ * @param block the memory.
+ */
+void operator delete(void *block, size_t) noexcept
+{
+    std::free(block);
+}
+
+#else
+
+/**
+ * the profile is compiled out, there is nothing to print.
+ * @param os the stream to print to.
+ */
+void profileDump(std::ostream &os)
+{
+    os << "profile: compiled out, build with make PROFILE=1" << std::endl;
+}
+
+/**
+ * the profile is compiled out, there is nothing to reset.
+ */
+void profileReset()
+{
+}
+
+#endif
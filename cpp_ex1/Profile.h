@@ -0,0 +1,105 @@
+// Profile.h
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/*
+ * the profiling hooks are compiled in with -DMLP_PROFILE (make PROFILE=1). without it PROFILE_SCOPE and
+ * PROFILE_ALLOCATION expand to nothing, their arguments are not even evaluated, and only profileDump and
+ * profileReset remain (they report that the profile is compiled out).
+ */
+
+// the number of layers a profile keeps apart, deeper layers share the last one.
+#define PROFILE_LAYERS 8
+// the layer index of a scope around a whole network.
+#define PROFILE_NETWORK (-1)
+
+/**
+ * @enum ProfilePhase
+ * @brief the kind of inference a scope is timed in.
+ */
+enum ProfilePhase
+{
+    // one image at a time, operator().
+    ProfileImage,
+    // a batch of images, one per column.
+    ProfileBatch
+};
+
+/**
+ * prints the counters of every scope that ran since the start (or the last reset), summed over the
+ * threads: the calls, the wall time, the flops and bytes (and their rates), and the heap allocations.
+ * the counters keep running while they are read, a dump during inference is a snapshot.
+ * @param os the stream to print to.
+ */
+void profileDump(std::ostream &os);
+
+/**
+ * starts the counters over from the current values, for the next dump.
+ */
+void profileReset();
+
+#ifdef MLP_PROFILE
+
+/**
+ * counts a heap allocation of the calling thread that does not go through operator new.
+ * @param bytes the size of the allocation.
+ */
+void profileAllocation(size_t bytes);
+
+/**
+ * a getter for the heap allocations of the calling thread since it started, through operator new or
+ * profileAllocation, inside a scope or not.
+ * @return the number of allocations.
+ */
+uint64_t profileThreadAllocations();
+
+/**
+ * a timed scope: the constructor starts the clock, and the destructor adds the time, the work and the
+ * allocations in between to the counters of the calling thread. the counters of a thread are written only
+ * by that thread, without locks.
+ */
+class ProfileScope
+{
+private:
+    int _slot;
+    uint64_t _flops, _bytes, _allocations, _allocatedBytes, _startNanos;
+
+public:
+
+    /**
+     * starts a scope.
+     * @param phase the kind of inference.
+     * @param layer the index of the layer, or PROFILE_NETWORK for a whole network.
+     * @param flops the floating point operations of the scope.
+     * @param bytes the bytes the scope reads and writes (weights, inputs and outputs).
+     */
+    ProfileScope(ProfilePhase phase, int layer, double flops, double bytes);
+
+    /**
+     * ends the scope and adds it to the counters.
+     */
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(phase, layer, flops, bytes) \
+    ProfileScope PROFILE_JOIN(_profileScope, __LINE__)((phase), (layer), (flops), (bytes))
+#define PROFILE_ALLOCATION(bytes) profileAllocation(bytes)
+
+#else
+
+#define PROFILE_SCOPE(phase, layer, flops, bytes) ((void) 0)
+#define PROFILE_ALLOCATION(bytes) ((void) 0)
+
+#endif
+
+#endif //PROFILE_H
@@ -0,0 +1,301 @@
+#include <cmath>
+#include "QuantizedDense.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUANT_X86
+#endif
+
+/**
+ * an int8 dot product type, the sum of x[i] * w[i] over n values (n a multiple of QUANT_ROW_ALIGN).
+ */
+typedef int32_t (*DotU8S8)(const uint8_t *x, const int8_t *w, int n);
+
+/**
+ * an input quantizer type, finds the range of x (stretched to contain 0) and writes
+ * q[i] = clamp(x[i] * inv + offset, 0, QUANT_INPUT_MAX) with the range turned into inv and offset.
+ */
+typedef void (*QuantizeInput)(const float *x, int n, uint8_t *q, float *scale, int32_t *zeroPoint);
+
+/**
+ * the int8 kernels picked for the running cpu.
+ */
+struct QuantKernels
+{
+    DotU8S8 dot;
+    QuantizeInput quantize;
+};
+
+/**
+ * turns the range of the input into its scale and zero point.
+ * @param lo the smallest input (at most 0)
+ * @param hi the largest input (at least 0)
+ * @param scale the float of one quantized step
+ * @param zeroPoint the quantized value of 0
+ */
+static void _inputScale(float lo, float hi, float *scale, int32_t *zeroPoint)
+{
+    *scale = (hi > lo) ? (hi - lo) / QUANT_INPUT_MAX : 1;
+    *zeroPoint = (int32_t) std::lround(-lo / *scale);
+}
+
+/**
+ * the portable int8 dot product.
+ */
+static int32_t _dotScalar(const uint8_t *x, const int8_t *w, int n)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sum += (int32_t) x[i] * (int32_t) w[i];
+    }
+    return sum;
+}
+
+/**
+ * the portable input quantizer.
+ */
+static void _quantizeScalar(const float *x, int n, uint8_t *q, float *scale, int32_t *zeroPoint)
+{
+    float lo = 0, hi = 0;
+    for (int j = 0; j < n; ++j)
+    {
+        lo = (x[j] < lo) ? x[j] : lo;
+        hi = (x[j] > hi) ? x[j] : hi;
+    }
+    _inputScale(lo, hi, scale, zeroPoint);
+    // x / scale + zp is never below -0.5, so adding 0.5 and truncating rounds to the nearest.
+    const float inv = 1 / *scale;
+    const float offset = (float) *zeroPoint + 0.5f;
+    for (int j = 0; j < n; ++j)
+    {
+        float val = x[j] * inv + offset;
+        val = (val < 0) ? 0 : (val > QUANT_INPUT_MAX) ? QUANT_INPUT_MAX : val;
+        q[j] = (uint8_t) val;
+    }
+}
+
+#ifdef QUANT_X86
+/**
+ * the AVX2 input quantizer, 8 floats at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void _quantizeAvx2(const float *x, int n, uint8_t *q, float *scale, int32_t *zeroPoint)
+{
+    __m256 vlo = _mm256_setzero_ps();
+    __m256 vhi = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256 val = _mm256_loadu_ps(x + j);
+        vlo = _mm256_min_ps(vlo, val);
+        vhi = _mm256_max_ps(vhi, val);
+    }
+    alignas(32) float los[8], his[8];
+    _mm256_store_ps(los, vlo);
+    _mm256_store_ps(his, vhi);
+    float lo = 0, hi = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        lo = (los[i] < lo) ? los[i] : lo;
+        hi = (his[i] > hi) ? his[i] : hi;
+    }
+    for (int i = j; i < n; ++i)
+    {
+        lo = (x[i] < lo) ? x[i] : lo;
+        hi = (x[i] > hi) ? x[i] : hi;
+    }
+    _inputScale(lo, hi, scale, zeroPoint);
+    const float inv = 1 / *scale;
+    const float offset = (float) *zeroPoint + 0.5f;
+    const __m256 vinv = _mm256_set1_ps(inv);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vmax = _mm256_set1_ps(QUANT_INPUT_MAX);
+    const __m256 zero = _mm256_setzero_ps();
+    j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256 val = _mm256_fmadd_ps(_mm256_loadu_ps(x + j), vinv, voffset);
+        __m256i ints = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(val, zero), vmax));
+        // 8 int32 in [0, 127] -> 8 bytes.
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+        _mm_storel_epi64((__m128i *) (q + j), _mm_packus_epi16(words, words));
+    }
+    for (; j < n; ++j)
+    {
+        float val = x[j] * inv + offset;
+        val = (val < 0) ? 0 : (val > QUANT_INPUT_MAX) ? QUANT_INPUT_MAX : val;
+        q[j] = (uint8_t) val;
+    }
+}
+
+/**
+ * the AVX2 int8 dot product, maddubs multiplies u8 by s8 and adds the pairs to int16 (which can not saturate
+ * with 7 bit inputs), madd with ones widens the pairs to int32.
+ */
+__attribute__((target("avx2")))
+static int32_t _dotAvx2(const uint8_t *x, const int8_t *w, int n)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32)
+    {
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) (x + i)),
+                                             _mm256_loadu_si256((const __m256i *) (w + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+/**
+ * the AVX-VNNI int8 dot product, dpbusd multiplies u8 by s8 and accumulates groups of 4 in int32 directly.
+ */
+__attribute__((target("avx2,avxvnni")))
+static int32_t _dotAvxVnni(const uint8_t *x, const int8_t *w, int n)
+{
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32)
+    {
+        acc = _mm256_dpbusd_avx_epi32(acc, _mm256_loadu_si256((const __m256i *) (x + i)),
+                                      _mm256_loadu_si256((const __m256i *) (w + i)));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+/**
+ * the AVX512-VNNI int8 dot product, 64 products per instruction.
+ */
+__attribute__((target("avx512f,avx512vnni")))
+static int32_t _dotAvx512Vnni(const uint8_t *x, const int8_t *w, int n)
+{
+    __m512i acc = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64)
+    {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(x + i), _mm512_loadu_si512(w + i));
+    }
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    int32_t sum = 0;
+    for (int32_t lane : lanes)
+    {
+        sum += lane;
+    }
+    return sum;
+}
+#endif
+
+/**
+ * picks the best int8 kernels for the running cpu.
+ * @return the kernels.
+ */
+static QuantKernels _selectKernels()
+{
+#ifdef QUANT_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512f"))
+        {
+            return QuantKernels{_dotAvx512Vnni, _quantizeAvx2};
+        }
+        if (__builtin_cpu_supports("avxvnni"))
+        {
+            return QuantKernels{_dotAvxVnni, _quantizeAvx2};
+        }
+        return QuantKernels{_dotAvx2, _quantizeAvx2};
+    }
+#endif
+    return QuantKernels{_dotScalar, _quantizeScalar};
+}
+
+/**
+ * the quantizer, converts the weights of a trained float layer to int8 with per row scales.
+ * @param dense the float layer.
+ */
+QuantizedDense :: QuantizedDense(const Dense &dense) : _activationType(dense.getActivation().getActivationType()),
+                                                     _rows(dense.getRows()), _cols(dense.getCols()),
+                                                     _paddedCols((_cols + QUANT_ROW_ALIGN - 1) / QUANT_ROW_ALIGN *
+                                                                 QUANT_ROW_ALIGN),
+                                                     _weights((size_t) _rows * _paddedCols, 0),
+                                                     _scales(_rows), _rowSums(_rows, 0),
+                                                     _bias(dense.getBias().data(), dense.getBias().data() + _rows)
+{
+    const Matrix weights = dense.getWeights();
+    const float *w = weights.data();
+    for (int i = 0; i < _rows; ++i)
+    {
+        float maxAbs = 0;
+        for (int j = 0; j < _cols; ++j)
+        {
+            maxAbs = std::fmax(maxAbs, std::fabs(w[i * _cols + j]));
+        }
+        _scales[i] = (maxAbs > 0) ? maxAbs / QUANT_WEIGHT_MAX : 1;
+        for (int j = 0; j < _cols; ++j)
+        {
+            auto q = (int8_t) std::lround(w[i * _cols + j] / _scales[i]);
+            _weights[(size_t) i * _paddedCols + j] = q;
+            _rowSums[i] += q;
+        }
+    }
+}
+
+/**
+ * a getter for the number of outputs of the layer.
+ * @return the number of rows of W.
+ */
+int QuantizedDense :: getRows() const
+{
+    return _rows;
+}
+
+/**
+ * a getter for the number of inputs of the layer.
+ * @return the number of cols of W.
+ */
+int QuantizedDense :: getCols() const
+{
+    return _cols;
+}
+
+/**
+ * a getter for the memory the weights take, including the padding and the per row scales.
+ * @return the number of bytes of the weights.
+ */
+size_t QuantizedDense :: weightBytes() const
+{
+    return _weights.size() * sizeof(int8_t) + _scales.size() * sizeof(float) + _rowSums.size() * sizeof(int32_t);
+}
+
+/**
+ * the quantized forward kernel, writes act(W*x + b) into output.
+ * the input range (stretched to contain 0, so zeros stay exact) is mapped onto [0, QUANT_INPUT_MAX]
+ * with a zero point zp, so W*x = wScale * xScale * (sum(wq * xq) - zp * sum(wq)).
+ * @param input the input vector, getCols() floats.
+ * @param output the output vector, getRows() floats.
+ */
+void QuantizedDense :: forward(const float *input, float *output) const
+{
+    static const QuantKernels kernels = _selectKernels();
+    static thread_local std::vector<uint8_t> quantized;
+    // the buffer is shared by the layers of the thread, its floats past _cols may hold the input of a wider
+    // layer. they meet the zero padding of the weights and add nothing to the dot products.
+    quantized.resize(_paddedCols, 0);
+    float xScale;
+    int32_t zeroPoint;
+    kernels.quantize(input, _cols, quantized.data(), &xScale, &zeroPoint);
+    for (int i = 0; i < _rows; ++i)
+    {
+        int32_t acc = kernels.dot(quantized.data(), _weights.data() + (size_t) i * _paddedCols, _paddedCols);
+        float val = _scales[i] * xScale * (float) (acc - zeroPoint * _rowSums[i]) + _bias[i];
+        output[i] = (_activationType == Relu && val < 0) ? 0 : val;
+    }
+    if (_activationType != Relu)
+    {
+        Activation(_activationType).activate(output, _rows);
+    }
+}
@@ -0,0 +1,67 @@
+// QuantizedDense.h
+
+#ifndef QUANTIZEDDENSE_H
+#define QUANTIZEDDENSE_H
+
+#include <cstdint>
+#include <vector>
+#include "Dense.h"
+
+// the rows of the int8 weights are padded with zeros to a multiple of this many columns.
+#define QUANT_ROW_ALIGN 64
+// the largest quantized weight, weights are symmetric in [-QUANT_WEIGHT_MAX, QUANT_WEIGHT_MAX].
+#define QUANT_WEIGHT_MAX 127
+// the largest quantized input. inputs use 7 bits so a pair of u8*s8 products never saturates 16 bits.
+#define QUANT_INPUT_MAX 127
+
+/**
+ * a dense layer with int8 weights. every row of W is stored as int8 with its own float scale,
+ * the input vector is quantized on the fly to unsigned 7 bit values with a zero point, the products are
+ * accumulated in int32 (AVX512-VNNI, AVX-VNNI or AVX2 maddubs when the cpu has them) and the result is
+ * scaled back to float before the bias and the activation.
+ */
+class QuantizedDense
+{
+private:
+    ActivationType _activationType;
+    int _rows, _cols, _paddedCols;
+    std::vector<int8_t> _weights;
+    std::vector<float> _scales;
+    std::vector<int32_t> _rowSums;
+    std::vector<float> _bias;
+
+public:
+
+    /**
+     * the quantizer, converts the weights of a trained float layer to int8 with per row scales.
+     * @param dense the float layer.
+     */
+    explicit QuantizedDense(const Dense &dense);
+
+    /**
+     * a getter for the number of outputs of the layer.
+     * @return the number of rows of W.
+     */
+    int getRows() const;
+
+    /**
+     * a getter for the number of inputs of the layer.
+     * @return the number of cols of W.
+     */
+    int getCols() const;
+
+    /**
+     * a getter for the memory the weights take, including the padding and the per row scales.
+     * @return the number of bytes of the weights.
+     */
+    size_t weightBytes() const;
+
+    /**
+     * the quantized forward kernel, writes act(W*x + b) into output.
+     * @param input the input vector, getCols() floats.
+     * @param output the output vector, getRows() floats.
+     */
+    void forward(const float *input, float *output) const;
+};
+
+#endif //QUANTIZEDDENSE_H
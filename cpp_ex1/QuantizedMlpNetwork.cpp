@@ -0,0 +1,104 @@
+#include <cmath>
+#include "QuantizedMlpNetwork.h"
+
+/**
+ * the quantizer, converts every layer of a float network to int8 weights with per row scales.
+ * @param network the trained float network.
+ */
+QuantizedMlpNetwork :: QuantizedMlpNetwork(const MlpNetwork &network)
+{
+    std::vector<BufferLifetime> outputs;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        _layers.emplace_back(network.getLayer(i));
+        outputs.push_back(BufferLifetime{(size_t) _layers[i].getRows(), i, i + 1});
+    }
+    _plan = MemoryPlan(outputs);
+}
+
+/**
+ * activating the quantized mlpnetwork on a given image.
+ * @param img a matrix representing the image.
+ * @return a digit which the mlp discovered from the image.
+ */
+Digit QuantizedMlpNetwork :: operator()(const Matrix &img) const
+{
+    if (img.getRows() * img.getCols() != _layers[0].getCols())
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    if (!img.isPacked())
+    {
+        // the layers read the image as one vector.
+        return (*this)(Matrix(img, packedLayout));
+    }
+    ArenaFrame frame(_plan.size());
+    const float *in = img.data();
+    float *out = nullptr;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        out = frame.data() + _plan.offset(i);
+        _layers[i].forward(in, out);
+        in = out;
+    }
+    int index = 0;
+    for (int i = 0; i < _layers[MLP_SIZE - 1].getRows(); ++i)
+    {
+        if (out[i] > out[index])
+        {
+            index = i;
+        }
+    }
+    Digit num = Digit();
+    num.value = index;
+    num.probability = out[index];
+    return num;
+}
+
+/**
+ * a getter for the memory the quantized weights take.
+ * @return the number of bytes of the weights of all the layers.
+ */
+size_t QuantizedMlpNetwork :: weightBytes() const
+{
+    size_t bytes = 0;
+    for (const auto &layer : _layers)
+    {
+        bytes += layer.weightBytes();
+    }
+    return bytes;
+}
+
+/**
+ * runs the float and the quantized networks on the same images and reports how often they agree on the digit,
+ * the difference in the reported probability and the size of the weights of both.
+ * @param network the float network
+ * @param quantized the quantized network
+ * @param images an array of n images.
+ * @param n the number of images.
+ * @return the report.
+ */
+QuantizationReport compareQuantization(const MlpNetwork &network, const QuantizedMlpNetwork &quantized,
+                                       const Matrix images[], int n)
+{
+    QuantizationReport report = QuantizationReport();
+    report.images = n;
+    double deltaSum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        Digit expected = network(images[i]);
+        Digit actual = quantized(images[i]);
+        report.agreements += (expected.value == actual.value) ? 1 : 0;
+        float delta = std::fabs(expected.probability - actual.probability);
+        report.maxProbabilityDelta = std::fmax(report.maxProbabilityDelta, delta);
+        deltaSum += delta;
+    }
+    report.agreementRate = (n > 0) ? (float) report.agreements / (float) n : 1;
+    report.meanProbabilityDelta = (n > 0) ? (float) (deltaSum / n) : 0;
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        report.floatWeightBytes += network.getLayer(i).weightBytes();
+    }
+    report.quantizedWeightBytes = quantized.weightBytes();
+    return report;
+}
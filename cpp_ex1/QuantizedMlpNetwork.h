@@ -0,0 +1,71 @@
+// QuantizedMlpNetwork.h
+
+#ifndef QUANTIZEDMLPNETWORK_H
+#define QUANTIZEDMLPNETWORK_H
+
+#include <vector>
+#include "MlpNetwork.h"
+#include "QuantizedDense.h"
+#include "MemoryPlan.h"
+
+/**
+ * @struct QuantizationReport
+ * @brief the accuracy and size of a quantized network compared to its float network.
+ */
+typedef struct QuantizationReport
+{
+    int images;
+    int agreements;
+    float agreementRate;
+    float maxProbabilityDelta;
+    float meanProbabilityDelta;
+    size_t floatWeightBytes;
+    size_t quantizedWeightBytes;
+
+} QuantizationReport;
+
+/**
+ * a mlpnetwork running on int8 weights, converted offline from a trained float MlpNetwork.
+ */
+class QuantizedMlpNetwork
+{
+private:
+
+    std::vector<QuantizedDense> _layers;
+    // the places of the layer outputs in the thread's arena.
+    MemoryPlan _plan;
+public:
+
+    /**
+     * the quantizer, converts every layer of a float network to int8 weights with per row scales.
+     * @param network the trained float network.
+     */
+    explicit QuantizedMlpNetwork(const MlpNetwork &network);
+
+    /**
+     * activating the quantized mlpnetwork on a given image.
+     * @param img a matrix representing the image.
+     * @return a digit which the mlp discovered from the image.
+     */
+    Digit operator()(const Matrix &img) const;
+
+    /**
+     * a getter for the memory the quantized weights take.
+     * @return the number of bytes of the weights of all the layers.
+     */
+    size_t weightBytes() const;
+};
+
+/**
+ * runs the float and the quantized networks on the same images and reports how often they agree on the digit,
+ * the difference in the reported probability and the size of the weights of both.
+ * @param network the float network
+ * @param quantized the quantized network
+ * @param images an array of n images.
+ * @param n the number of images.
+ * @return the report.
+ */
+QuantizationReport compareQuantization(const MlpNetwork &network, const QuantizedMlpNetwork &quantized,
+                                       const Matrix images[], int n);
+
+#endif //QUANTIZEDMLPNETWORK_H
@@ -0,0 +1,1286 @@
+#include <algorithm>
+#include <cmath>
+#include "SimdKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+/*
+ * exp(x) = 2^n * exp(r), with n = round(x / ln 2) and |r| <= ln 2 / 2. ln 2 is split in two so r is exact,
+ * and exp(r) is the degree 7 polynomial of cephes (relative error below 2e-7). below EXP_LOW 2^n would be
+ * denormal, the inputs are clamped there (exp(EXP_LOW) is about 1e-38, a zero for a softmax).
+ */
+#define EXP_LOW (-87.33654f)
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_LN2_HI 0.693359375f
+#define EXP_LN2_LO (-2.12194440e-4f)
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+// ---------------------------------------- scalar ----------------------------------------
+
+/**
+ * y = a + b, one float at a time.
+ */
+static void _addScalar(float *y, const float *a, const float *b, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = a[i] + b[i];
+    }
+}
+
+/**
+ * y = c * x, one float at a time.
+ */
+static void _scaleScalar(float *y, const float *x, float c, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = c * x[i];
+    }
+}
+
+/**
+ * y = y + a * x, one float at a time.
+ */
+static void _axpyScalar(float *y, float a, const float *x, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+/**
+ * y = max(x, 0), one float at a time.
+ */
+static void _reluScalar(float *y, const float *x, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = (x[i] > 0) ? x[i] : 0;
+    }
+}
+
+/**
+ * y = max(x + b, 0), one float at a time.
+ */
+static void _biasReluScalar(float *y, const float *x, float b, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] = (x[i] + b > 0) ? x[i] + b : 0;
+    }
+}
+
+/**
+ * y = min(max(x, lo), hi), one float at a time.
+ */
+static void _clampScalar(float *y, const float *x, float lo, float hi, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        float val = (x[i] > lo) ? x[i] : lo;
+        y[i] = (val < hi) ? val : hi;
+    }
+}
+
+/**
+ * the sum of a[i] * b[i], one float at a time.
+ */
+static float _dotScalar(const float *a, const float *b, int n)
+{
+    float sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/**
+ * the dot products of the rows of a panel with x, one float at a time.
+ */
+static void _panelDotScalar(float *y, const float *panel, const float *x, int n)
+{
+    float acc[SIMD_PANEL_ROWS] = {};
+    for (int k = 0; k < n; ++k)
+    {
+        for (int r = 0; r < SIMD_PANEL_ROWS; ++r)
+        {
+            acc[r] += panel[k * SIMD_PANEL_ROWS + r] * x[k];
+        }
+    }
+    for (int r = 0; r < SIMD_PANEL_ROWS; ++r)
+    {
+        y[r] = acc[r];
+    }
+}
+
+/**
+ * adds the sparse columns of the nonzero inputs, scaled, to y, one float at a time (the gathers and the
+ * scatters of the wide instruction sets were slower on the few rows of a pruned column).
+ */
+static void _sparseAxpyColumnsScalar(float *y, const float *a, const int *start, const int *index, const int *columns,
+                                     const float *values, int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        const float x = values[j];
+        for (int e = start[columns[j]]; e < start[columns[j] + 1]; ++e)
+        {
+            y[index[e]] += a[e] * x;
+        }
+    }
+}
+
+/**
+ * adds the blocks of the sparse columns of the nonzero inputs, scaled, to the panels of y they belong to, one
+ * float at a time.
+ */
+static void _sparsePanelAxpyColumnsScalar(float *y, const float *panel, const int *start, const int *index,
+                                          const int *columns, const float *values, int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        const float x = values[j];
+        for (int b = start[columns[j]]; b < start[columns[j] + 1]; ++b)
+        {
+            float *rows = y + index[b] * SIMD_PANEL_ROWS;
+            for (int r = 0; r < SIMD_PANEL_ROWS; ++r)
+            {
+                rows[r] += panel[(size_t) b * SIMD_PANEL_ROWS + r] * x;
+            }
+        }
+    }
+}
+
+/**
+ * compacts the nonzero floats of x, one float at a time without branches.
+ */
+static int _compactNonzerosScalar(int *index, float *values, const float *x, int n)
+{
+    int count = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        index[count] = i;
+        values[count] = x[i];
+        count += x[i] != 0;
+    }
+    return count;
+}
+
+/**
+ * the dot products of the rows of a panel with the selected columns, one float at a time.
+ */
+static void _panelDotColumnsScalar(float *y, const float *panel, const int *index, const float *values, int n)
+{
+    float acc[SIMD_PANEL_ROWS] = {};
+    for (int b = 0; b < n; ++b)
+    {
+        const float *column = panel + index[b] * SIMD_PANEL_ROWS;
+        for (int r = 0; r < SIMD_PANEL_ROWS; ++r)
+        {
+            acc[r] += column[r] * values[b];
+        }
+    }
+    for (int r = 0; r < SIMD_PANEL_ROWS; ++r)
+    {
+        y[r] = acc[r];
+    }
+}
+
+/**
+ * the polynomial exp of a float, the same approximation as the vector kernels.
+ */
+static float _expScalar(float x)
+{
+    x = std::max(x, EXP_LOW);
+    const float n = std::floor(x * EXP_LOG2E + 0.5f);
+    const float r = (x - n * EXP_LN2_HI) - n * EXP_LN2_LO;
+    float p = EXP_P0;
+    p = p * r + EXP_P1;
+    p = p * r + EXP_P2;
+    p = p * r + EXP_P3;
+    p = p * r + EXP_P4;
+    p = p * r + EXP_P5;
+    return std::ldexp(p * r * r + r + 1, (int) n);
+}
+
+/**
+ * the softmax of x + bias, one float at a time.
+ */
+static void _softmaxScalar(float *y, const float *x, const float *bias, int n, bool log)
+{
+    float max = -INFINITY;
+    for (int i = 0; i < n; ++i)
+    {
+        max = std::max(max, x[i] + (bias ? bias[i] : 0));
+    }
+    float sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const float e = _expScalar(x[i] + (bias ? bias[i] : 0) - max);
+        sum += e;
+        if (!log)
+        {
+            y[i] = e;
+        }
+    }
+    if (log)
+    {
+        const float c = max + std::log(sum);
+        for (int i = 0; i < n; ++i)
+        {
+            y[i] = x[i] + (bias ? bias[i] : 0) - c;
+        }
+        return;
+    }
+    const float c = 1 / sum;
+    for (int i = 0; i < n; ++i)
+    {
+        y[i] *= c;
+    }
+}
+
+/**
+ * the softmax of column j of a rows x cols buffer with rows ld floats apart, one float at a time.
+ */
+static void _softmaxColumnScalar(float *values, const float *bias, int rows, int ld, int j, bool log)
+{
+    float max = -INFINITY;
+    for (int i = 0; i < rows; ++i)
+    {
+        max = std::max(max, values[(size_t) i * ld + j] + (bias ? bias[i] : 0));
+    }
+    float sum = 0;
+    for (int i = 0; i < rows; ++i)
+    {
+        sum += _expScalar(values[(size_t) i * ld + j] + (bias ? bias[i] : 0) - max);
+    }
+    const float c = log ? max + std::log(sum) : 1 / sum;
+    for (int i = 0; i < rows; ++i)
+    {
+        float &value = values[(size_t) i * ld + j];
+        const float v = value + (bias ? bias[i] : 0);
+        value = log ? v - c : _expScalar(v - max) * c;
+    }
+}
+
+/**
+ * the softmax of every column of a rows x cols buffer, one column at a time.
+ */
+static void _softmaxColumnsScalar(float *values, const float *bias, int rows, int cols, int ld, bool log)
+{
+    for (int j = 0; j < cols; ++j)
+    {
+        _softmaxColumnScalar(values, bias, rows, ld, j, log);
+    }
+}
+
+#ifdef SIMD_X86
+
+// ----------------------------------------- SSE2 -----------------------------------------
+
+/**
+ * y = a + b, 4 floats at a time.
+ */
+static void _addSse2(float *y, const float *a, const float *b, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    _addScalar(y + i, a + i, b + i, n - i);
+}
+
+/**
+ * y = c * x, 4 floats at a time.
+ */
+static void _scaleSse2(float *y, const float *x, float c, int n)
+{
+    __m128 vc = _mm_set1_ps(c);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_mul_ps(vc, _mm_loadu_ps(x + i)));
+    }
+    _scaleScalar(y + i, x + i, c, n - i);
+}
+
+/**
+ * y = y + a * x, 4 floats at a time.
+ */
+static void _axpySse2(float *y, float a, const float *x, int n)
+{
+    __m128 va = _mm_set1_ps(a);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+    _axpyScalar(y + i, a, x + i, n - i);
+}
+
+/**
+ * y = max(x, 0), 4 floats at a time.
+ */
+static void _reluSse2(float *y, const float *x, int n)
+{
+    __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_max_ps(_mm_loadu_ps(x + i), zero));
+    }
+    _reluScalar(y + i, x + i, n - i);
+}
+
+/**
+ * y = max(x + b, 0), 4 floats at a time.
+ */
+static void _biasReluSse2(float *y, const float *x, float b, int n)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 vb = _mm_set1_ps(b);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_max_ps(_mm_add_ps(_mm_loadu_ps(x + i), vb), zero));
+    }
+    _biasReluScalar(y + i, x + i, b, n - i);
+}
+
+/**
+ * y = min(max(x, lo), hi), 4 floats at a time.
+ */
+static void _clampSse2(float *y, const float *x, float lo, float hi, int n)
+{
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + i), vlo), vhi));
+    }
+    _clampScalar(y + i, x + i, lo, hi, n - i);
+}
+
+/**
+ * the sum of a[i] * b[i], 4 floats at a time in 2 independent accumulators.
+ */
+static float _dotSse2(const float *a, const float *b, int n)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0) + _dotScalar(a + i, b + i, n - i);
+}
+
+/**
+ * the dot products of the rows of a panel with x, a column (4 registers of rows) at a time.
+ */
+static void _panelDotSse2(float *y, const float *panel, const float *x, int n)
+{
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    for (int k = 0; k < n; ++k)
+    {
+        const float *column = panel + k * SIMD_PANEL_ROWS;
+        __m128 xk = _mm_set1_ps(x[k]);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(column), xk));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(column + 4), xk));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_load_ps(column + 8), xk));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_load_ps(column + 12), xk));
+    }
+    _mm_storeu_ps(y, acc0);
+    _mm_storeu_ps(y + 4, acc1);
+    _mm_storeu_ps(y + 8, acc2);
+    _mm_storeu_ps(y + 12, acc3);
+}
+
+/**
+ * adds the blocks of the sparse columns of the nonzero inputs, scaled, to the panels of y they belong to, a
+ * block (4 registers of rows) at a time.
+ */
+static void _sparsePanelAxpyColumnsSse2(float *y, const float *panel, const int *start, const int *index,
+                                        const int *columns, const float *values, int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        const __m128 x = _mm_set1_ps(values[j]);
+        for (int b = start[columns[j]]; b < start[columns[j] + 1]; ++b)
+        {
+            const float *column = panel + (size_t) b * SIMD_PANEL_ROWS;
+            float *rows = y + index[b] * SIMD_PANEL_ROWS;
+            _mm_store_ps(rows, _mm_add_ps(_mm_load_ps(rows), _mm_mul_ps(_mm_load_ps(column), x)));
+            _mm_store_ps(rows + 4, _mm_add_ps(_mm_load_ps(rows + 4), _mm_mul_ps(_mm_load_ps(column + 4), x)));
+            _mm_store_ps(rows + 8, _mm_add_ps(_mm_load_ps(rows + 8), _mm_mul_ps(_mm_load_ps(column + 8), x)));
+            _mm_store_ps(rows + 12, _mm_add_ps(_mm_load_ps(rows + 12), _mm_mul_ps(_mm_load_ps(column + 12), x)));
+        }
+    }
+}
+
+/**
+ * the dot products of the rows of a panel with the selected columns, a column (4 registers of rows) at a time.
+ */
+static void _panelDotColumnsSse2(float *y, const float *panel, const int *index, const float *values, int n)
+{
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    for (int b = 0; b < n; ++b)
+    {
+        const float *column = panel + index[b] * SIMD_PANEL_ROWS;
+        __m128 xb = _mm_set1_ps(values[b]);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(column), xb));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(column + 4), xb));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_load_ps(column + 8), xb));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_load_ps(column + 12), xb));
+    }
+    _mm_storeu_ps(y, acc0);
+    _mm_storeu_ps(y + 4, acc1);
+    _mm_storeu_ps(y + 8, acc2);
+    _mm_storeu_ps(y + 12, acc3);
+}
+
+// ----------------------------------------- AVX2 -----------------------------------------
+
+/**
+ * y = a + b, 8 floats at a time.
+ */
+__attribute__((target("avx2")))
+static void _addAvx2(float *y, const float *a, const float *b, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    _addScalar(y + i, a + i, b + i, n - i);
+}
+
+/**
+ * y = c * x, 8 floats at a time.
+ */
+__attribute__((target("avx2")))
+static void _scaleAvx2(float *y, const float *x, float c, int n)
+{
+    __m256 vc = _mm256_set1_ps(c);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(vc, _mm256_loadu_ps(x + i)));
+    }
+    _scaleScalar(y + i, x + i, c, n - i);
+}
+
+/**
+ * y = y + a * x, 8 floats at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void _axpyAvx2(float *y, float a, const float *x, int n)
+{
+    __m256 va = _mm256_set1_ps(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    _axpyScalar(y + i, a, x + i, n - i);
+}
+
+/**
+ * y = max(x, 0), 8 floats at a time.
+ */
+__attribute__((target("avx2")))
+static void _reluAvx2(float *y, const float *x, int n)
+{
+    __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_max_ps(_mm256_loadu_ps(x + i), zero));
+    }
+    _reluScalar(y + i, x + i, n - i);
+}
+
+/**
+ * y = max(x + b, 0), 8 floats at a time.
+ */
+__attribute__((target("avx2")))
+static void _biasReluAvx2(float *y, const float *x, float b, int n)
+{
+    __m256 zero = _mm256_setzero_ps();
+    __m256 vb = _mm256_set1_ps(b);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(x + i), vb), zero));
+    }
+    _biasReluScalar(y + i, x + i, b, n - i);
+}
+
+/**
+ * y = min(max(x, lo), hi), 8 floats at a time.
+ */
+__attribute__((target("avx2")))
+static void _clampAvx2(float *y, const float *x, float lo, float hi, int n)
+{
+    __m256 vlo = _mm256_set1_ps(lo);
+    __m256 vhi = _mm256_set1_ps(hi);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(x + i), vlo), vhi));
+    }
+    _clampScalar(y + i, x + i, lo, hi, n - i);
+}
+
+/**
+ * the sum of a[i] * b[i], 8 floats at a time in 2 independent accumulators.
+ */
+__attribute__((target("avx2,fma")))
+static float _dotAvx2(const float *a, const float *b, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half) + _dotScalar(a + i, b + i, n - i);
+}
+
+/**
+ * the dot products of the rows of a panel with x, two columns at a time in independent accumulators.
+ */
+__attribute__((target("avx2,fma")))
+static void _panelDotAvx2(float *y, const float *panel, const float *x, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int k = 0;
+    for (; k + 2 <= n; k += 2)
+    {
+        const float *column = panel + k * SIMD_PANEL_ROWS;
+        __m256 x0 = _mm256_broadcast_ss(x + k);
+        __m256 x1 = _mm256_broadcast_ss(x + k + 1);
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(column), x0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(column + 8), x0, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_load_ps(column + 16), x1, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_load_ps(column + 24), x1, acc3);
+    }
+    if (k < n)
+    {
+        const float *column = panel + k * SIMD_PANEL_ROWS;
+        __m256 x0 = _mm256_broadcast_ss(x + k);
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(column), x0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(column + 8), x0, acc1);
+    }
+    _mm256_storeu_ps(y, _mm256_add_ps(acc0, acc2));
+    _mm256_storeu_ps(y + 8, _mm256_add_ps(acc1, acc3));
+}
+
+/**
+ * adds the blocks of the sparse columns of the nonzero inputs, scaled, to the panels of y they belong to, a
+ * block (2 registers of rows) at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void _sparsePanelAxpyColumnsAvx2(float *y, const float *panel, const int *start, const int *index,
+                                        const int *columns, const float *values, int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        const __m256 x = _mm256_set1_ps(values[j]);
+        for (int b = start[columns[j]]; b < start[columns[j] + 1]; ++b)
+        {
+            const float *column = panel + (size_t) b * SIMD_PANEL_ROWS;
+            float *rows = y + index[b] * SIMD_PANEL_ROWS;
+            _mm256_store_ps(rows, _mm256_fmadd_ps(_mm256_load_ps(column), x, _mm256_load_ps(rows)));
+            _mm256_store_ps(rows + 8, _mm256_fmadd_ps(_mm256_load_ps(column + 8), x, _mm256_load_ps(rows + 8)));
+        }
+    }
+}
+
+/**
+ * the dot products of the rows of a panel with the selected columns, two columns at a time in independent
+ * accumulators.
+ */
+__attribute__((target("avx2,fma")))
+static void _panelDotColumnsAvx2(float *y, const float *panel, const int *index, const float *values, int n)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int b = 0;
+    for (; b + 2 <= n; b += 2)
+    {
+        const float *column0 = panel + index[b] * SIMD_PANEL_ROWS;
+        const float *column1 = panel + index[b + 1] * SIMD_PANEL_ROWS;
+        __m256 x0 = _mm256_broadcast_ss(values + b);
+        __m256 x1 = _mm256_broadcast_ss(values + b + 1);
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(column0), x0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(column0 + 8), x0, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_load_ps(column1), x1, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_load_ps(column1 + 8), x1, acc3);
+    }
+    if (b < n)
+    {
+        const float *column = panel + index[b] * SIMD_PANEL_ROWS;
+        __m256 x0 = _mm256_broadcast_ss(values + b);
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(column), x0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(column + 8), x0, acc1);
+    }
+    _mm256_storeu_ps(y, _mm256_add_ps(acc0, acc2));
+    _mm256_storeu_ps(y + 8, _mm256_add_ps(acc1, acc3));
+}
+
+/**
+ * the polynomial exp of 8 floats.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256 _expAvx2(__m256 x)
+{
+    x = _mm256_max_ps(x, _mm256_set1_ps(EXP_LOW));
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_LN2_LO), r);
+    __m256 p = _mm256_set1_ps(EXP_P0);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P5));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1)));
+    // 2^n built in the exponent field, n is in [-126, 0] for the inputs of a softmax.
+    const __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(pow2n));
+}
+
+/**
+ * x + bias at i, 8 floats.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256 _loadBiasedAvx2(const float *x, const float *bias, int i)
+{
+    const __m256 v = _mm256_loadu_ps(x + i);
+    return bias ? _mm256_add_ps(v, _mm256_loadu_ps(bias + i)) : v;
+}
+
+/**
+ * the softmax of x + bias, 8 floats at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void _softmaxAvx2(float *y, const float *x, const float *bias, int n, bool log)
+{
+    const int body = n / 8 * 8;
+    __m256 vmax = _mm256_set1_ps(-INFINITY);
+    for (int i = 0; i < body; i += 8)
+    {
+        vmax = _mm256_max_ps(vmax, _loadBiasedAvx2(x, bias, i));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, vmax);
+    float max = -INFINITY;
+    for (float lane : lanes)
+    {
+        max = std::max(max, lane);
+    }
+    for (int i = body; i < n; ++i)
+    {
+        max = std::max(max, x[i] + (bias ? bias[i] : 0));
+    }
+    const __m256 shift = _mm256_set1_ps(max);
+    __m256 vsum = _mm256_setzero_ps();
+    for (int i = 0; i < body; i += 8)
+    {
+        const __m256 e = _expAvx2(_mm256_sub_ps(_loadBiasedAvx2(x, bias, i), shift));
+        vsum = _mm256_add_ps(vsum, e);
+        if (!log)
+        {
+            _mm256_storeu_ps(y + i, e);
+        }
+    }
+    _mm256_store_ps(lanes, vsum);
+    float sum = 0;
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+    for (int i = body; i < n; ++i)
+    {
+        const float e = _expScalar(x[i] + (bias ? bias[i] : 0) - max);
+        sum += e;
+        if (!log)
+        {
+            y[i] = e;
+        }
+    }
+    if (log)
+    {
+        const float c = max + std::log(sum);
+        const __m256 vc = _mm256_set1_ps(c);
+        for (int i = 0; i < body; i += 8)
+        {
+            _mm256_storeu_ps(y + i, _mm256_sub_ps(_loadBiasedAvx2(x, bias, i), vc));
+        }
+        for (int i = body; i < n; ++i)
+        {
+            y[i] = x[i] + (bias ? bias[i] : 0) - c;
+        }
+        return;
+    }
+    _scaleAvx2(y, y, 1 / sum, n);
+}
+
+/**
+ * the softmax of every column of a rows x cols buffer, 8 columns at a time, the columns past the last 8
+ * one at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void _softmaxColumnsAvx2(float *values, const float *bias, int rows, int cols, int ld, bool log)
+{
+    int j = 0;
+    for (; j + 8 <= cols; j += 8)
+    {
+        __m256 vmax = _mm256_set1_ps(-INFINITY);
+        for (int i = 0; i < rows; ++i)
+        {
+            const __m256 v = _mm256_loadu_ps(values + (size_t) i * ld + j);
+            vmax = _mm256_max_ps(vmax, bias ? _mm256_add_ps(v, _mm256_set1_ps(bias[i])) : v);
+        }
+        __m256 vsum = _mm256_setzero_ps();
+        for (int i = 0; i < rows; ++i)
+        {
+            float *row = values + (size_t) i * ld + j;
+            __m256 v = _mm256_loadu_ps(row);
+            v = bias ? _mm256_add_ps(v, _mm256_set1_ps(bias[i])) : v;
+            const __m256 e = _expAvx2(_mm256_sub_ps(v, vmax));
+            vsum = _mm256_add_ps(vsum, e);
+            _mm256_storeu_ps(row, log ? v : e);
+        }
+        __m256 c;
+        if (log)
+        {
+            alignas(32) float lanes[8];
+            _mm256_store_ps(lanes, vsum);
+            for (float &lane : lanes)
+            {
+                lane = std::log(lane);
+            }
+            c = _mm256_add_ps(vmax, _mm256_load_ps(lanes));
+        }
+        else
+        {
+            c = _mm256_div_ps(_mm256_set1_ps(1), vsum);
+        }
+        for (int i = 0; i < rows; ++i)
+        {
+            float *row = values + (size_t) i * ld + j;
+            const __m256 v = _mm256_loadu_ps(row);
+            _mm256_storeu_ps(row, log ? _mm256_sub_ps(v, c) : _mm256_mul_ps(v, c));
+        }
+    }
+    for (; j < cols; ++j)
+    {
+        _softmaxColumnScalar(values, bias, rows, ld, j, log);
+    }
+}
+
+// ---------------------------------------- AVX-512 ---------------------------------------
+
+/**
+ * the mask of the first n lanes (n < 16) of a 16 float register.
+ */
+#define TAIL_MASK(n) ((__mmask16) ((1u << (n)) - 1))
+
+// min/max, the shuffles, roundscale and scalef go through the zero-masked forms with all lanes on, the plain
+// forms trip gcc's maybe-uninitialized warning on their undefined pass-through operand.
+#define ALL_LANES ((__mmask16) 0xFFFF)
+
+/**
+ * y = a + b, 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _addAvx512(float *y, const float *a, const float *b, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, a + i),
+                                                      _mm512_maskz_loadu_ps(m, b + i)));
+    }
+}
+
+/**
+ * y = c * x, 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _scaleAvx512(float *y, const float *x, float c, int n)
+{
+    __m512 vc = _mm512_set1_ps(c);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_mul_ps(vc, _mm512_loadu_ps(x + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_mul_ps(vc, _mm512_maskz_loadu_ps(m, x + i)));
+    }
+}
+
+/**
+ * y = y + a * x, 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _axpyAvx512(float *y, float a, const float *x, int n)
+{
+    __m512 va = _mm512_set1_ps(a);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i),
+                                                        _mm512_maskz_loadu_ps(m, y + i)));
+    }
+}
+
+/**
+ * y = max(x, 0), 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _reluAvx512(float *y, const float *x, int n)
+{
+    __m512 zero = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_maskz_max_ps(ALL_LANES, _mm512_loadu_ps(x + i), zero));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        __m512 val = _mm512_maskz_loadu_ps(m, x + i);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_maskz_max_ps(ALL_LANES, val, zero));
+    }
+}
+
+/**
+ * y = max(x + b, 0), 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _biasReluAvx512(float *y, const float *x, float b, int n)
+{
+    __m512 zero = _mm512_setzero_ps();
+    __m512 vb = _mm512_set1_ps(b);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_maskz_max_ps(ALL_LANES, _mm512_add_ps(_mm512_loadu_ps(x + i), vb), zero));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        __m512 val = _mm512_add_ps(_mm512_maskz_loadu_ps(m, x + i), vb);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_maskz_max_ps(ALL_LANES, val, zero));
+    }
+}
+
+/**
+ * y = min(max(x, lo), hi), 16 floats at a time, the tail with a masked load/store.
+ */
+__attribute__((target("avx512f")))
+static void _clampAvx512(float *y, const float *x, float lo, float hi, int n)
+{
+    __m512 vlo = _mm512_set1_ps(lo);
+    __m512 vhi = _mm512_set1_ps(hi);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512 val = _mm512_maskz_max_ps(ALL_LANES, _mm512_loadu_ps(x + i), vlo);
+        _mm512_storeu_ps(y + i, _mm512_maskz_min_ps(ALL_LANES, val, vhi));
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        __m512 val = _mm512_maskz_max_ps(ALL_LANES, _mm512_maskz_loadu_ps(m, x + i), vlo);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_maskz_min_ps(ALL_LANES, val, vhi));
+    }
+}
+
+/**
+ * the sum of a[i] * b[i], 16 floats at a time in 2 independent accumulators, the tail with a masked load.
+ */
+__attribute__((target("avx512f")))
+static float _dotAvx512(const float *a, const float *b, int n)
+{
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        __mmask16 m = TAIL_MASK(n - i);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+    }
+    // reduced through memory, _mm512_reduce_add_ps trips gcc's uninitialized warning like min/max.
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float sum = 0;
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+    return sum;
+}
+
+/**
+ * the dot products of the rows of a panel with x, a column per register, four columns at a time in
+ * independent accumulators.
+ */
+__attribute__((target("avx512f")))
+static void _panelDotAvx512(float *y, const float *panel, const float *x, int n)
+{
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    int k = 0;
+    for (; k + 4 <= n; k += 4)
+    {
+        const float *column = panel + k * SIMD_PANEL_ROWS;
+        acc0 = _mm512_fmadd_ps(_mm512_load_ps(column), _mm512_set1_ps(x[k]), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_load_ps(column + 16), _mm512_set1_ps(x[k + 1]), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_load_ps(column + 32), _mm512_set1_ps(x[k + 2]), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_load_ps(column + 48), _mm512_set1_ps(x[k + 3]), acc3);
+    }
+    for (; k < n; ++k)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_load_ps(panel + k * SIMD_PANEL_ROWS), _mm512_set1_ps(x[k]), acc0);
+    }
+    _mm512_storeu_ps(y, _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+/**
+ * adds the blocks of the sparse columns of the nonzero inputs, scaled, to the panels of y they belong to, a
+ * block per register.
+ */
+__attribute__((target("avx512f")))
+static void _sparsePanelAxpyColumnsAvx512(float *y, const float *panel, const int *start, const int *index,
+                                          const int *columns, const float *values, int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        const __m512 x = _mm512_set1_ps(values[j]);
+        for (int b = start[columns[j]]; b < start[columns[j] + 1]; ++b)
+        {
+            float *rows = y + index[b] * SIMD_PANEL_ROWS;
+            _mm512_store_ps(rows, _mm512_fmadd_ps(_mm512_load_ps(panel + (size_t) b * SIMD_PANEL_ROWS), x,
+                                                  _mm512_load_ps(rows)));
+        }
+    }
+}
+
+/**
+ * compacts the nonzero floats of x, 16 at a time with a compress of the positions and of the values.
+ */
+__attribute__((target("avx512f")))
+static int _compactNonzerosAvx512(int *index, float *values, const float *x, int n)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i positions = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    int count = 0;
+    for (int i = 0; i < n; i += 16)
+    {
+        __mmask16 lanes = (n - i < 16) ? TAIL_MASK(n - i) : ALL_LANES;
+        __m512 val = _mm512_maskz_loadu_ps(lanes, x + i);
+        __mmask16 nonzero = _mm512_mask_cmp_ps_mask(lanes, val, zero, _CMP_NEQ_UQ);
+        // the compress in registers and a full store, the compressing store is microcoded on most cpus.
+        _mm512_storeu_si512(index + count, _mm512_maskz_compress_epi32(nonzero, positions));
+        _mm512_storeu_ps(values + count, _mm512_maskz_compress_ps(nonzero, val));
+        count += __builtin_popcount(nonzero);
+        positions = _mm512_add_epi32(positions, step);
+    }
+    return count;
+}
+
+/**
+ * the dot products of the rows of a panel with the selected columns, a column per register, four columns at
+ * a time in independent accumulators.
+ */
+__attribute__((target("avx512f")))
+static void _panelDotColumnsAvx512(float *y, const float *panel, const int *index, const float *values, int n)
+{
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    int b = 0;
+    for (; b + 4 <= n; b += 4)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_load_ps(panel + index[b] * SIMD_PANEL_ROWS), _mm512_set1_ps(values[b]), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_load_ps(panel + index[b + 1] * SIMD_PANEL_ROWS),
+                               _mm512_set1_ps(values[b + 1]), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_load_ps(panel + index[b + 2] * SIMD_PANEL_ROWS),
+                               _mm512_set1_ps(values[b + 2]), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_load_ps(panel + index[b + 3] * SIMD_PANEL_ROWS),
+                               _mm512_set1_ps(values[b + 3]), acc3);
+    }
+    for (; b < n; ++b)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_load_ps(panel + index[b] * SIMD_PANEL_ROWS), _mm512_set1_ps(values[b]), acc0);
+    }
+    _mm512_storeu_ps(y, _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+/**
+ * the polynomial exp of 16 floats, 2^n applied by scalef.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _expAvx512(__m512 x)
+{
+    x = _mm512_maskz_max_ps(ALL_LANES, x, _mm512_set1_ps(EXP_LOW));
+    const __m512 n = _mm512_maskz_roundscale_ps(ALL_LANES, _mm512_mul_ps(x, _mm512_set1_ps(EXP_LOG2E)),
+                                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_LN2_HI), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_LN2_LO), r);
+    __m512 p = _mm512_set1_ps(EXP_P0);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P4));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P5));
+    p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1)));
+    return _mm512_maskz_scalef_ps(ALL_LANES, p, n);
+}
+
+/**
+ * x + bias at i, the lanes past the mask are 0.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _loadBiasedAvx512(const float *x, const float *bias, int i, __mmask16 lanes)
+{
+    const __m512 v = _mm512_maskz_loadu_ps(lanes, x + i);
+    return bias ? _mm512_add_ps(v, _mm512_maskz_loadu_ps(lanes, bias + i)) : v;
+}
+
+/**
+ * the max of the 16 lanes, in every lane. the halves are folded in registers, a softmax of a short vector
+ * waits on its reductions, and a round trip through memory stalls on the store.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _maxLanesAvx512(__m512 v)
+{
+    v = _mm512_maskz_max_ps(ALL_LANES, v, _mm512_maskz_shuffle_f32x4(ALL_LANES, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm512_maskz_max_ps(ALL_LANES, v, _mm512_maskz_shuffle_f32x4(ALL_LANES, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm512_maskz_max_ps(ALL_LANES, v, _mm512_maskz_permute_ps(ALL_LANES, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm512_maskz_max_ps(ALL_LANES, v, _mm512_maskz_permute_ps(ALL_LANES, v, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+/**
+ * the sum of the 16 lanes, in every lane, folded like _maxLanesAvx512.
+ */
+__attribute__((target("avx512f")))
+static inline __m512 _sumLanesAvx512(__m512 v)
+{
+    v = _mm512_add_ps(v, _mm512_maskz_shuffle_f32x4(ALL_LANES, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm512_add_ps(v, _mm512_maskz_shuffle_f32x4(ALL_LANES, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm512_add_ps(v, _mm512_maskz_permute_ps(ALL_LANES, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm512_add_ps(v, _mm512_maskz_permute_ps(ALL_LANES, v, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+/**
+ * the softmax of x + bias, 16 floats at a time, the tail masked. up to 16 floats (the output of a
+ * classifier) stay in one register from the load to the store.
+ */
+__attribute__((target("avx512f")))
+static void _softmaxAvx512(float *y, const float *x, const float *bias, int n, bool log)
+{
+    if (n <= 16)
+    {
+        const __mmask16 lanes = TAIL_MASK(n);
+        const __m512 v = _loadBiasedAvx512(x, bias, 0, lanes);
+        const __m512 vmax = _maxLanesAvx512(_mm512_mask_mov_ps(_mm512_set1_ps(-INFINITY), lanes, v));
+        const __m512 shifted = _mm512_sub_ps(v, vmax);
+        const __m512 sum = _sumLanesAvx512(_mm512_maskz_mov_ps(lanes, _expAvx512(shifted)));
+        if (log)
+        {
+            const float c = std::log(_mm512_cvtss_f32(sum));
+            _mm512_mask_storeu_ps(y, lanes, _mm512_sub_ps(shifted, _mm512_set1_ps(c)));
+        }
+        else
+        {
+            _mm512_mask_storeu_ps(y, lanes, _mm512_div_ps(_expAvx512(shifted), sum));
+        }
+        return;
+    }
+    __m512 vmax = _mm512_set1_ps(-INFINITY);
+    for (int i = 0; i < n; i += 16)
+    {
+        const __mmask16 lanes = (n - i < 16) ? TAIL_MASK(n - i) : ALL_LANES;
+        vmax = _mm512_mask_max_ps(vmax, lanes, vmax, _loadBiasedAvx512(x, bias, i, lanes));
+    }
+    const float max = _mm512_cvtss_f32(_maxLanesAvx512(vmax));
+    const __m512 shift = _mm512_set1_ps(max);
+    __m512 vsum = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16)
+    {
+        const __mmask16 tail = (n - i < 16) ? TAIL_MASK(n - i) : ALL_LANES;
+        const __m512 e = _expAvx512(_mm512_sub_ps(_loadBiasedAvx512(x, bias, i, tail), shift));
+        vsum = _mm512_mask_add_ps(vsum, tail, vsum, e);
+        if (!log)
+        {
+            _mm512_mask_storeu_ps(y + i, tail, e);
+        }
+    }
+    const float sum = _mm512_cvtss_f32(_sumLanesAvx512(vsum));
+    if (log)
+    {
+        const __m512 c = _mm512_set1_ps(max + std::log(sum));
+        for (int i = 0; i < n; i += 16)
+        {
+            const __mmask16 tail = (n - i < 16) ? TAIL_MASK(n - i) : ALL_LANES;
+            _mm512_mask_storeu_ps(y + i, tail, _mm512_sub_ps(_loadBiasedAvx512(x, bias, i, tail), c));
+        }
+        return;
+    }
+    _scaleAvx512(y, y, 1 / sum, n);
+}
+
+/**
+ * the softmax of every column of a rows x cols buffer, 16 columns at a time, the last columns masked.
+ */
+__attribute__((target("avx512f")))
+static void _softmaxColumnsAvx512(float *values, const float *bias, int rows, int cols, int ld, bool log)
+{
+    for (int j = 0; j < cols; j += 16)
+    {
+        const __mmask16 tail = (cols - j < 16) ? TAIL_MASK(cols - j) : ALL_LANES;
+        __m512 vmax = _mm512_set1_ps(-INFINITY);
+        for (int i = 0; i < rows; ++i)
+        {
+            const __m512 v = _mm512_maskz_loadu_ps(tail, values + (size_t) i * ld + j);
+            vmax = _mm512_maskz_max_ps(ALL_LANES, vmax, bias ? _mm512_add_ps(v, _mm512_set1_ps(bias[i])) : v);
+        }
+        __m512 vsum = _mm512_setzero_ps();
+        for (int i = 0; i < rows; ++i)
+        {
+            float *row = values + (size_t) i * ld + j;
+            __m512 v = _mm512_maskz_loadu_ps(tail, row);
+            v = bias ? _mm512_add_ps(v, _mm512_set1_ps(bias[i])) : v;
+            const __m512 e = _expAvx512(_mm512_sub_ps(v, vmax));
+            vsum = _mm512_add_ps(vsum, e);
+            _mm512_mask_storeu_ps(row, tail, log ? v : e);
+        }
+        __m512 c;
+        if (log)
+        {
+            alignas(64) float lanes[16];
+            _mm512_store_ps(lanes, vsum);
+            for (float &lane : lanes)
+            {
+                lane = std::log(lane);
+            }
+            c = _mm512_add_ps(vmax, _mm512_load_ps(lanes));
+        }
+        else
+        {
+            c = _mm512_div_ps(_mm512_set1_ps(1), vsum);
+        }
+        for (int i = 0; i < rows; ++i)
+        {
+            float *row = values + (size_t) i * ld + j;
+            const __m512 v = _mm512_maskz_loadu_ps(tail, row);
+            _mm512_mask_storeu_ps(row, tail, log ? _mm512_sub_ps(v, c) : _mm512_mul_ps(v, c));
+        }
+    }
+}
+
+#endif
+
+/**
+ * checks the cpu and fills the kernel table with the widest supported instruction set.
+ * @return the kernel table.
+ */
+static SimdKernels _selectKernels()
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SimdKernels{_addAvx512, _scaleAvx512, _axpyAvx512, _reluAvx512, _biasReluAvx512, _clampAvx512,
+                           _dotAvx512, _panelDotAvx512, _sparseAxpyColumnsScalar, _sparsePanelAxpyColumnsAvx512,
+                           _compactNonzerosAvx512, _panelDotColumnsAvx512, _softmaxAvx512, _softmaxColumnsAvx512,
+                           "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SimdKernels{_addAvx2, _scaleAvx2, _axpyAvx2, _reluAvx2, _biasReluAvx2, _clampAvx2, _dotAvx2,
+                           _panelDotAvx2, _sparseAxpyColumnsScalar, _sparsePanelAxpyColumnsAvx2,
+                           _compactNonzerosScalar, _panelDotColumnsAvx2, _softmaxAvx2, _softmaxColumnsAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return SimdKernels{_addSse2, _scaleSse2, _axpySse2, _reluSse2, _biasReluSse2, _clampSse2, _dotSse2,
+                           _panelDotSse2, _sparseAxpyColumnsScalar, _sparsePanelAxpyColumnsSse2,
+                           _compactNonzerosScalar, _panelDotColumnsSse2, _softmaxScalar, _softmaxColumnsScalar,
+                           "sse2"};
+    }
+#endif
+    return SimdKernels{_addScalar, _scaleScalar, _axpyScalar, _reluScalar, _biasReluScalar, _clampScalar, _dotScalar,
+                       _panelDotScalar, _sparseAxpyColumnsScalar, _sparsePanelAxpyColumnsScalar,
+                       _compactNonzerosScalar, _panelDotColumnsScalar, _softmaxScalar, _softmaxColumnsScalar,
+                       "scalar"};
+}
+
+/**
+ * returns the kernel table for the running cpu, the cpu is checked only on the first call.
+ * @return a reference to the kernel table.
+ */
+const SimdKernels &simdKernels()
+{
+    static const SimdKernels kernels = _selectKernels();
+    return kernels;
+}
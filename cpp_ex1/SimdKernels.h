@@ -0,0 +1,112 @@
+// SimdKernels.h
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+// the number of rows of a panel of packed weights, one 64 byte cache line of floats per column.
+#define SIMD_PANEL_ROWS 16
+
+/**
+ * @struct SimdKernels
+ * @brief a table of the element-wise float kernels, filled once at startup with the widest
+ *        instruction set the cpu supports (AVX-512, AVX2, SSE2 or plain scalar code).
+ *        all the kernels work on n contiguous floats and allow y to be the same buffer as an input.
+ */
+typedef struct SimdKernels
+{
+    /**
+     * y = a + b
+     */
+    void (*add)(float *y, const float *a, const float *b, int n);
+
+    /**
+     * y = c * x
+     */
+    void (*scale)(float *y, const float *x, float c, int n);
+
+    /**
+     * y = y + a * x
+     */
+    void (*axpy)(float *y, float a, const float *x, int n);
+
+    /**
+     * y = max(x, 0)
+     */
+    void (*relu)(float *y, const float *x, int n);
+
+    /**
+     * y = max(x + b, 0)
+     */
+    void (*biasRelu)(float *y, const float *x, float b, int n);
+
+    /**
+     * y = min(max(x, lo), hi)
+     */
+    void (*clamp)(float *y, const float *x, float lo, float hi, int n);
+
+    /**
+     * returns the sum of a[i] * b[i]
+     */
+    float (*dot)(const float *a, const float *b, int n);
+
+    /**
+     * y[r] = the sum of panel[k * SIMD_PANEL_ROWS + r] * x[k] for the SIMD_PANEL_ROWS rows r of a panel,
+     * panel is 64 byte aligned and holds the n columns of the rows one after the other.
+     */
+    void (*panelDot)(float *y, const float *panel, const float *x, int n);
+
+    /**
+     * y[index[e]] += a[e] * values[j] over the entries e of the sparse columns columns[j] of a CSC matrix (from
+     * start[columns[j]] to start[columns[j] + 1]), for the n compacted nonzero inputs j. the rows of a column
+     * are distinct.
+     */
+    void (*sparseAxpyColumns)(float *y, const float *a, const int *start, const int *index, const int *columns,
+                              const float *values, int n);
+
+    /**
+     * y[index[b] * SIMD_PANEL_ROWS + r] += panel[b * SIMD_PANEL_ROWS + r] * values[j] over the blocks b of the
+     * sparse columns columns[j] (from start[columns[j]] to start[columns[j] + 1]), for the n compacted nonzero
+     * inputs j. a block is the column of one panel, y and panel are 64 byte aligned.
+     */
+    void (*sparsePanelAxpyColumns)(float *y, const float *panel, const int *start, const int *index,
+                                   const int *columns, const float *values, int n);
+
+    /**
+     * compacts the nonzero floats of x, their positions into index and their values into values, and returns
+     * their number. both buffers need room for n + SIMD_PANEL_ROWS entries, the entries past the count are
+     * garbage.
+     */
+    int (*compactNonzeros)(int *index, float *values, const float *x, int n);
+
+    /**
+     * y[r] = the sum of panel[index[b] * SIMD_PANEL_ROWS + r] * values[b] for the SIMD_PANEL_ROWS rows r of
+     * a (dense) panel, over n selected columns b of the panel.
+     */
+    void (*panelDotColumns)(float *y, const float *panel, const int *index, const float *values, int n);
+
+    /**
+     * y = softmax(x + bias), or its log when log is set. the max is subtracted before exp, so large inputs
+     * do not overflow, and exp is a polynomial with a relative error below 2e-7. bias may be nullptr.
+     */
+    void (*softmax)(float *y, const float *x, const float *bias, int n, bool log);
+
+    /**
+     * the softmax (or the log-softmax) of every column of a row-major rows x cols buffer with rows ld floats
+     * apart, in place, with bias[i] added to row i first. bias may be nullptr.
+     */
+    void (*softmaxColumns)(float *values, const float *bias, int rows, int cols, int ld, bool log);
+
+    /**
+     * the name of the selected instruction set.
+     */
+    const char *isa;
+
+} SimdKernels;
+
+/**
+ * returns the kernel table for the running cpu, the cpu is checked only on the first call.
+ * @return a reference to the kernel table.
+ */
+const SimdKernels &simdKernels();
+
+#endif //SIMDKERNELS_H
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include "MemoryPlan.h"
+#include "SparseDense.h"
+
+/**
+ * counts the nonzero weights and the panel columns that are not all zeros.
+ * @param w the rows x cols row-major weights.
+ * @param rows the number of rows.
+ * @param cols the number of cols.
+ * @param nonzeros the number of nonzero weights.
+ * @param blocks the number of blocks (columns of panels of SIMD_PANEL_ROWS rows) holding a nonzero.
+ */
+static void _countNonzeros(const float *w, int rows, int cols, size_t *nonzeros, size_t *blocks)
+{
+    *nonzeros = 0;
+    *blocks = 0;
+    for (int p = 0; p < rows; p += SIMD_PANEL_ROWS)
+    {
+        const int panelRows = std::min(SIMD_PANEL_ROWS, rows - p);
+        for (int k = 0; k < cols; ++k)
+        {
+            size_t column = 0;
+            for (int r = 0; r < panelRows; ++r)
+            {
+                column += w[(size_t) (p + r) * cols + k] != 0;
+            }
+            *nonzeros += column;
+            *blocks += column != 0;
+        }
+    }
+}
+
+/**
+ * converts the weights of a float layer, dropping the zeros.
+ * @param dense the float layer.
+ * @param format the layout to store the nonzeros in.
+ */
+SparseDense :: SparseDense(const Dense &dense, SparseFormat format)
+        : _activationType(dense.getActivation().getActivationType()), _format(format), _rows(dense.getRows()),
+          _cols(dense.getCols()), _bias(dense.getBias().data(), dense.getBias().data() + _rows)
+{
+    const Matrix weights = dense.getWeights();
+    const float *w = weights.data();
+    _start.push_back(0);
+    for (int k = 0; k < _cols; ++k)
+    {
+        for (int p = 0; p < _rows; p += SIMD_PANEL_ROWS)
+        {
+            const int panelRows = std::min(SIMD_PANEL_ROWS, _rows - p);
+            float column[SIMD_PANEL_ROWS] = {};
+            bool nonzero = false;
+            for (int r = 0; r < panelRows; ++r)
+            {
+                column[r] = w[(size_t) (p + r) * _cols + k];
+                nonzero = nonzero || column[r] != 0;
+                if (_format == SparseCsc && column[r] != 0)
+                {
+                    _index.push_back(p + r);
+                    _values.push_back(column[r]);
+                }
+            }
+            if (_format == SparseBlocks && nonzero)
+            {
+                _index.push_back(p / SIMD_PANEL_ROWS);
+                _values.insert(_values.end(), column, column + SIMD_PANEL_ROWS);
+            }
+        }
+        _start.push_back((int) _index.size());
+    }
+}
+
+/**
+ * the converter, picks the fastest format for the weights of a layer from their measured density.
+ * @param dense the float layer.
+ * @return the layer in the best sparse format, or nullptr when the dense layer is faster.
+ */
+std::shared_ptr<const SparseDense> SparseDense :: convert(const Dense &dense)
+{
+    const int rows = dense.getRows(), cols = dense.getCols();
+    const Matrix weights = dense.getWeights();
+    size_t nonzeros, blocks;
+    _countNonzeros(weights.data(), rows, cols, &nonzeros, &blocks);
+    // the costs of all the columns, the share of them a product reads is the same in every format.
+    const double denseCost = (double) ((rows + SIMD_PANEL_ROWS - 1) / SIMD_PANEL_ROWS) * cols;
+    const double blockCost = SPARSE_BLOCK_COST * (double) blocks + SPARSE_COLUMN_COST * cols;
+    const double cscCost = SPARSE_CSC_COST * (double) nonzeros + SPARSE_COLUMN_COST * cols;
+    if (denseCost <= blockCost && denseCost <= cscCost)
+    {
+        return nullptr;
+    }
+    return std::make_shared<const SparseDense>(dense, (blockCost <= cscCost) ? SparseBlocks : SparseCsc);
+}
+
+/**
+ * a getter for the number of outputs of the layer.
+ * @return the number of rows of W.
+ */
+int SparseDense :: getRows() const
+{
+    return _rows;
+}
+
+/**
+ * a getter for the number of inputs of the layer.
+ * @return the number of cols of W.
+ */
+int SparseDense :: getCols() const
+{
+    return _cols;
+}
+
+/**
+ * a getter for the layout of the weights.
+ * @return the format of the layer.
+ */
+SparseFormat SparseDense :: getFormat() const
+{
+    return _format;
+}
+
+/**
+ * a getter for the share of the weights that are stored (the zeros of the blocks included).
+ * @return the number of stored weights over rows * cols.
+ */
+float SparseDense :: density() const
+{
+    return (float) _values.size() / ((float) _rows * (float) _cols);
+}
+
+/**
+ * a getter for the memory the weights take, including the indices.
+ * @return the number of bytes of the weights.
+ */
+size_t SparseDense :: weightBytes() const
+{
+    return _values.size() * sizeof(float) + (_index.size() + _start.size()) * sizeof(int);
+}
+
+/**
+ * a getter for the work of the forward kernels, the stored zeros of the blocks included.
+ * @param batch the number of inputs.
+ * @return the floating point operations of a product with batch inputs.
+ */
+double SparseDense :: flops(int batch) const
+{
+    return 2.0 * (double) _values.size() * batch;
+}
+
+/**
+ * the sparse forward kernel, writes act(W*x + b) into output. the nonzero inputs are compacted first and
+ * only their columns are added to the output.
+ * @param input the input vector, getCols() floats.
+ * @param output the output vector, getRows() floats, may not overlap the input.
+ */
+void SparseDense :: forward(const float *input, float *output) const
+{
+    const SimdKernels &kernels = simdKernels();
+    const size_t panelFloats = (size_t) (_rows + SIMD_PANEL_ROWS - 1) / SIMD_PANEL_ROWS * SIMD_PANEL_ROWS;
+    // the blocks add whole panels, the last one past the output: they go to a padded copy of it.
+    ArenaFrame frame(panelFloats + 2 * ((size_t) _cols + SIMD_PANEL_ROWS));
+    float *y = (_format == SparseBlocks) ? frame.data() : output;
+    int *index = reinterpret_cast<int *>(frame.data() + panelFloats);
+    float *values = frame.data() + panelFloats + _cols + SIMD_PANEL_ROWS;
+    const int nonzeros = kernels.compactNonzeros(index, values, input, _cols);
+    std::fill(y, y + ((_format == SparseBlocks) ? panelFloats : (size_t) _rows), 0.f);
+    if (_format == SparseCsc)
+    {
+        kernels.sparseAxpyColumns(y, _values.data(), _start.data(), _index.data(), index, values, nonzeros);
+    }
+    else
+    {
+        kernels.sparsePanelAxpyColumns(y, _values.data(), _start.data(), _index.data(), index, values, nonzeros);
+    }
+    if (y != output)
+    {
+        std::copy(y, y + _rows, output);
+    }
+    Activation(_activationType).activate(output, _bias.data(), _rows);
+}
+
+/**
+ * the batched sparse forward kernel on raw row-major buffers, writes act(W*X + b) into output. every
+ * nonzero weight adds its input row, scaled, to its output row, a column of W (a row of X) at a time.
+ * @param input getCols() x batch floats, one input per column.
+ * @param batch the number of inputs.
+ * @param output getRows() x batch floats for the results, may not overlap the input.
+ */
+void SparseDense :: forwardBatch(const float *input, int batch, float *output) const
+{
+    forwardBatch(ConstMatrixView(input, _cols, batch, batch), MatrixView(output, _rows, batch, batch));
+}
+
+/**
+ * the batched sparse forward kernel on views (like a tile of the columns of a larger batch), read and
+ * written in place with their strides.
+ * @param input a getCols() x N matrix, one input per column.
+ * @param output a getRows() x N matrix for the results, one result per column, may not overlap the input.
+ */
+void SparseDense :: forwardBatch(ConstMatrixView input, MatrixView output) const
+{
+    const int batch = input.getCols();
+    if (input.getRows() != _cols || output.getRows() != _rows || output.getCols() != batch)
+    {
+        throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+    }
+    const SimdKernels &kernels = simdKernels();
+    const float *in = input.data();
+    float *out = output.data();
+    const size_t ldi = input.getLd(), ldo = output.getLd();
+    for (int i = 0; i < _rows; ++i)
+    {
+        std::fill(out + i * ldo, out + i * ldo + batch, 0.f);
+    }
+    for (int k = 0; k < _cols; ++k)
+    {
+        const float *x = in + k * ldi;
+        for (int e = _start[k]; e < _start[k + 1]; ++e)
+        {
+            if (_format == SparseCsc)
+            {
+                kernels.axpy(out + _index[e] * ldo, _values[e], x, batch);
+                continue;
+            }
+            const int i = _index[e] * SIMD_PANEL_ROWS;
+            const float *column = _values.data() + (size_t) e * SIMD_PANEL_ROWS;
+            for (int r = 0; r < std::min(SIMD_PANEL_ROWS, _rows - i); ++r)
+            {
+                if (column[r] != 0)
+                {
+                    kernels.axpy(out + (i + r) * ldo, column[r], x, batch);
+                }
+            }
+        }
+    }
+    // the bias is broadcast into every column by the first pass of the activation.
+    Activation(_activationType).activateColumns(out, _bias.data(), _rows, batch, (int) ldo);
+}
@@ -0,0 +1,135 @@
+// SparseDense.h
+
+#ifndef SPARSEDENSE_H
+#define SPARSEDENSE_H
+
+#include <memory>
+#include <vector>
+#include "Dense.h"
+#include "SimdKernels.h"
+
+/*
+ * the cost of a product in the different formats, in units of one column of a dense panel (a cache line of
+ * weights times one input, what Dense::forward reads per nonzero input and panel), measured on the first
+ * layer with image inputs. a block is loaded, added to its panel of the output and stored, a CSC nonzero is
+ * a float added to its row, and every column of a nonzero input pays for its bounds and for the branch on
+ * its length. the sparse formats and the dense panels all skip the zero inputs, so their costs keep their
+ * ratio at any density of the inputs.
+ */
+#define SPARSE_BLOCK_COST 1.5
+#define SPARSE_CSC_COST 1
+#define SPARSE_COLUMN_COST 2
+
+/**
+ * @enum SparseFormat
+ * @brief the layout of the nonzero weights of a sparse layer.
+ */
+enum SparseFormat
+{
+    // compressed sparse columns: the nonzero weights of every column and their rows.
+    SparseCsc,
+    // the columns of the panels of SIMD_PANEL_ROWS rows that are not all zeros, a cache line each, grouped
+    // by column.
+    SparseBlocks
+};
+
+/**
+ * a dense layer of a pruned network, storing and multiplying only the nonzero weights. CSC suits weights
+ * pruned one by one, the blocks of a panel column suit weights pruned in groups of rows (and read like the
+ * packed panels of Dense, one aligned vector per block). the weights are grouped by column, so a product
+ * reads only the columns of the nonzero inputs, like the sparse input path of Dense::forward.
+ */
+class SparseDense
+{
+private:
+    ActivationType _activationType;
+    SparseFormat _format;
+    int _rows, _cols;
+    // the first entry of every column in _index, and one past the last.
+    std::vector<int> _start;
+    // the row of every nonzero (CSC) or the panel of every block (blocks).
+    std::vector<int> _index;
+    // the nonzero weights (CSC), or SIMD_PANEL_ROWS weights per block (blocks).
+    PackedWeights _values;
+    std::vector<float> _bias;
+
+public:
+
+    /**
+     * converts the weights of a float layer, dropping the zeros.
+     * @param dense the float layer.
+     * @param format the layout to store the nonzeros in.
+     */
+    SparseDense(const Dense &dense, SparseFormat format);
+
+    /**
+     * the converter, picks the fastest format for the weights of a layer from their measured density.
+     * @param dense the float layer.
+     * @return the layer in the best sparse format, or nullptr when the dense layer is faster.
+     */
+    static std::shared_ptr<const SparseDense> convert(const Dense &dense);
+
+    /**
+     * a getter for the number of outputs of the layer.
+     * @return the number of rows of W.
+     */
+    int getRows() const;
+
+    /**
+     * a getter for the number of inputs of the layer.
+     * @return the number of cols of W.
+     */
+    int getCols() const;
+
+    /**
+     * a getter for the layout of the weights.
+     * @return the format of the layer.
+     */
+    SparseFormat getFormat() const;
+
+    /**
+     * a getter for the share of the weights that are stored (the zeros of the blocks included).
+     * @return the number of stored weights over rows * cols.
+     */
+    float density() const;
+
+    /**
+     * a getter for the memory the weights take, including the indices.
+     * @return the number of bytes of the weights.
+     */
+    size_t weightBytes() const;
+
+    /**
+     * a getter for the work of the forward kernels, the stored zeros of the blocks included.
+     * @param batch the number of inputs.
+     * @return the floating point operations of a product with batch inputs.
+     */
+    double flops(int batch) const;
+
+    /**
+     * the sparse forward kernel, writes act(W*x + b) into output. the nonzero inputs are compacted first and
+     * only their columns are added to the output.
+     * @param input the input vector, getCols() floats.
+     * @param output the output vector, getRows() floats, may not overlap the input.
+     */
+    void forward(const float *input, float *output) const;
+
+    /**
+     * the batched sparse forward kernel on raw row-major buffers, writes act(W*X + b) into output. every
+     * nonzero weight adds its input row, scaled, to its output row, a column of W (a row of X) at a time.
+     * @param input getCols() x batch floats, one input per column.
+     * @param batch the number of inputs.
+     * @param output getRows() x batch floats for the results, may not overlap the input.
+     */
+    void forwardBatch(const float *input, int batch, float *output) const;
+
+    /**
+     * the batched sparse forward kernel on views (like a tile of the columns of a larger batch), read and
+     * written in place with their strides.
+     * @param input a getCols() x N matrix, one input per column.
+     * @param output a getRows() x N matrix for the results, one result per column, may not overlap the input.
+     */
+    void forwardBatch(ConstMatrixView input, MatrixView output) const;
+};
+
+#endif //SPARSEDENSE_H
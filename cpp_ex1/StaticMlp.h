@@ -0,0 +1,240 @@
+// StaticMlp.h
+
+#ifndef STATICMLP_H
+#define STATICMLP_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include "Activation.h"
+#include "Dense.h"
+#include "Digit.h"
+#include "Matrix.h"
+#include "MlpNetwork.h"
+#include "SimdKernels.h"
+
+/**
+ * a dense layer whose sizes are compile time constants. the weights live inline in the layer, packed in the
+ * panels of Dense by packPanels (SIMD_PANEL_ROWS rows column after column, the last panel padded with zero
+ * rows) and aligned to a cache line, and run by the same panelForward: a mostly zero input is compacted once
+ * and only the columns of its nonzeros are read. nothing is checked or allocated at inference time.
+ * @tparam In the number of inputs.
+ * @tparam Out the number of outputs.
+ * @tparam Act the activation of the layer.
+ */
+template<int In, int Out, ActivationType Act>
+class StaticDense
+{
+private:
+    static constexpr int _panels = (Out + SIMD_PANEL_ROWS - 1) / SIMD_PANEL_ROWS;
+
+    alignas(64) std::array<float, (size_t) _panels * SIMD_PANEL_ROWS * In> _weights;
+    alignas(64) std::array<float, Out> _bias;
+
+public:
+
+    /**
+     * copies the weights and the bias of a layer into the panels, the only place the sizes are checked.
+     * @param w an Out x In weight matrix.
+     * @param bias an Out x 1 bias matrix.
+     */
+    void load(const Matrix &w, const Matrix &bias)
+    {
+        if (w.getRows() != Out || w.getCols() != In || bias.getRows() * bias.getCols() != Out)
+        {
+            throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+        }
+        packPanels(w.data(), Out, In, w.getLd(), _weights.data());
+        std::copy(bias.data(), bias.data() + Out, _bias.begin());
+    }
+
+    /**
+     * writes act(W*x + b) into out.
+     * @param in the input, In floats.
+     * @param out the output, Out floats, may not overlap the input.
+     */
+    void forward(const float *in, float *out) const
+    {
+        alignas(64) int index[In + SIMD_PANEL_ROWS];
+        alignas(64) float values[In + SIMD_PANEL_ROWS];
+        panelForward(_weights.data(), Out, In, Act, _bias.data(), in, out, index, values);
+    }
+};
+
+/**
+ * the chain of the layers of a static network, every layer but the last is a relu layer.
+ * @tparam In the number of inputs of the first layer.
+ * @tparam Out the number of outputs of the first layer.
+ * @tparam Rest the numbers of outputs of the next layers.
+ */
+template<int In, int Out, int... Rest>
+struct StaticLayers
+{
+    StaticDense<In, Out, Relu> layer;
+    StaticLayers<Out, Rest...> next;
+
+    /**
+     * copies the weights of the layers.
+     * @param weights an array of the weight matrices, from this layer on.
+     * @param biases an array of the bias matrices, from this layer on.
+     */
+    void load(const Matrix weights[], const Matrix biases[])
+    {
+        layer.load(weights[0], biases[0]);
+        next.load(weights + 1, biases + 1);
+    }
+
+    /**
+     * activates the layers, the outputs alternate between two buffers.
+     * @param in the input.
+     * @param buffer the buffer of the output of this layer.
+     * @param other the buffer of the output of the next layer.
+     * @return the output of the last layer.
+     */
+    const float *forward(const float *in, float *buffer, float *other) const
+    {
+        layer.forward(in, buffer);
+        return next.forward(buffer, other, buffer);
+    }
+};
+
+/**
+ * the last layer of a static network, a softmax layer.
+ * @tparam In the number of inputs of the layer.
+ * @tparam Out the number of outputs of the layer.
+ */
+template<int In, int Out>
+struct StaticLayers<In, Out>
+{
+    StaticDense<In, Out, Softmax> layer;
+
+    /**
+     * copies the weights of the layer.
+     * @param weights an array holding the weight matrix.
+     * @param biases an array holding the bias matrix.
+     */
+    void load(const Matrix weights[], const Matrix biases[])
+    {
+        layer.load(weights[0], biases[0]);
+    }
+
+    /**
+     * activates the layer.
+     * @param in the input.
+     * @param buffer the buffer of the output.
+     * @return the output.
+     */
+    const float *forward(const float *in, float *buffer, float *) const
+    {
+        layer.forward(in, buffer);
+        return buffer;
+    }
+};
+
+/**
+ * the widest output of a chain of layers.
+ * @tparam In the number of inputs of the first layer, not an output.
+ * @tparam Outs the numbers of outputs of the layers.
+ * @return the largest number of outputs.
+ */
+template<int In, int... Outs>
+constexpr int staticWidestOutput()
+{
+    return std::max({Outs...});
+}
+
+/**
+ * an mlp whose topology is fixed at compile time, e.g. StaticMlp<784, 128, 64, 20, 10> for the network of
+ * MlpNetwork. the layers are relu layers and a last softmax layer, like MlpNetwork, and classify the same.
+ * the weights are inline (about 440 KB for the default network), so a network belongs on the heap:
+ * std::make_unique<StaticMlp<...>>(...).
+ * @tparam Dims the number of inputs followed by the number of outputs of every layer.
+ */
+template<int... Dims>
+class StaticMlp
+{
+private:
+    static_assert(sizeof...(Dims) >= 2, "a network has at least one layer");
+    static_assert(((Dims > 0) && ...), "the sizes of the layers are positive");
+
+    static constexpr int _inputs = std::array<int, sizeof...(Dims)>{Dims...}.front();
+    static constexpr int _outputs = std::array<int, sizeof...(Dims)>{Dims...}.back();
+    static constexpr int _widest = staticWidestOutput<Dims...>();
+
+    StaticLayers<Dims...> _layers;
+
+public:
+
+    // the number of layers of the network.
+    static constexpr int layers = sizeof...(Dims) - 1;
+
+    /**
+     * a constructor copying the weights of the layers, a layer of another size is an error.
+     * @param weights an array of the layers weight matrices.
+     * @param biases an array of the layers bias matrices.
+     */
+    StaticMlp(const Matrix weights[], const Matrix biases[])
+    {
+        _layers.load(weights, biases);
+    }
+
+    /**
+     * a constructor copying the (float) weights of a dynamic network of the same topology.
+     * @param network the network.
+     */
+    explicit StaticMlp(const MlpNetwork &network)
+    {
+        static_assert(layers == MLP_SIZE, "the network has MLP_SIZE layers");
+        Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+        for (int i = 0; i < MLP_SIZE; ++i)
+        {
+            weights[i] = network.getLayer(i).getWeights();
+            biases[i] = network.getLayer(i).getBias();
+        }
+        _layers.load(weights, biases);
+    }
+
+    /**
+     * activates the network on an image, nothing is checked or allocated.
+     * @param image the vectorized image, the number of inputs of the first layer floats.
+     * @return a digit which the mlp discovered from the image.
+     */
+    Digit operator()(const float *image) const
+    {
+        alignas(64) std::array<float, _widest> first, second;
+        const float *out = _layers.forward(image, first.data(), second.data());
+        int index = 0;
+        for (int i = 1; i < _outputs; ++i)
+        {
+            if (out[i] > out[index])
+            {
+                index = i;
+            }
+        }
+        Digit num = Digit();
+        num.value = index;
+        num.probability = out[index];
+        return num;
+    }
+
+    /**
+     * activates the network on an image.
+     * @param img a matrix representing the image.
+     * @return a digit which the mlp discovered from the image.
+     */
+    Digit operator()(const Matrix &img) const
+    {
+        if (img.getRows() * img.getCols() != _inputs)
+        {
+            throw MatrixSizeError(MAT_SIZE_DOES_NOT_MATCH_MULT_ERROR);
+        }
+        if (!img.isPacked())
+        {
+            // the layers read the image as one vector.
+            return (*this)(Matrix(img, packedLayout).data());
+        }
+        return (*this)(img.data());
+    }
+};
+
+#endif //STATICMLP_H
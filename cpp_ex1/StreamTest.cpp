@@ -0,0 +1,121 @@
+// StreamTest.cpp
+// checks ImageStream and MlpNetwork::predictStream against predictBatch: make streamtest builds and runs it,
+// it writes a file of images, streams it back and exits with 1 on the first difference.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ImageStream.h"
+#include "MlpNetwork.h"
+#include "TestData.h"
+
+#define STREAM_FAILED_ERROR "Error: the stream differs from the batch: "
+
+// the file of the images, removed at the end.
+#define STREAM_TEST_FILE "streamtest.bin"
+// the images of the file, and the batch of the stream: the last batch is short.
+#define STREAM_IMAGES 1000
+#define STREAM_BATCH 96
+// the largest difference of the probabilities of a digit, a batch of other columns may sum in another order.
+#define STREAM_TOLERANCE 1e-5f
+
+/**
+ * removes the file of the images and exits with 1 if a check failed.
+ * @param passed whether the check passed.
+ * @param name the name of the check.
+ */
+static void _expect(bool passed, const char *name)
+{
+    if (!passed)
+    {
+        std::remove(STREAM_TEST_FILE);
+        std::fprintf(stderr, "%s%s\n", STREAM_FAILED_ERROR, name);
+        std::exit(EXIT_FAILURE);
+    }
+    std::printf("ok  %s\n", name);
+}
+
+/**
+ * writes images to the file, one after the other, TEST_BLACK of their pixels are 0.
+ * @param images a size x n matrix of the images, one per column, filled here.
+ * @param gen the random generator.
+ * @param extraFloats floats written after the images, a file that ends inside an image for any but 0.
+ */
+static void _writeImages(Matrix &images, std::mt19937 &gen, int extraFloats)
+{
+    fillImages(images, gen);
+    std::vector<float> image((size_t) images.getRows());
+    std::ofstream out(STREAM_TEST_FILE, std::ios::binary | std::ios::trunc);
+    for (int j = 0; j < images.getCols(); ++j)
+    {
+        for (int i = 0; i < images.getRows(); ++i)
+        {
+            image[i] = images(i, j);
+        }
+        out.write((const char *) image.data(), (std::streamsize) (image.size() * sizeof(float)));
+    }
+    out.write((const char *) image.data(), (std::streamsize) (extraFloats * sizeof(float)));
+}
+
+/**
+ * the round trip of a file of images through the stream, and a file that ends inside an image.
+ * @return 0, or 1 (by exit) on the first failed check.
+ */
+int main()
+{
+    std::mt19937 gen(5);
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+        biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+        fillNormal(weights[i], gen, 0.1f);
+        fillNormal(biases[i], gen, 0.1f);
+    }
+    const MlpNetwork network(weights, biases);
+    const int size = imgDims.rows * imgDims.cols;
+
+    Matrix images(size, STREAM_IMAGES);
+    _writeImages(images, gen, 0);
+    const std::vector<Digit> expected = network.predictBatch(images);
+    std::vector<Digit> streamed;
+    {
+        ImageStream stream(STREAM_TEST_FILE, STREAM_BATCH);
+        streamed = network.predictStream(stream);
+    }
+    bool same = streamed.size() == expected.size();
+    for (size_t j = 0; same && j < expected.size(); ++j)
+    {
+        same = streamed[j].value == expected[j].value &&
+               std::fabs(streamed[j].probability - expected[j].probability) <= STREAM_TOLERANCE;
+    }
+    _expect(same, "predictStream of the written images equals predictBatch");
+
+    // the whole batches come out, then next() throws the error of the reader.
+    Matrix truncated(size, STREAM_BATCH * 2);
+    _writeImages(truncated, gen, size / 2);
+    int batches = 0;
+    bool thrown = false;
+    {
+        ImageStream stream(STREAM_TEST_FILE, STREAM_BATCH);
+        try
+        {
+            while (stream.next() != nullptr)
+            {
+                ++batches;
+            }
+        }
+        catch (const MatrixFileError &)
+        {
+            thrown = true;
+        }
+    }
+    _expect(thrown && batches == 2, "a file ending inside an image throws from next() after its whole batches");
+
+    std::remove(STREAM_TEST_FILE);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+// TestData.h
+// the random matrices and images the checks, the benchmarks and the load generator run the networks on.
+
+#ifndef TEST_DATA_H
+#define TEST_DATA_H
+
+#include <random>
+#include "Matrix.h"
+
+// the share of the pixels of an image that are black, like the digits.
+#define TEST_BLACK 0.8f
+
+/**
+ * fills a matrix with normal random values.
+ * @param m the matrix.
+ * @param gen the random generator.
+ * @param stddev the standard deviation of the values.
+ */
+inline void fillNormal(Matrix &m, std::mt19937 &gen, float stddev)
+{
+    std::normal_distribution<float> dist(0, stddev);
+    for (int i = 0; i < m.getRows() * m.getCols(); ++i)
+    {
+        m[i] = dist(gen);
+    }
+}
+
+/**
+ * fills a matrix with uniform random values in (-1, 1).
+ * @param m the matrix.
+ * @param gen the random generator.
+ */
+inline void fillUniform(Matrix &m, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < m.getRows() * m.getCols(); ++i)
+    {
+        m[i] = dist(gen);
+    }
+}
+
+/**
+ * fills a matrix with images (one image, or one per column), TEST_BLACK of the pixels are 0 and the rest are
+ * uniform in (0, 1).
+ * @param m the matrix.
+ * @param gen the random generator.
+ */
+inline void fillImages(Matrix &m, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<float> ink(0, 1);
+    for (int i = 0; i < m.getRows() * m.getCols(); ++i)
+    {
+        const float value = ink(gen);
+        m[i] = (value < TEST_BLACK) ? 0 : value;
+    }
+}
+
+#endif //TEST_DATA_H
@@ -0,0 +1,209 @@
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include "ThreadPool.h"
+
+/**
+ * the constructor of the pool.
+ * @param numThreads the number of workers, 0 for the value of MLP_NUM_THREADS or, when it is not set,
+ *        the number of hardware threads, throws std::invalid_argument if it is negative.
+ */
+ThreadPool :: ThreadPool(int numThreads) : _queued(0), _nextQueue(0), _stop(false)
+{
+    if (numThreads == 0)
+    {
+        const char *env = std::getenv(POOL_THREADS_ENV);
+        numThreads = (env != nullptr) ? std::atoi(env) : (int) std::thread::hardware_concurrency();
+        numThreads = (numThreads > 0) ? numThreads : 1;
+    }
+    if (numThreads < 0)
+    {
+        throw std::invalid_argument(BAD_POOL_SIZE_ERROR);
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        _queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        _workers.emplace_back(&ThreadPool::_workerLoop, this, i);
+    }
+}
+
+/**
+ * the destructor, runs the queued tasks and joins the workers.
+ */
+ThreadPool :: ~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * a getter for the number of workers.
+ * @return the number of workers.
+ */
+int ThreadPool :: size() const
+{
+    return (int) _workers.size();
+}
+
+/**
+ * pops a task, first from the back of the given deque and then from the front of the others.
+ * @param index the deque to start from.
+ * @param task the popped task.
+ * @return true if a task was popped.
+ */
+bool ThreadPool :: _popTask(int index, std::function<void()> &task)
+{
+    const int count = (int) _queues.size();
+    for (int i = 0; i < count; ++i)
+    {
+        TaskQueue &queue = *_queues[(index + i) % count];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * the loop of a worker thread.
+ * @param index the index of the worker's own deque.
+ */
+void ThreadPool :: _workerLoop(int index)
+{
+    std::function<void()> task;
+    while (true)
+    {
+        if (_popTask(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(_sleepLock);
+        _wake.wait(guard, [this]
+        { return _stop || _queued.load() > 0; });
+        if (_stop && _queued.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * queues a task on the next worker's deque. the task may not throw (the chunks of parallelFor catch
+ * their errors).
+ * @param task the task to run.
+ */
+void ThreadPool :: submit(std::function<void()> task)
+{
+    TaskQueue &queue = *_queues[_nextQueue.fetch_add(1, std::memory_order_relaxed) % _queues.size()];
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        // taken so a worker can not miss the wake up between its check and its wait.
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _queued.fetch_add(1);
+    }
+    _wake.notify_one();
+}
+
+/**
+ * runs body over [begin, end) split into chunks of at most grain indices, and returns when all
+ * the chunks are done. the calling thread runs chunks as well. if chunks throw, the first error is thrown
+ * here after every chunk is done.
+ * @param begin the first index
+ * @param end one past the last index
+ * @param grain the maximal number of indices in a chunk
+ * @param body a function called with the [first, last) indices of a chunk.
+ */
+void ThreadPool :: parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+    grain = (grain > 0) ? grain : 1;
+    if (end - begin <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+    std::mutex doneLock;
+    std::condition_variable done;
+    std::atomic<int> remaining((end - begin + grain - 1) / grain);
+    // the first error of a chunk, thrown on the calling thread once every chunk is done (the chunks point
+    // at the locals of this call, it can not return before them).
+    std::exception_ptr error;
+    for (int first = begin; first < end; first += grain)
+    {
+        int last = (end - first < grain) ? end : first + grain;
+        submit([&, first, last]
+               {
+                   std::exception_ptr chunkError;
+                   try
+                   {
+                       body(first, last);
+                   }
+                   catch (...)
+                   {
+                       chunkError = std::current_exception();
+                   }
+                   std::lock_guard<std::mutex> guard(doneLock);
+                   if (chunkError && !error)
+                   {
+                       error = chunkError;
+                   }
+                   if (remaining.fetch_sub(1) == 1)
+                   {
+                       done.notify_all();
+                   }
+               });
+    }
+    // help with the queued chunks (of this loop or any other) instead of blocking a thread.
+    std::function<void()> task;
+    const int start = (int) (_nextQueue.load(std::memory_order_relaxed) % _queues.size());
+    while (remaining.load() > 0)
+    {
+        if (_popTask(start, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(doneLock);
+        done.wait(guard, [&remaining]
+        { return remaining.load() == 0; });
+    }
+    // the last chunk may still hold the lock, it must release it before the locals go out of scope.
+    std::lock_guard<std::mutex> guard(doneLock);
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,101 @@
+// ThreadPool.h
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the environment variable that pins the number of workers of a pool created with 0 threads.
+#define POOL_THREADS_ENV "MLP_NUM_THREADS"
+#define BAD_POOL_SIZE_ERROR "Error: a thread pool needs at least 1 thread"
+
+/**
+ * a work-stealing thread pool. every worker owns a task deque, it runs its own tasks newest first
+ * and steals the oldest task of another worker when its deque is empty.
+ * a thread waiting for a parallelFor runs tasks too, so parallel loops may be nested.
+ */
+class ThreadPool
+{
+private:
+
+    /**
+     * the task deque of one worker.
+     */
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+    std::vector<std::thread> _workers;
+    std::mutex _sleepLock;
+    std::condition_variable _wake;
+    std::atomic<int> _queued;
+    std::atomic<unsigned> _nextQueue;
+    bool _stop;
+
+    /**
+     * the loop of a worker thread.
+     * @param index the index of the worker's own deque.
+     */
+    void _workerLoop(int index);
+
+    /**
+     * pops a task, first from the back of the given deque and then from the front of the others.
+     * @param index the deque to start from.
+     * @param task the popped task.
+     * @return true if a task was popped.
+     */
+    bool _popTask(int index, std::function<void()> &task);
+
+public:
+
+    /**
+     * the constructor of the pool.
+     * @param numThreads the number of workers, 0 for the value of MLP_NUM_THREADS or, when it is not set,
+     *        the number of hardware threads, throws std::invalid_argument if it is negative.
+     */
+    explicit ThreadPool(int numThreads = 0);
+
+    /**
+     * the destructor, runs the queued tasks and joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * a getter for the number of workers.
+     * @return the number of workers.
+     */
+    int size() const;
+
+    /**
+     * queues a task on the next worker's deque. the task may not throw (the chunks of parallelFor catch
+     * their errors).
+     * @param task the task to run.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * runs body over [begin, end) split into chunks of at most grain indices, and returns when all
+     * the chunks are done. the calling thread runs chunks as well. if chunks throw, the first error is thrown
+     * here after every chunk is done.
+     * @param begin the first index
+     * @param end one past the last index
+     * @param grain the maximal number of indices in a chunk
+     * @param body a function called with the [first, last) indices of a chunk.
+     */
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+};
+
+#endif //THREADPOOL_H